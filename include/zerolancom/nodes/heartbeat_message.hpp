@@ -10,9 +10,10 @@
 namespace zlc
 {
 
-// Protocol version constants
+// Protocol version constants. Nodes whose major or minor version differs use
+// an incompatible wire format (0.2 added the message envelope frame).
 constexpr int32_t ZLC_VERSION_MAJOR = 0;
-constexpr int32_t ZLC_VERSION_MINOR = 1;
+constexpr int32_t ZLC_VERSION_MINOR = 2;
 constexpr int32_t ZLC_VERSION_PATCH = 0;
 
 /**
@@ -20,13 +21,13 @@ constexpr int32_t ZLC_VERSION_PATCH = 0;
  *
  * This message is sent periodically via multicast to announce node presence.
  * When a receiver detects a new node or info_id change, it fetches full
- * NodeInfo via the service port.
+ * NodeInfo from the control port.
  *
  * Binary format (network byte order / big-endian):
  *   - zlc_version: 3 x int32 (12 bytes)
  *   - node_id: 36 bytes fixed string (UUID)
  *   - info_id: int32 (4 bytes)
- *   - service_port: int32 (4 bytes)
+ *   - control_port: int32 (4 bytes)
  *   - group_name: remaining bytes (variable length string)
  *
  * Total fixed size: 56 bytes + group_name length
@@ -36,7 +37,9 @@ struct HeartbeatMessage
   std::array<int32_t, 3> zlc_version; // {major, minor, patch}
   UUID node_id;                       // 36-char UUID string
   int32_t info_id;
-  int32_t service_port;
+  // Control-plane endpoint serving get_node_info. Older nodes send their
+  // service port here, which serves get_node_info as well.
+  int32_t control_port;
   std::string group_name;
 
   /**
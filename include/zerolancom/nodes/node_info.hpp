@@ -19,7 +19,15 @@ struct SocketInfo
   std::string ip;
   uint16_t port;
 
-  MSGPACK_DEFINE_MAP(name, ip, port)
+  // Credit channel of a flow-controlled publisher (0 if not flow-controlled).
+  // Peers that do not know the field ignore it.
+  uint16_t credit_port{0};
+
+  // Id a service was registered under, for compact request headers (0 if
+  // none). Peers that do not know the field ignore it.
+  uint32_t service_id{0};
+
+  MSGPACK_DEFINE_MAP(name, ip, port, credit_port, service_id)
 };
 
 /* ================= NodeInfo ================= */
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <mutex>
@@ -31,7 +32,9 @@ private:
   mutable std::mutex local_mutex_;
   NodeInfo localNodeInfo_;
   std::string groupName_;
-  int32_t servicePort_{0};
+  int32_t controlPort_{0};
+
+  std::atomic<uint64_t> generation_{0};
 
   // internal helpers (require external locking)
   void updateNodeUnlocked(const std::string &nodeID, const NodeInfo &info);
@@ -39,7 +42,7 @@ private:
   bool checkNodeInfoIDUnlocked(const std::string &nodeID, uint32_t infoID) const;
 
   // Fetch full NodeInfo from remote node
-  std::optional<NodeInfo> fetchNodeInfo(const std::string &ip, int32_t servicePort);
+  std::optional<NodeInfo> fetchNodeInfo(const std::string &ip, int32_t controlPort);
 
 public:
   NodeInfoManager(const std::string &name, const std::string &ip);
@@ -54,7 +57,20 @@ public:
   void removeNode(const std::string &nodeID);
 
   std::vector<SocketInfo> getPublisherInfo(const std::string &topicName) const;
+  std::vector<SocketInfo> getAllPublisherInfo() const;
   const SocketInfo *getServiceInfo(const std::string &serviceName) const;
+  // Every node providing the service, the local one included
+  std::vector<SocketInfo> getServiceProviders(const std::string &serviceName) const;
+
+  /**
+   * @brief Changes whenever discovered or local node info changes.
+   *
+   * Lets callers cache lookups and redo them only after a change.
+   */
+  uint64_t discoveryGeneration() const
+  {
+    return generation_.load(std::memory_order_acquire);
+  }
 
   void checkHeartbeats();
   void processHeartbeat(const HeartbeatMessage &heartbeat, const std::string &nodeIP);
@@ -62,11 +78,16 @@ public:
   // Local node management
   const UUID &nodeID() const;
   void setGroupName(const std::string &name);
-  void setServicePort(int32_t port);
+  // Port of the control-plane endpoint, advertised in heartbeats
+  void setControlPort(int32_t port);
+  int32_t controlPort() const;
   HeartbeatMessage createHeartbeat() const;
   NodeInfo getLocalNodeInfo() const;
-  void registerLocalTopic(const std::string &name, uint16_t port);
-  void registerLocalService(const std::string &name, uint16_t port);
+  void registerLocalTopic(const std::string &name, uint16_t port,
+                          uint16_t credit_port = 0);
+  void registerLocalService(const std::string &name, uint16_t port,
+                            uint32_t service_id = 0);
+  void unregisterLocalService(const std::string &name);
 };
 
 } // namespace zlc
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zlc
+{
+
+/**
+ * @brief Runtime configuration of a ZeroLanCom node.
+ *
+ * Usage:
+ *   NodeOptions options;
+ *   options.subscriber_shards = 4;
+ *   options.service_workers = 8;
+ *   options.subscriber_shard_cpus = {2, 3, 4, 5};
+ *   options.topic_affinity["lidar"] = 1;
+ *   zlc::init("node", "192.168.1.10", options);
+ */
+struct NodeOptions
+{
+  // Multicast discovery
+  std::string group = "224.0.0.1";
+  int groupPort = 7720;
+  std::string groupName = "zlc_default_group_name";
+
+  // Number of subscriber I/O threads, each with its own poll loop and sockets
+  size_t subscriber_shards = 1;
+
+  // CPU each shard thread is pinned to (shard i uses entry i); empty or -1
+  // leaves the thread unpinned
+  std::vector<int> subscriber_shard_cpus;
+
+  // Explicit topic -> shard assignment; other topics are assigned by hash
+  std::unordered_map<std::string, size_t> topic_affinity;
+
+  // Threads running service handlers; 0 uses one per hardware thread
+  size_t service_workers = 0;
+
+  /**
+   * @brief Worker threads needed by the node's long-running tasks.
+   *
+   * Multicast sender, multicast receiver, service loop, control-plane loop
+   * and client I/O loop, plus one thread per subscriber shard. Service
+   * handlers run on their own worker pools.
+   */
+  size_t threadPoolSize() const
+  {
+    return 5 + (subscriber_shards > 0 ? subscriber_shards : 1);
+  }
+};
+
+} // namespace zlc
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <mutex>
 #include <string>
 
@@ -12,12 +13,23 @@
 #include "zerolancom/nodes/multicast.hpp"
 #include "zerolancom/nodes/node_info.hpp"
 #include "zerolancom/nodes/node_info_manager.hpp"
+#include "zerolancom/nodes/node_options.hpp"
+#include "zerolancom/sockets/client_manager.hpp"
 #include "zerolancom/sockets/service_manager.hpp"
 #include "zerolancom/sockets/subscriber_manager.hpp"
 
 namespace zlc
 {
 
+/**
+ * @brief ZeroLanComNode owns the singletons of one node and their threads.
+ *
+ * Design notes:
+ * - get_node_info, which peers call to discover this node, is served by a
+ *   separate control-plane ServiceManager with its own socket, poll thread
+ *   and worker. Its port is advertised in heartbeats, so discovery does not
+ *   queue behind user requests however busy the service workers are.
+ */
 class ZeroLanComNode : public Singleton<ZeroLanComNode>
 {
 public:
@@ -25,14 +37,20 @@ public:
                  const std::string &group, int groupPort);
   ZeroLanComNode(const std::string &name, const std::string &ip,
                  const std::string &group, int groupPort, const std::string &groupName);
+  ZeroLanComNode(const std::string &name, const std::string &ip,
+                 const NodeOptions &options);
   ~ZeroLanComNode();
 
   void stop();
   bool isRunning() const;
 
+  // Port of the control-plane endpoint (0 after stop())
+  int controlPort() const;
+
 private:
   void registerGetNodeInfoService();
   bool running;
+  std::unique_ptr<ServiceManager> control_;
 };
 
 } // namespace zlc
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace zlc
@@ -36,12 +37,83 @@ struct ByteBuffer
   ~ByteBuffer();
 
   void write(const char *buf, size_t len);
+
+  // Hand the memory over to the caller, who frees it with std::free(); the
+  // buffer is empty afterwards
+  uint8_t *release();
 };
 
 // =======================
 // Utilities
 // =======================
 
+// Service header flag: the caller wants no reply (see Client::sendOneWay())
+constexpr uint8_t SERVICE_FLAG_ONE_WAY = 0x01;
+
+/**
+ * @brief Service name frame of a request.
+ *
+ * Binary format:
+ *   - service name
+ *   - optional: a NUL byte and the caller's remaining time budget in
+ *     milliseconds (uint32, big-endian)
+ *   - optional, after the budget: one byte of SERVICE_FLAG_* bits
+ *
+ * Servers that do not know the budget stop reading at the NUL byte.
+ */
+Bytes encodeServiceHeader(const std::string &service_name, uint32_t budget_ms,
+                          uint8_t flags = 0);
+// Service name of a named header; empty for a compact one
 std::string decodeServiceHeader(ByteView payload);
 
+/**
+ * @brief Compact service header, for providers that advertised a service id.
+ *
+ * Binary format (9 bytes):
+ *   - a NUL byte, which no service name starts with
+ *   - service id (uint32, big-endian, never 0)
+ *   - the caller's remaining time budget in milliseconds, 0 for none (uint32,
+ *     big-endian)
+ *   - optional: one byte of SERVICE_FLAG_* bits, making it 10 bytes
+ *
+ * Replies to a compact request carry a one-byte status (see encodeStatus()).
+ */
+Bytes encodeServiceHeader(uint32_t service_id, uint32_t budget_ms, uint8_t flags = 0);
+
+// Service id of a compact header; 0 for a named one
+uint32_t decodeServiceId(ByteView payload);
+
+// Time budget carried by a service header; 0 if it has none
+uint32_t decodeServiceBudget(ByteView payload);
+
+// SERVICE_FLAG_* bits of a service header; 0 if it has none
+uint8_t decodeServiceFlags(ByteView payload);
+
+/**
+ * @brief One-byte wire form of the codes in ResponseStatus.
+ *
+ * @return false for other codes, which are sent as strings.
+ */
+bool encodeStatus(std::string_view code, uint8_t &status);
+
+// Status code of a reply: a one-byte frame is a compact status, anything
+// longer the code as a string
+std::string_view decodeStatus(ByteView frame);
+
+// Service name of the credit messages a stream reader sends to the server
+constexpr const char *STREAM_CREDIT_SERVICE = "@stream-credit";
+
+/**
+ * @brief Payload of a stream request or of a stream credit message.
+ *
+ * Binary format:
+ *   - credit: further stream messages the reader accepts (uint32,
+ *     big-endian); 0 in a credit message cancels the stream
+ *   - stream requests only: the encoded request
+ */
+Bytes encodeStreamCredit(uint32_t credit, ByteView request = {});
+
+// Reads the credit and advances `payload` past it
+uint32_t decodeStreamCredit(ByteView &payload);
+
 } // namespace zlc
@@ -51,6 +51,26 @@ template <typename T> inline void decode(const ByteView &bv, T &out)
   }
 }
 
+// Decode an object without copying its strings and binaries.
+//
+// View types such as std::string_view in `out` point into `bv` and stay
+// valid only as long as it, so use this only while `bv` outlives `out`.
+template <typename T> inline void decodeInPlace(const ByteView &bv, T &out)
+{
+  try
+  {
+    msgpack::object_handle oh =
+        msgpack::unpack(reinterpret_cast<const char *>(bv.data), bv.size,
+                        [](msgpack::type::object_type, std::size_t, void *)
+                        { return true; });
+    oh.get().convert(out);
+  }
+  catch (const std::exception &e)
+  {
+    throw DecodeException(e.what());
+  }
+}
+
 } // namespace zlc
 
 // ============================================================================
@@ -1,12 +1,20 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 
 #include <zmq.hpp>
 
 #include "zerolancom/nodes/node_info_manager.hpp"
 #include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/client_manager.hpp"
+#include "zerolancom/sockets/stream_reader.hpp"
+#include "zerolancom/utils/exception.hpp"
 #include "zerolancom/utils/logger.hpp"
+#include "zerolancom/utils/request_result.hpp"
 #include "zerolancom/utils/zmq_utils.hpp"
 
 namespace zlc
@@ -19,30 +27,49 @@ namespace zlc
  * - Non-template functions are declared here and defined in client.cpp.
  * - Template functions must remain header-only.
  * - This class relies on ZMQContext singleton being initialized.
+ * - Blocking requests use a temporary REQ socket; asynchronous and one-way
+ *   requests are multiplexed over the per-endpoint DEALER sockets of
+ *   ClientManager.
  */
 class Client
 {
 public:
-  // Send a multipart request (service name + payload)
+  template <typename ResponseType>
+  using ResponseCallback =
+      std::function<void(const std::string &code, const ResponseType &response)>;
+
+  // Send a multipart request (service name + payload). A positive `budget`
+  // tells the server how long the caller will wait for the reply.
   static void sendRequest(const std::string &service_name, const ByteView &payload,
+                          ZMQSocket &socket, std::chrono::milliseconds budget = {});
+  // Send a multipart request with a prepared service header
+  static void sendRequest(const Bytes &header, const ByteView &payload,
                           ZMQSocket &socket);
-  // Receive multipart response and extract payload
-  static void receiveResponse(ZMQSocket &socket, zmq::message_t &payloadMsg,
-                              const std::string &service_name);
+  // Receive multipart response and extract payload; returns the status code
+  static std::string receiveResponse(ZMQSocket &socket, zmq::message_t &payloadMsg,
+                                     const std::string &service_name);
 
   /**
    * @brief Perform a blocking service request.
    *
    * Requirements:
    * - RequestType and ResponseType must be serializable via encode/decode.
-   * - This function blocks until a response is received or an error occurs.
+   * - This function blocks until a response is received, an error occurs or
+   *   `timeout` expires, in which case it throws ServiceException with
+   *   SERVICE_TIMEOUT.
    */
   template <typename RequestType, typename ResponseType>
-  static void zlcRequest(const std::string service_name, const std::string &service_url,
-                         const RequestType &request, ResponseType &response)
+  static void
+  zlcRequest(const std::string service_name, const std::string &service_url,
+             const RequestType &request, ResponseType &response,
+             std::chrono::milliseconds timeout =
+                 ClientManager::DEFAULT_REQUEST_TIMEOUT)
   {
-    // Create a REQ socket for this request
+    // Create a REQ socket for this request; it is dropped after a timeout, so
+    // nothing needs to linger
     ZMQSocket req_socket = ZMQContext::createTempSocket(zmq::socket_type::req);
+    req_socket.set(zmq::sockopt::rcvtimeo, static_cast<int>(timeout.count()));
+    req_socket.set(zmq::sockopt::linger, 0);
 
     // Resolve service and connect
     req_socket.connect(service_url);
@@ -51,12 +78,25 @@ public:
     ByteBuffer out;
     encode(request, out);
 
-    // Send request frames
-    sendRequest(service_name, ByteView{out.data, out.size}, req_socket);
+    // Send request frames; compact header if the provider advertised an id
+    Bytes header = ClientManager::instance().serviceHeader(
+        service_name, service_url, ClientManager::budgetMillis(timeout));
+    sendRequest(header, ByteView{out.data, out.size}, req_socket);
+    zlc::info("[Client] Sent request to service '{}'", service_name);
+    auto load = EndpointLoad::of(service_url);
+    auto sent = std::chrono::steady_clock::now();
+    load->start();
 
     // Receive response payload
     zmq::message_t payloadMsg;
-    receiveResponse(req_socket, payloadMsg, service_name);
+    std::string code = receiveResponse(req_socket, payloadMsg, service_name);
+    load->finish(std::chrono::steady_clock::now() - sent);
+    if (code == ResponseStatus::SERVICE_TIMEOUT)
+    {
+      req_socket.close();
+      throw ServiceException(service_name,
+                             std::string(ResponseStatus::SERVICE_TIMEOUT));
+    }
 
     // Deserialize response
     ByteView payload{static_cast<const uint8_t *>(payloadMsg.data()),
@@ -74,24 +114,177 @@ public:
    *
    * Requirements:
    * - RequestType and ResponseType must be serializable via encode/decode.
-   * - This function blocks until a response is received or an error occurs.
+   * - This function blocks until a response is received, an error occurs or
+   *   `timeout` expires.
    */
   template <typename RequestType, typename ResponseType>
-  static void zlcRequest(const std::string &service_name, const RequestType &request,
-                         ResponseType &response)
+  static void
+  zlcRequest(const std::string &service_name, const RequestType &request,
+             ResponseType &response,
+             std::chrono::milliseconds timeout =
+                 ClientManager::DEFAULT_REQUEST_TIMEOUT)
   {
-    auto serviceInfoPtr = NodeInfoManager::instance().getServiceInfo(service_name);
+    // Spread over all providers of the service
+    const std::string service_url =
+        ClientManager::instance().selectProvider(service_name);
+    if (service_url.empty())
+    {
+      zlc::error("Service {} is not available", service_name);
+      return;
+    }
+
+    zlcRequest<RequestType, ResponseType>(service_name, service_url, request, response,
+                                          timeout);
+  }
 
-    if (serviceInfoPtr == nullptr)
+  /**
+   * @brief Send a request without waiting for the reply.
+   *
+   * The callback runs on the client I/O thread with a ResponseStatus code and
+   * the decoded response (default-constructed unless the code is SUCCESS).
+   * Without a reply within `timeout` the code is SERVICE_TIMEOUT.
+   */
+  template <typename RequestType, typename ResponseType>
+  static void
+  requestAsync(const std::string &service_name, const std::string &service_url,
+               const RequestType &request, ResponseCallback<ResponseType> callback,
+               std::chrono::milliseconds timeout =
+                   ClientManager::DEFAULT_REQUEST_TIMEOUT)
+  {
+    ByteBuffer out;
+    encode(request, out);
+
+    ClientManager::instance().send(
+        service_url, service_name, Bytes(out.data, out.data + out.size),
+        [callback = std::move(callback)](const std::string &code,
+                                         const ByteView &payload)
+        {
+          ResponseType response{};
+          if (code != ResponseStatus::SUCCESS)
+          {
+            callback(code, response);
+            return;
+          }
+          try
+          {
+            if (payload.size != 0)
+            {
+              decode(payload, response);
+            }
+          }
+          catch (const std::exception &e)
+          {
+            zlc::error("[Client] Failed to decode response: {}", e.what());
+            callback(std::string(ResponseStatus::INVALID_RESPONSE), response);
+            return;
+          }
+          callback(code, response);
+        },
+        timeout);
+  }
+
+  template <typename RequestType, typename ResponseType>
+  static void
+  requestAsync(const std::string &service_name, const RequestType &request,
+               ResponseCallback<ResponseType> callback,
+               std::chrono::milliseconds timeout =
+                   ClientManager::DEFAULT_REQUEST_TIMEOUT)
+  {
+    const std::string service_url =
+        ClientManager::instance().selectProvider(service_name);
+    if (service_url.empty())
     {
       zlc::error("Service {} is not available", service_name);
+      callback(std::string(ResponseStatus::NOSERVICE), ResponseType{});
       return;
     }
 
-    const SocketInfo &serviceInfo = *serviceInfoPtr;
+    requestAsync<RequestType, ResponseType>(service_name, service_url, request,
+                                            std::move(callback), timeout);
+  }
+
+  /**
+   * @brief Send a request and return a future for the response.
+   *
+   * The future throws ServiceException if the call does not succeed.
+   */
+  template <typename RequestType, typename ResponseType>
+  static std::future<ResponseType>
+  requestAsync(const std::string &service_name, const RequestType &request,
+               std::chrono::milliseconds timeout =
+                   ClientManager::DEFAULT_REQUEST_TIMEOUT)
+  {
+    auto promise = std::make_shared<std::promise<ResponseType>>();
+    std::future<ResponseType> future = promise->get_future();
+    requestAsync<RequestType, ResponseType>(
+        service_name, request,
+        [promise, service_name](const std::string &code, const ResponseType &response)
+        {
+          if (code == ResponseStatus::SUCCESS)
+          {
+            promise->set_value(response);
+          }
+          else
+          {
+            promise->set_exception(
+                std::make_exception_ptr(ServiceException(service_name, code)));
+          }
+        },
+        timeout);
+    return future;
+  }
+
+  /**
+   * @brief Send a request to the service at `service_url` and expect no reply.
+   *
+   * Returns as soon as the request is queued. Requests to one provider are
+   * pipelined over its shared connection and arrive in order, although a
+   * provider with several workers may run them concurrently. Nothing tells
+   * the caller whether the handler ran or succeeded.
+   *
+   * @return false if the client is stopped.
+   */
+  template <typename RequestType>
+  static bool sendOneWay(const std::string &service_name,
+                         const std::string &service_url, const RequestType &request)
+  {
+    ByteBuffer out;
+    encode(request, out);
+    return ClientManager::instance().sendOneWay(service_url, service_name,
+                                                Bytes(out.data, out.data + out.size));
+  }
+
+  // As above, to one of the providers of `service_name`; false if there is none
+  template <typename RequestType>
+  static bool sendOneWay(const std::string &service_name, const RequestType &request)
+  {
     const std::string service_url =
-        "tcp://" + serviceInfo.ip + ":" + std::to_string(serviceInfo.port);
-    zlcRequest<RequestType, ResponseType>(service_name, service_url, request, response);
+        ClientManager::instance().selectProvider(service_name);
+    if (service_url.empty())
+    {
+      zlc::error("Service {} is not available", service_name);
+      return false;
+    }
+    return sendOneWay<RequestType>(service_name, service_url, request);
+  }
+
+  /**
+   * @brief Call a stream service and read its messages as they arrive.
+   *
+   * `window` is the number of messages the server may send ahead of the
+   * application; `timeout` applies to each message.
+   */
+  template <typename RequestType, typename ResponseType>
+  static StreamReader<ResponseType>
+  requestStream(const std::string &service_name, const RequestType &request,
+                uint32_t window = StreamReader<ResponseType>::DEFAULT_WINDOW,
+                std::chrono::milliseconds timeout =
+                    ClientManager::DEFAULT_REQUEST_TIMEOUT)
+  {
+    ByteBuffer out;
+    encode(request, out);
+    return StreamReader<ResponseType>(service_name, ByteView{out.data, out.size},
+                                      window, timeout);
   }
 };
 
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <zmq.hpp>
+
+#include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/load_balancer.hpp"
+#include "zerolancom/utils/guard_condition.hpp"
+#include "zerolancom/utils/periodic_task.hpp"
+#include "zerolancom/utils/singleton.hpp"
+#include "zerolancom/utils/zmq_utils.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief Called on the client I/O thread with the status code and the raw
+ * reply payload (empty unless the code is SUCCESS).
+ */
+using ReplyCallback =
+    std::function<void(const std::string &code, const ByteView &payload)>;
+
+/**
+ * @brief ClientManager multiplexes asynchronous service requests.
+ *
+ * Design notes:
+ * - One DEALER socket per service endpoint, created on first use and kept
+ *   until the node stops, so any number of requests share one connection.
+ * - Each request carries a 64-bit id as its envelope frame. The ROUTER of the
+ *   ServiceManager echoes the envelope, which correlates replies that arrive
+ *   out of order.
+ * - Only the I/O thread (a PeriodicTask on the shared ThreadPool) touches the
+ *   sockets. send() queues the request and wakes the thread through a
+ *   GuardCondition that is polled together with the sockets.
+ * - Every request has a deadline. The poll timeout follows the earliest one,
+ *   and expired requests complete with SERVICE_TIMEOUT; a reply arriving
+ *   afterwards is dropped.
+ * - Reply callbacks run on the I/O thread and should not block.
+ * - Requests still pending when the node stops complete with UNKNOWN_ERROR.
+ * - Blocking calls (see ServiceClient) do not go through the I/O thread. They
+ *   borrow a DEALER connection from a per-endpoint pool instead, so repeated
+ *   calls skip the TCP handshake and ZMQ session setup.
+ * - Requests to a provider that advertised a service id carry the compact
+ *   header (see serviceHeader()); others carry the service name.
+ * - One-way requests (see sendOneWay()) go through the same DEALER sockets
+ *   without an envelope id and are never tracked. When a socket's send
+ *   queue is full they wait in a per-endpoint backlog, which is flushed in
+ *   order as soon as the socket is writable again, so a burst of them is
+ *   pipelined rather than failed.
+ * - Calls addressed by service name are spread over all providers by
+ *   selectProvider(). Every call is counted in the EndpointLoad of its
+ *   endpoint, so the balancers see the load of all clients in the process.
+ */
+class ClientManager : public Singleton<ClientManager>
+{
+public:
+  static constexpr std::chrono::milliseconds DEFAULT_REQUEST_TIMEOUT{5000};
+
+  // Idle pooled connections kept per endpoint; more are closed on release
+  static constexpr size_t MAX_IDLE_CONNECTIONS = 8;
+
+  // One-way requests held per endpoint while its send queue is full; more
+  // are dropped
+  static constexpr size_t MAX_ONE_WAY_BACKLOG = 1 << 16;
+
+  ClientManager() = default;
+  ~ClientManager();
+
+  void start();
+  void stop();
+
+  /**
+   * @brief Queue a request to the service at `url`. Thread-safe.
+   *
+   * @param timeout Time from now until the request fails with SERVICE_TIMEOUT.
+   */
+  void send(const std::string &url, const std::string &service_name, Bytes payload,
+            ReplyCallback callback,
+            std::chrono::milliseconds timeout = DEFAULT_REQUEST_TIMEOUT);
+
+  /**
+   * @brief Queue a request to the service at `url` that gets no reply.
+   * Thread-safe.
+   *
+   * @return false if the manager is stopped.
+   */
+  bool sendOneWay(const std::string &url, const std::string &service_name,
+                  Bytes payload);
+
+  /**
+   * @brief Borrow a DEALER connection to `url` for blocking calls. Thread-safe.
+   *
+   * The socket belongs to the caller until it is handed back with
+   * releaseConnection(), and must only be used by one thread at a time.
+   */
+  ZMQSocket *acquireConnection(const std::string &url);
+  void releaseConnection(const std::string &url, ZMQSocket *socket);
+
+  // Pooled connections that are not borrowed
+  size_t idleConnections() const;
+
+  /**
+   * @brief Endpoint for the next call to `service_name`, or an empty string if
+   * no provider is known. Thread-safe.
+   *
+   * The provider list is refreshed when discovery changed since the last
+   * call to the same service.
+   */
+  std::string selectProvider(const std::string &service_name,
+                             std::string_view key = {});
+
+  // Policy of selectProvider(); LeastOutstanding by default
+  void setLoadBalancing(LoadBalancing policy);
+
+  // Endpoints of all known providers of `service_name`
+  static std::vector<std::string> providerUrls(const std::string &service_name);
+
+  /**
+   * @brief Id the provider at `url` advertised for `service_name`; 0 if it
+   * advertised none or is not known. Thread-safe.
+   */
+  uint32_t serviceId(const std::string &service_name, const std::string &url);
+
+  // Request header for a call to `url`: compact if the provider has an id
+  Bytes serviceHeader(const std::string &service_name, const std::string &url,
+                      uint32_t budget_ms, uint8_t flags = 0);
+
+  // Caller budget as sent in the service header: rounded up so that a
+  // nearly expired request still has one, and clamped to 32 bits
+  static uint32_t budgetMillis(std::chrono::nanoseconds remaining);
+
+  // Process-wide id for a blocking call, so that a pooled connection never
+  // sees two calls with the same id
+  static uint64_t nextCallId()
+  {
+    return next_call_id_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Requests sent or queued that have not completed yet
+  size_t pendingRequests() const
+  {
+    return pending_count_.load(std::memory_order_relaxed);
+  }
+
+  // One-way requests dropped because their backlog was full or on stop
+  uint64_t droppedOneWay() const
+  {
+    return dropped_one_way_.load(std::memory_order_relaxed);
+  }
+
+  // Non-copyable
+  ClientManager(const ClientManager &) = delete;
+  ClientManager &operator=(const ClientManager &) = delete;
+
+private:
+  struct Outgoing
+  {
+    std::string url;
+    std::string service_name;
+    Bytes payload;
+    ReplyCallback callback; // null for one-way requests
+    std::chrono::steady_clock::time_point deadline;
+    std::shared_ptr<EndpointLoad> load;
+  };
+
+  struct Pending
+  {
+    ReplyCallback callback;
+    std::shared_ptr<EndpointLoad> load;
+    std::chrono::steady_clock::time_point sent;
+  };
+
+  struct Route
+  {
+    uint64_t generation{0};
+    LoadBalancer balancer;
+    // Advertised service id by endpoint
+    std::unordered_map<std::string, uint32_t> ids;
+  };
+
+  using Deadline = std::pair<std::chrono::steady_clock::time_point, uint64_t>;
+
+  // Wait for and handle queued requests and incoming replies
+  void pollOnce();
+
+  void sendQueued();
+  // Send backlogged one-way requests until a send queue is full
+  void sendBacklog();
+  void receiveReplies(ZMQSocket &socket);
+  void expireRequests(std::chrono::steady_clock::time_point now);
+  // Poll timeout until the earliest deadline, or -1 without pending requests
+  std::chrono::milliseconds pollTimeout(std::chrono::steady_clock::time_point now);
+  ZMQSocket *endpoint(const std::string &url);
+  // Route of `service_name`, listing its providers again if discovery
+  // changed; requires routes_mutex_
+  Route &route(const std::string &service_name, uint64_t generation);
+
+  void complete(const ReplyCallback &callback, const std::string &code,
+                const ByteView &payload);
+  // Completes a sent request and records its latency
+  void complete(Pending &request, const std::string &code, const ByteView &payload);
+  void failAll();
+
+private:
+  std::mutex outbox_mutex_;
+  std::vector<Outgoing> outbox_;
+
+  // I/O thread only
+  std::unordered_map<std::string, ZMQSocket *> endpoints_;
+  std::unordered_map<uint64_t, Pending> pending_;
+  // Min-heap of request deadlines; completed ids are skipped when popped
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>
+      deadlines_;
+  uint64_t next_id_{1};
+  // One-way requests waiting for room in the send queue, by endpoint
+  std::unordered_map<std::string, std::deque<Outgoing>> backlog_;
+
+  std::atomic<size_t> pending_count_{0};
+  std::atomic<uint64_t> dropped_one_way_{0};
+
+  inline static std::atomic<uint64_t> next_call_id_{1};
+
+  // Idle connections for blocking calls, by endpoint
+  mutable std::mutex pool_mutex_;
+  std::unordered_map<std::string, std::vector<ZMQSocket *>> idle_connections_;
+
+  // Provider choice for calls by service name
+  std::mutex routes_mutex_;
+  std::unordered_map<std::string, Route> routes_;
+  LoadBalancing policy_{LoadBalancing::LeastOutstanding};
+
+  // Triggered when requests are queued or the poll loop should stop
+  GuardCondition wakeup_;
+  std::atomic<bool> stopping_{true}; // until start()
+
+  std::unique_ptr<PeriodicTask> poll_task_;
+};
+
+} // namespace zlc
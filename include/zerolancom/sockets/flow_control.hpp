@@ -0,0 +1,265 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/message_header.hpp"
+#include "zerolancom/utils/zmq_utils.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief What Publisher<T>::publish does when a subscriber has no credit left.
+ *
+ * - Block: wait for credit up to FlowControlOptions::block_timeout.
+ * - WouldBlock: return PublishStatus::WouldBlock without sending.
+ * - Buffer: keep the message in a bounded buffer and send it as credit
+ *   arrives; returns WouldBlock once the buffer budget is exhausted.
+ */
+enum class OverflowPolicy : uint8_t
+{
+  Block,
+  WouldBlock,
+  Buffer
+};
+
+enum class PublishStatus : uint8_t
+{
+  Ok,         // sent to every subscriber
+  Buffered,   // accepted, delivery to some subscribers is pending
+  WouldBlock, // rejected, nothing was sent
+  Timeout     // Block policy gave up, nothing was sent
+};
+
+/**
+ * @brief Publisher-side settings of credit-based flow control.
+ */
+struct FlowControlOptions
+{
+  bool enabled{false};
+  OverflowPolicy policy{OverflowPolicy::Block};
+
+  // Upper bound on message bytes held by the Buffer policy
+  size_t max_buffered_bytes{1 << 20};
+
+  std::chrono::milliseconds block_timeout{1000};
+
+  // Subscribers that stay silent this long are treated as gone
+  std::chrono::milliseconds peer_timeout{3000};
+};
+
+// Interval at which flow-controlled subscribers confirm they are alive
+constexpr std::chrono::milliseconds CREDIT_KEEPALIVE_INTERVAL{1000};
+
+// How long a closed credit link keeps trying to deliver its BYE
+constexpr std::chrono::milliseconds CREDIT_BYE_LINGER{100};
+
+// Window of consumer-group members that do not choose one; small windows keep
+// work spread evenly across members
+constexpr uint32_t DEFAULT_CONSUMER_GROUP_WINDOW = 4;
+
+/**
+ * @brief Control message exchanged on the credit channel.
+ *
+ * Binary format (network byte order / big-endian):
+ *   - type: uint8 (1 byte)
+ *   - credits: uint32 (4 bytes)
+ *
+ * HELLO may continue with the subscription's filter settings:
+ *   - group length: uint16, followed by the group name
+ *   - key count: uint16, followed by one (uint16 length, bytes) pair per key
+ *
+ * Minimum size: 5 bytes; only HELLO carries the extension.
+ */
+struct CreditMessage
+{
+  enum Type : uint8_t
+  {
+    Hello = 1,  // subscriber joins with an initial window
+    Credit = 2, // more messages may be sent (0 acts as keepalive)
+    Bye = 3,    // subscriber leaves
+    Rejoin = 4  // publisher does not know the subscriber; it must send HELLO
+  };
+
+  static constexpr size_t SIZE = 5;
+
+  uint8_t type{Credit};
+  uint32_t credits{0};
+
+  // Consumer group of the subscriber; empty to receive every message
+  std::string group;
+
+  // Message keys the subscriber wants; empty for all messages
+  std::vector<std::string> keys;
+
+  Bytes encode() const;
+
+  /**
+   * @throws std::runtime_error if data is too short or malformed
+   */
+  static CreditMessage decode(const uint8_t *data, size_t size);
+};
+
+/**
+ * @brief Publisher end of the credit channel.
+ *
+ * Flow-controlled subscribers connect a DEALER to this ROUTER socket, announce
+ * a window and keep granting credit as they consume messages. Their messages
+ * are sent over this channel instead of the PUB socket, one copy per
+ * subscriber, and only while they hold credit.
+ *
+ * Subscribers that join with a consumer group name share one copy: each
+ * message goes to exactly one member, the one with the most credit left
+ * (i.e. the least outstanding work), so a group behaves like a work queue.
+ *
+ * Subscribers that join with message keys only receive messages carrying one
+ * of those keys; other messages cost them neither bandwidth nor credit. The
+ * keys of a group are those of its first member.
+ *
+ * Design notes:
+ * - Not thread-safe; owned and driven by a single Publisher.
+ * - Control messages are processed whenever the publisher sends, so no extra
+ *   thread is needed.
+ * - At most `window` messages per subscriber are queued in ZMQ, and at most
+ *   `max_buffered_bytes` of payload in the local buffer.
+ * - Delivery to a group is at-most-once: messages in flight to a member that
+ *   leaves are not redelivered.
+ * - Only HELLO admits a subscriber. Credit from an unknown subscriber, e.g.
+ *   one that timed out or joined a restarted publisher, is answered with
+ *   REJOIN so that it announces its window, group and keys again.
+ */
+class CreditChannel
+{
+public:
+  CreditChannel(const std::string &ip, const FlowControlOptions &options);
+  ~CreditChannel();
+
+  // Non-copyable
+  CreditChannel(const CreditChannel &) = delete;
+  CreditChannel &operator=(const CreditChannel &) = delete;
+
+  /**
+   * @brief Deliver one message to every flow-controlled subscriber and to one
+   *        member of every consumer group.
+   *
+   * Nothing is sent when the result is WouldBlock or Timeout.
+   */
+  PublishStatus send(const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+                     const uint8_t *payload, size_t size);
+
+  /**
+   * @brief Same as send(), for a message carrying a key (see MessageKey).
+   */
+  PublishStatus send(const std::string &key,
+                     const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+                     const uint8_t *payload, size_t size);
+
+  /**
+   * @brief Send buffered messages to subscribers that gained credit.
+   */
+  void flush();
+
+  int port() const
+  {
+    return port_;
+  }
+
+  size_t bufferedBytes() const
+  {
+    return buffered_bytes_;
+  }
+
+  // Number of connected subscribers, group members included
+  size_t peerCount() const;
+
+  // Number of distinct consumer groups
+  size_t groupCount() const;
+
+private:
+  struct Peer
+  {
+    std::string identity;
+    uint64_t credits{0};
+    std::chrono::steady_clock::time_point last_seen;
+    bool alive{true};
+  };
+
+  // Unit of delivery: a consumer group, or a single ungrouped subscriber
+  struct Target
+  {
+    std::string group; // empty for a single subscriber
+    std::vector<Peer> members;
+
+    // Wanted message keys, encoded as key frames; empty for all messages
+    std::vector<std::string> key_frames;
+
+    // Absolute index of the next message this target should receive
+    uint64_t next{0};
+
+    // Round-robin start for picking among equally loaded members
+    size_t cursor{0};
+
+    // Member that should get the next message, or nullptr if none has credit
+    Peer *pick();
+
+    // True if some member has credit
+    bool ready() const;
+
+    // Whether the target wants a message with this key frame (empty: no key)
+    bool accepts(const std::string &key_frame) const;
+  };
+
+  struct BufferedMessage
+  {
+    std::string key_frame; // empty if the message has no key
+    std::array<uint8_t, MESSAGE_HEADER_SIZE> header;
+    Bytes payload;
+  };
+
+  PublishStatus sendFrames(const std::string &key_frame,
+                           const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+                           const uint8_t *payload, size_t size);
+
+  // Handle queued control messages, waiting up to `timeout` for the first
+  void processControl(std::chrono::milliseconds timeout);
+
+  // Ask a subscriber that is not (or no longer) admitted to send HELLO
+  void requestRejoin(zmq::message_t &identity);
+
+  Peer *findPeer(const std::string &identity);
+
+  void expirePeers(std::chrono::steady_clock::time_point now);
+
+  // Forget dead peers and targets without members
+  void removeDead();
+
+  // True if a new message can go out to every interested target immediately
+  bool canSendDirectly(const std::string &key_frame) const;
+
+  // Send one message to one member of a target, retrying on departed members
+  void sendTo(Target &target, const std::string &key_frame,
+              const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+              const uint8_t *payload, size_t size);
+
+  void flushBuffer();
+
+  ZMQSocket *socket_;
+  int port_{0};
+  FlowControlOptions options_;
+
+  std::vector<Target> targets_;
+
+  // Messages not yet delivered to every peer; front has index buffer_base_
+  std::deque<BufferedMessage> buffer_;
+  uint64_t buffer_base_{0};
+  size_t buffered_bytes_{0};
+};
+
+} // namespace zlc
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace zlc
+{
+
+/**
+ * @brief How a client spreads calls over the providers of one service.
+ */
+enum class LoadBalancing : uint8_t
+{
+  // Providers in turn
+  RoundRobin,
+  // Fewest calls in flight; ties are taken in turn
+  LeastOutstanding,
+  // Better of two random providers by latency estimate and calls in flight
+  PowerOfTwoChoices,
+  // The same request key always goes to the same provider while it is listed
+  StickyKey,
+};
+
+/**
+ * @brief Load of one service endpoint, shared by every client in the process.
+ *
+ * Design notes:
+ * - One instance per endpoint url (see of()), so blocking handles, temporary
+ *   sockets and asynchronous requests all see each other's calls.
+ * - The latency estimate is an exponentially weighted moving average; timed
+ *   out calls count with the time they waited, which steers load away from a
+ *   provider that stopped answering.
+ * - All members are atomics; updates from several threads may interleave, which
+ *   only blurs the estimate.
+ */
+class EndpointLoad
+{
+public:
+  // Weight of a new latency sample in the moving average
+  static constexpr double EWMA_ALPHA = 0.2;
+
+  static std::shared_ptr<EndpointLoad> of(const std::string &url);
+
+  void start()
+  {
+    outstanding_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Call completed (or timed out) after `latency`
+  void finish(std::chrono::nanoseconds latency);
+
+  // Call abandoned without a meaningful latency, e.g. on shutdown
+  void abandon()
+  {
+    outstanding_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  uint32_t outstanding() const
+  {
+    return outstanding_.load(std::memory_order_relaxed);
+  }
+
+  // Zero until the first call completed
+  std::chrono::nanoseconds latency() const
+  {
+    return std::chrono::nanoseconds(latency_ns_.load(std::memory_order_relaxed));
+  }
+
+private:
+  std::atomic<uint32_t> outstanding_{0};
+  std::atomic<int64_t> latency_ns_{0};
+};
+
+/**
+ * @brief LoadBalancer picks one of the providers of a service for each call.
+ *
+ * Usage:
+ *   LoadBalancer balancer(LoadBalancing::PowerOfTwoChoices);
+ *   balancer.setEndpoints(urls);
+ *   const std::string &url = balancer.endpoints()[balancer.pick()];
+ *
+ * Design notes:
+ * - Sticky keys use rendezvous hashing: each key goes to the provider with the
+ *   highest hash of (key, url). Only the keys of a provider that leaves or
+ *   joins move, and every client maps a key to the same provider without
+ *   coordination.
+ * - Providers without a latency sample yet win power-of-two comparisons, so
+ *   new replicas receive traffic right away.
+ * - Not thread-safe; callers serialize access.
+ */
+class LoadBalancer
+{
+public:
+  explicit LoadBalancer(LoadBalancing policy = LoadBalancing::LeastOutstanding);
+
+  void setPolicy(LoadBalancing policy)
+  {
+    policy_ = policy;
+  }
+
+  LoadBalancing policy() const
+  {
+    return policy_;
+  }
+
+  // Replace the provider list; the order only matters for RoundRobin
+  void setEndpoints(std::vector<std::string> urls);
+
+  const std::vector<std::string> &endpoints() const
+  {
+    return urls_;
+  }
+
+  EndpointLoad &load(size_t index)
+  {
+    return *loads_[index];
+  }
+
+  /**
+   * @brief Index into endpoints() for the next call.
+   *
+   * @param key Request key, only used by StickyKey.
+   * @pre endpoints() is not empty.
+   */
+  size_t pick(std::string_view key = {});
+
+private:
+  size_t pickLeastOutstanding();
+  size_t pickPowerOfTwo();
+  size_t pickSticky(std::string_view key) const;
+
+  LoadBalancing policy_;
+  std::vector<std::string> urls_;
+  std::vector<std::shared_ptr<EndpointLoad>> loads_;
+  size_t next_{0};
+  std::minstd_rand rng_;
+};
+
+} // namespace zlc
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace zlc
+{
+
+// Envelope format version written by this library
+constexpr uint8_t MESSAGE_HEADER_VERSION = 1;
+
+// Encoded size of a MessageHeader frame
+constexpr size_t MESSAGE_HEADER_SIZE = 18;
+
+/**
+ * @brief Envelope sent as the first frame of every published message.
+ *
+ * The payload frame that follows stays a plain msgpack buffer, so the header
+ * can be inspected without decoding the message.
+ *
+ * Binary format (network byte order / big-endian):
+ *   - version: uint8 (1 byte)
+ *   - flags: uint8 (1 byte, reserved)
+ *   - sequence: uint64 (8 bytes), per-publisher counter starting at 1
+ *   - stamp_ns: int64 (8 bytes), nanoseconds since the Unix epoch
+ *
+ * Total size: 18 bytes
+ *
+ * Messages from publishers that predate the envelope arrive as a single frame;
+ * they are reported with version 0, sequence 0 and the receive time as stamp.
+ */
+struct MessageHeader
+{
+  uint8_t version{MESSAGE_HEADER_VERSION};
+  uint8_t flags{0};
+  uint64_t sequence{0};
+  int64_t stamp_ns{0};
+
+  /**
+   * @brief Serialize the header (network byte order) without allocating.
+   */
+  std::array<uint8_t, MESSAGE_HEADER_SIZE> encode() const;
+
+  /**
+   * @brief Deserialize a header frame.
+   * @throws std::runtime_error if data is too short
+   */
+  static MessageHeader decode(const uint8_t *data, size_t size);
+
+  /**
+   * @brief Header used for single-frame messages without an envelope.
+   */
+  static MessageHeader legacy();
+
+  /**
+   * @brief Current wall-clock time in nanoseconds since the Unix epoch.
+   */
+  static int64_t now();
+
+  /**
+   * @brief Convert a system_clock time point to a header stamp.
+   */
+  static int64_t toStamp(std::chrono::system_clock::time_point time);
+};
+
+// First byte of a key frame; never a valid envelope version
+constexpr uint8_t MESSAGE_KEY_MARKER = 0xFE;
+
+/**
+ * @brief Optional routing key sent as a frame in front of the envelope.
+ *
+ * Publishers that declare a key extractor prefix every message with a key
+ * frame. Subscribers filtering on keys subscribe their SUB socket to the
+ * complete key frames they want instead of to everything, so the PUB socket
+ * only sends them matching messages.
+ *
+ * Binary format:
+ *   - marker: uint8 (MESSAGE_KEY_MARKER)
+ *   - key: bytes (must not contain NUL)
+ *   - terminator: uint8 (0), so that key "cam1" does not match "cam10"
+ */
+struct MessageKey
+{
+  static std::string encode(const std::string &key);
+
+  static bool isKeyFrame(const uint8_t *data, size_t size);
+
+  /**
+   * @brief Key carried by a frame for which isKeyFrame() is true.
+   */
+  static std::string decode(const uint8_t *data, size_t size);
+};
+
+} // namespace zlc
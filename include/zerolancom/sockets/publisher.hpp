@@ -1,5 +1,8 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -7,6 +10,8 @@
 
 #include "zerolancom/nodes/node_info_manager.hpp"
 #include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/flow_control.hpp"
+#include "zerolancom/sockets/message_header.hpp"
 #include "zerolancom/utils/logger.hpp"
 #include "zerolancom/utils/zmq_utils.hpp"
 
@@ -20,21 +25,33 @@ namespace zlc
  * - This is a template class and MUST remain header-only.
  * - All methods are defined inline to allow template instantiation.
  * - Each Publisher owns its own ZMQ PUB socket.
+ * - With flow control enabled it also owns a CreditChannel. Subscribers that
+ *   request flow control receive messages over that channel only while they
+ *   hold credit; other subscribers keep using the PUB socket.
+ * - Flow control also serves consumer groups (SubscribeOptions::consumer_group),
+ *   which turn the topic into a work queue for the members of each group.
+ * - With a key extractor, every message carries a key (see MessageKey) and
+ *   subscribers filtering on keys only receive matching messages; filtering
+ *   happens here, before anything is sent.
  */
 template <typename T> class Publisher
 {
 public:
+  using KeyExtractor = std::function<std::string(const T &)>;
+
   /**
    * @brief Construct a publisher for a given topic.
    *
    * @param topic_name Logical topic name
    * @param with_local_namespace If true, prefix with "lc.local."
+   * @param flow_control Credit-based flow control settings (off by default)
    *
    * Behavior:
    * - Binds to tcp://<local_ip>:0 (ephemeral port)
    * - Registers the topic with ZeroLanComNode
    */
-  explicit Publisher(const std::string &topic_name, bool with_local_namespace = false)
+  explicit Publisher(const std::string &topic_name, bool with_local_namespace = false,
+                     const FlowControlOptions &flow_control = {})
   {
     const std::string full_topic_name =
         with_local_namespace ? "lc.local." + topic_name : topic_name;
@@ -53,9 +70,18 @@ public:
     zlc::info("[Publisher] Publisher for topic '{}' bound to port {}", full_topic_name,
               port_);
 
+    uint16_t credit_port = 0;
+    if (flow_control.enabled)
+    {
+      credit_ = std::make_unique<CreditChannel>(address, flow_control);
+      credit_port = static_cast<uint16_t>(credit_->port());
+      zlc::info("[Publisher] Flow control for '{}' on port {}", full_topic_name,
+                credit_port);
+    }
+
     // Register topic in node discovery
-    NodeInfoManager::instance().registerLocalTopic(full_topic_name,
-                                                   static_cast<uint16_t>(port_));
+    NodeInfoManager::instance().registerLocalTopic(
+        full_topic_name, static_cast<uint16_t>(port_), credit_port);
   }
 
   // Destructor
@@ -66,22 +92,125 @@ public:
    *
    * Requirements:
    * - T must be serializable via encode()
-   * - This call is non-blocking (ZMQ PUB semantics)
+   * - This call is non-blocking (ZMQ PUB semantics), unless flow control is
+   *   enabled with OverflowPolicy::Block
+   *
+   * The message envelope is stamped with the current wall-clock time.
+   *
+   * @return Ok without flow control; otherwise see PublishStatus.
+   */
+  PublishStatus publish(const T &msg)
+  {
+    return publishStamped(msg, MessageHeader::now());
+  }
+
+  /**
+   * @brief Publish a message with an explicit envelope stamp.
+   *
+   * Use this to carry acquisition time (e.g. sensor capture time) so that
+   * subscribers can align messages across topics.
    */
-  void publish(const T &msg)
+  PublishStatus publish(const T &msg, std::chrono::system_clock::time_point stamp)
+  {
+    return publishStamped(msg, MessageHeader::toStamp(stamp));
+  }
+
+  /**
+   * @brief Attach a key to every message published from now on.
+   *
+   * Subscribers that set SubscribeOptions::keys then receive only messages
+   * whose key is listed there. Keys must not contain NUL characters.
+   */
+  void setKeyExtractor(KeyExtractor key)
+  {
+    key_ = std::move(key);
+  }
+
+  /**
+   * @brief Retry delivery of messages held by OverflowPolicy::Buffer.
+   *
+   * Buffered messages are also flushed on every publish() call.
+   */
+  void flush()
+  {
+    if (credit_)
+    {
+      credit_->flush();
+    }
+  }
+
+  // Payload bytes currently held by OverflowPolicy::Buffer
+  size_t bufferedBytes() const
+  {
+    return credit_ ? credit_->bufferedBytes() : 0;
+  }
+
+  // Number of subscribers currently receiving through flow control
+  size_t flowControlledSubscribers() const
+  {
+    return credit_ ? credit_->peerCount() : 0;
+  }
+
+  // Number of consumer groups this publisher distributes work to
+  size_t consumerGroups() const
+  {
+    return credit_ ? credit_->groupCount() : 0;
+  }
+
+private:
+  PublishStatus publishStamped(const T &msg, int64_t stamp_ns)
   {
     ByteBuffer out;
     encode(msg, out);
 
+    MessageHeader header;
+    header.sequence = sequence_ + 1;
+    header.stamp_ns = stamp_ns;
+    const auto header_bytes = header.encode();
+
+    std::string key;
+    if (key_)
+    {
+      key = key_(msg);
+    }
+
+    PublishStatus status = PublishStatus::Ok;
+    if (credit_)
+    {
+      status = key_ ? credit_->send(key, header_bytes, out.data, out.size)
+                    : credit_->send(header_bytes, out.data, out.size);
+      if (status == PublishStatus::WouldBlock || status == PublishStatus::Timeout)
+      {
+        return status;
+      }
+    }
+
+    ++sequence_;
+    if (key_)
+    {
+      // PUB matches subscriptions against this first frame
+      const std::string key_frame = MessageKey::encode(key);
+      socket_->send(zmq::buffer(key_frame), zmq::send_flags::sndmore);
+    }
+    socket_->send(zmq::buffer(header_bytes), zmq::send_flags::sndmore);
     socket_->send(zmq::buffer(out.data, out.size), zmq::send_flags::none);
+    return status;
   }
 
-private:
   // Owned PUB socket
   ZMQSocket *socket_;
 
   // Bound port number
   int port_{0};
+
+  // Envelope sequence number of the last published message
+  uint64_t sequence_{0};
+
+  // Side channel for flow-controlled subscribers (null when disabled)
+  std::unique_ptr<CreditChannel> credit_;
+
+  // Key of each message (empty when messages carry no key)
+  KeyExtractor key_;
 };
 
 } // namespace zlc
@@ -0,0 +1,563 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <zmq.hpp>
+
+#include "zerolancom/nodes/node_info_manager.hpp"
+#include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/client_manager.hpp"
+#include "zerolancom/sockets/load_balancer.hpp"
+#include "zerolancom/utils/exception.hpp"
+#include "zerolancom/utils/logger.hpp"
+#include "zerolancom/utils/request_result.hpp"
+#include "zerolancom/utils/zmq_utils.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief How often ServiceClient re-sends a call that got no answer.
+ *
+ * Only SERVICE_TIMEOUT, NOSERVICE and OVERLOADED are retried, and only
+ * while the call deadline has time left. A timed out request may still run
+ * on the server, so a retry may run it twice; enable retries for idempotent
+ * services only. An OVERLOADED request was not run.
+ */
+struct RetryPolicy
+{
+  uint32_t max_attempts{1};
+  std::chrono::milliseconds initial_backoff{10};
+  std::chrono::milliseconds max_backoff{500};
+  // Time allowed per attempt; zero lets one attempt use the whole deadline
+  std::chrono::milliseconds attempt_timeout{0};
+};
+
+/**
+ * @brief When ServiceClient sends a second copy of a slow call.
+ *
+ * A call without a reply after the `percentile` of recent call latencies
+ * (but at least `min_delay`) is sent to a second provider as well, and the
+ * first reply wins. Each call earns `max_extra_load` hedge tokens and each
+ * hedge spends one, so hedges add at most that fraction of extra requests.
+ * Like retries, hedging may run a request twice; enable it for idempotent
+ * services only.
+ */
+struct HedgePolicy
+{
+  bool enabled{false};
+  double percentile{0.95};
+  std::chrono::milliseconds min_delay{1};
+  double max_extra_load{0.1};
+};
+
+/**
+ * @brief ServiceClient is a reusable handle for calling one service.
+ *
+ * Usage:
+ *   ServiceClient<AddRequest, int> add("add");
+ *   int sum = add.call(AddRequest{1, 2}); // throws ServiceException on failure
+ *
+ * Design notes:
+ * - This is a template class and MUST remain header-only.
+ * - The providers are resolved on the first call and again only after
+ *   NodeInfoManager::discoveryGeneration() changed, so a call normally costs
+ *   one atomic load instead of a discovery lookup.
+ * - Each call goes to the provider chosen by a LoadBalancer
+ *   (LeastOutstanding by default, see setLoadBalancing()). With StickyKey the
+ *   key comes from setKeyExtractor().
+ * - Connections are borrowed from the ClientManager pool on first use of a
+ *   provider and handed back when the provider leaves or the handle is
+ *   destroyed, so new handles to a known endpoint do not pay for a TCP
+ *   handshake.
+ * - The request buffer is reused between calls.
+ * - Hedging (setHedgePolicy()) keeps the latencies of recent calls to derive
+ *   its delay and sends the hedge on the connection to another provider, so
+ *   both requests are awaited with one zmq::poll.
+ * - Every call has a deadline that is sent along with the request, so the
+ *   server can drop it once the caller gave up. A connection whose attempt
+ *   timed out is closed instead of pooled, since a late reply may follow.
+ * - Not thread-safe; use one handle per thread.
+ */
+template <typename RequestType, typename ResponseType> class ServiceClient
+{
+public:
+  explicit ServiceClient(std::string service_name,
+                         std::chrono::milliseconds timeout =
+                             ClientManager::DEFAULT_REQUEST_TIMEOUT,
+                         RetryPolicy retry = {})
+      : service_name_(std::move(service_name)), timeout_(timeout), retry_(retry)
+  {
+  }
+
+  ~ServiceClient()
+  {
+    disconnect();
+  }
+
+  // Non-copyable
+  ServiceClient(const ServiceClient &) = delete;
+  ServiceClient &operator=(const ServiceClient &) = delete;
+
+  /**
+   * @brief Call the service and return its response.
+   *
+   * @throws ServiceException if the call does not succeed.
+   */
+  ResponseType call(const RequestType &request)
+  {
+    ResponseType response{};
+    std::string code = call(request, response);
+    if (code != ResponseStatus::SUCCESS)
+    {
+      throw ServiceException(service_name_, code);
+    }
+    return response;
+  }
+
+  /**
+   * @brief Call the service, reporting failures as a ResponseStatus code.
+   *
+   * `response` is only written when the code is SUCCESS.
+   */
+  std::string call(const RequestType &request, ResponseType &response)
+  {
+    encode(request, buffer_);
+
+    auto deadline = std::chrono::steady_clock::now() + timeout_;
+    auto backoff = retry_.initial_backoff;
+    for (uint32_t attempt = 1;; ++attempt)
+    {
+      auto attempt_deadline = deadline;
+      if (retry_.attempt_timeout.count() > 0)
+      {
+        attempt_deadline = std::min(
+            deadline, std::chrono::steady_clock::now() + retry_.attempt_timeout);
+      }
+
+      std::string code = callOnce(request, attempt_deadline, response);
+      if ((code != ResponseStatus::SERVICE_TIMEOUT &&
+           code != ResponseStatus::NOSERVICE && code != ResponseStatus::OVERLOADED) ||
+          attempt >= retry_.max_attempts)
+      {
+        return code;
+      }
+
+      // Full jitter keeps retrying clients from arriving in lockstep
+      auto remaining = deadline - std::chrono::steady_clock::now();
+      if (remaining <= std::chrono::nanoseconds::zero())
+      {
+        return code;
+      }
+      std::chrono::nanoseconds pause = jitter(backoff);
+      std::this_thread::sleep_for(std::min(pause, remaining));
+      backoff = std::min(backoff * 2, retry_.max_backoff);
+    }
+  }
+
+  void setTimeout(std::chrono::milliseconds timeout)
+  {
+    timeout_ = timeout;
+  }
+
+  void setRetryPolicy(const RetryPolicy &retry)
+  {
+    retry_ = retry;
+  }
+
+  void setHedgePolicy(const HedgePolicy &hedge)
+  {
+    hedge_ = hedge;
+  }
+
+  // Hedge requests sent so far
+  uint64_t hedgesSent() const
+  {
+    return hedges_sent_;
+  }
+
+  void setLoadBalancing(LoadBalancing policy)
+  {
+    balancer_.setPolicy(policy);
+  }
+
+  // Key of a request for LoadBalancing::StickyKey
+  void setKeyExtractor(std::function<std::string(const RequestType &)> extractor)
+  {
+    key_extractor_ = std::move(extractor);
+  }
+
+  const std::string &name() const
+  {
+    return service_name_;
+  }
+
+  // Endpoint of the provider of the last call; empty before the first call
+  const std::string &endpoint() const
+  {
+    return url_;
+  }
+
+private:
+  // Latencies kept for the hedge delay, and how many are needed before the
+  // first hedge
+  static constexpr size_t HEDGE_WINDOW = 128;
+  static constexpr size_t HEDGE_MIN_SAMPLES = 16;
+  // Hedge tokens that can be saved up for a burst of slow calls
+  static constexpr double HEDGE_BURST = 10.0;
+
+  // Pick the provider for `request`, listing the providers again if
+  // discovery changed since the last call
+  bool resolve(const RequestType &request)
+  {
+    uint64_t generation = NodeInfoManager::instance().discoveryGeneration();
+    if (!resolved_ || generation != generation_)
+    {
+      std::vector<std::string> urls = ClientManager::providerUrls(service_name_);
+      if (urls.empty())
+      {
+        zlc::error("[ServiceClient] Service '{}' is not available", service_name_);
+        disconnect();
+        return false;
+      }
+
+      // Keep the connections to providers that are still listed
+      std::vector<ZMQSocket *> connections(urls.size(), nullptr);
+      const auto &known = balancer_.endpoints();
+      for (size_t i = 0; i < known.size(); ++i)
+      {
+        auto it = std::find(urls.begin(), urls.end(), known[i]);
+        size_t index = it - urls.begin();
+        if (it != urls.end() && connections[index] == nullptr)
+        {
+          connections[index] = connections_[i];
+        }
+        else
+        {
+          release(known[i], connections_[i]);
+        }
+      }
+      // Looked up once here rather than on every call
+      service_ids_.clear();
+      for (const auto &url : urls)
+      {
+        service_ids_.push_back(ClientManager::instance().serviceId(service_name_, url));
+      }
+      balancer_.setEndpoints(std::move(urls));
+      connections_ = std::move(connections);
+      generation_ = generation;
+      resolved_ = true;
+    }
+
+    std::string key;
+    if (key_extractor_ && balancer_.policy() == LoadBalancing::StickyKey)
+    {
+      key = key_extractor_(request);
+    }
+    current_ = balancer_.pick(key);
+    url_ = balancer_.endpoints()[current_];
+    return true;
+  }
+
+  static void release(const std::string &url, ZMQSocket *socket)
+  {
+    if (socket == nullptr)
+    {
+      return;
+    }
+    if (ClientManager::isInitialized())
+    {
+      ClientManager::instance().releaseConnection(url, socket);
+    }
+    else
+    {
+      ZMQContext::releaseSocket(socket);
+    }
+  }
+
+  void disconnect()
+  {
+    const auto &known = balancer_.endpoints();
+    for (size_t i = 0; i < connections_.size(); ++i)
+    {
+      release(known[i], connections_[i]);
+    }
+    connections_.clear();
+    service_ids_.clear();
+    balancer_.setEndpoints({});
+    resolved_ = false;
+    url_.clear();
+  }
+
+  // A request on its way to one provider
+  struct Flight
+  {
+    size_t index{0};
+    uint64_t id{0};
+    std::chrono::steady_clock::time_point sent;
+  };
+
+  // One attempt, hedged to a second provider when enabled, giving up at
+  // `deadline`
+  std::string callOnce(const RequestType &request,
+                       std::chrono::steady_clock::time_point deadline,
+                       ResponseType &response)
+  {
+    if (!resolve(request))
+    {
+      return std::string(ResponseStatus::NOSERVICE);
+    }
+    hedge_tokens_ = std::min(hedge_tokens_ + hedge_.max_extra_load, HEDGE_BURST);
+
+    std::array<Flight, 2> flights;
+    size_t in_flight = 0;
+    flights[in_flight++] = send(current_, deadline);
+    auto hedge_at = hedgeTime(flights[0].sent);
+
+    while (true)
+    {
+      auto wait_until = in_flight == 1 ? std::min(deadline, hedge_at) : deadline;
+      size_t ready = waitReadable(flights.data(), in_flight, wait_until);
+      if (ready == in_flight)
+      {
+        if (in_flight == 1 && std::chrono::steady_clock::now() < deadline)
+        {
+          // Only one hedge per attempt
+          hedge_at = std::chrono::steady_clock::time_point::max();
+          size_t other = hedgeTarget(current_);
+          if (other != current_ && hedge_tokens_ >= 1.0)
+          {
+            hedge_tokens_ -= 1.0;
+            ++hedges_sent_;
+            flights[in_flight++] = send(other, deadline);
+          }
+          continue;
+        }
+
+        for (size_t i = 0; i < in_flight; ++i)
+        {
+          // Counted with the time waited, so balancers avoid this provider
+          balancer_.load(flights[i].index)
+              .finish(std::chrono::steady_clock::now() - flights[i].sent);
+          zlc::warn("[ServiceClient] Call to '{}' at {} timed out", service_name_,
+                    balancer_.endpoints()[flights[i].index]);
+          dropConnection(flights[i].index);
+        }
+        return std::string(ResponseStatus::SERVICE_TIMEOUT);
+      }
+
+      const Flight &flight = flights[ready];
+      size_t count = receiveMultipart(*connections_[flight.index], frames_);
+
+      // Replies to earlier calls on this connection are skipped
+      if (count != frames_.size() || frames_[0].size() != sizeof(flight.id) ||
+          std::memcmp(frames_[0].data(), &flight.id, sizeof(flight.id)) != 0)
+      {
+        continue;
+      }
+
+      // The first reply wins. The other one is left in flight and skipped by
+      // its id whenever its connection is read next; its latency is a lower
+      // bound, which is enough to steer the balancer away from a slow provider
+      const auto now = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < in_flight; ++i)
+      {
+        balancer_.load(flights[i].index).finish(now - flights[i].sent);
+      }
+      recordLatency(now - flights[0].sent);
+      url_ = balancer_.endpoints()[flight.index];
+
+      std::string code(decodeStatus(ByteView{
+          static_cast<const uint8_t *>(frames_[2].data()), frames_[2].size()}));
+      if (code != ResponseStatus::SUCCESS)
+      {
+        return code;
+      }
+
+      ByteView payload{static_cast<const uint8_t *>(frames_[3].data()),
+                       frames_[3].size()};
+      try
+      {
+        if (payload.size != 0)
+        {
+          decode(payload, response);
+        }
+      }
+      catch (const std::exception &e)
+      {
+        zlc::error("[ServiceClient] Failed to decode response of '{}': {}",
+                   service_name_, e.what());
+        return std::string(ResponseStatus::INVALID_RESPONSE);
+      }
+      return code;
+    }
+  }
+
+  // Send the encoded request to the provider at `index`
+  Flight send(size_t index, std::chrono::steady_clock::time_point deadline)
+  {
+    const std::string &url = balancer_.endpoints()[index];
+    ZMQSocket *&socket = connections_[index];
+    if (socket == nullptr)
+    {
+      socket = ClientManager::instance().acquireConnection(url);
+    }
+
+    // Frames: [request id][empty delimiter][service header][payload]
+    Flight flight{index, ClientManager::nextCallId(), std::chrono::steady_clock::now()};
+    uint32_t budget =
+        std::max<uint32_t>(1, ClientManager::budgetMillis(deadline - flight.sent));
+    Bytes header = service_ids_[index] != 0
+                       ? encodeServiceHeader(service_ids_[index], budget)
+                       : encodeServiceHeader(service_name_, budget);
+    socket->send(zmq::buffer(&flight.id, sizeof(flight.id)), zmq::send_flags::sndmore);
+    socket->send(zmq::message_t(), zmq::send_flags::sndmore);
+    socket->send(zmq::buffer(header), zmq::send_flags::sndmore);
+    socket->send(zmq::buffer(buffer_.data, buffer_.size), zmq::send_flags::none);
+
+    balancer_.load(index).start();
+    return flight;
+  }
+
+  // Index of the first flight with a reply, or `count` at `until`
+  size_t waitReadable(const Flight *flights, size_t count,
+                      std::chrono::steady_clock::time_point until)
+  {
+    std::array<zmq::pollitem_t, 2> items;
+    for (size_t i = 0; i < count; ++i)
+    {
+      items[i] = {connections_[flights[i].index]->handle(), 0, ZMQ_POLLIN, 0};
+    }
+    while (true)
+    {
+      auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+          until - std::chrono::steady_clock::now());
+      if (remaining.count() <= 0)
+      {
+        return count;
+      }
+      if (zmq::poll(items.data(), count, remaining) > 0)
+      {
+        for (size_t i = 0; i < count; ++i)
+        {
+          if (items[i].revents & ZMQ_POLLIN)
+          {
+            return i;
+          }
+        }
+      }
+    }
+  }
+
+  // When to hedge a request sent at `sent`; never without enough samples
+  std::chrono::steady_clock::time_point
+  hedgeTime(std::chrono::steady_clock::time_point sent)
+  {
+    if (!hedge_.enabled || balancer_.endpoints().size() < 2 ||
+        latencies_.size() < HEDGE_MIN_SAMPLES)
+    {
+      return std::chrono::steady_clock::time_point::max();
+    }
+
+    sorted_latencies_.assign(latencies_.begin(), latencies_.end());
+    double rank = hedge_.percentile * static_cast<double>(latencies_.size() - 1);
+    auto nth = sorted_latencies_.begin() + static_cast<ptrdiff_t>(rank);
+    std::nth_element(sorted_latencies_.begin(), nth, sorted_latencies_.end());
+    return sent + std::max<std::chrono::nanoseconds>(*nth, hedge_.min_delay);
+  }
+
+  // Another provider for the hedge; the primary if there is none
+  size_t hedgeTarget(size_t primary)
+  {
+    const size_t count = balancer_.endpoints().size();
+    if (count < 2)
+    {
+      return primary;
+    }
+    if (balancer_.policy() != LoadBalancing::StickyKey)
+    {
+      for (int tries = 0; tries < 3; ++tries)
+      {
+        size_t index = balancer_.pick();
+        if (index != primary)
+        {
+          return index;
+        }
+      }
+    }
+    return (primary + 1) % count;
+  }
+
+  void recordLatency(std::chrono::nanoseconds latency)
+  {
+    if (!hedge_.enabled)
+    {
+      return;
+    }
+    if (latencies_.size() < HEDGE_WINDOW)
+    {
+      latencies_.push_back(latency);
+    }
+    else
+    {
+      latencies_[next_latency_++ % HEDGE_WINDOW] = latency;
+    }
+  }
+
+  // A timed-out connection may still deliver the late reply, so it is closed
+  // rather than pooled; the next attempt lists the providers again
+  void dropConnection(size_t index)
+  {
+    ZMQContext::releaseSocket(connections_[index]);
+    connections_[index] = nullptr;
+    resolved_ = false;
+    url_.clear();
+  }
+
+  static std::chrono::nanoseconds jitter(std::chrono::milliseconds backoff)
+  {
+    static thread_local std::mt19937_64 rng{std::random_device{}()};
+    std::uniform_int_distribution<int64_t> dist(
+        0, std::chrono::nanoseconds(backoff).count());
+    return std::chrono::nanoseconds(dist(rng));
+  }
+
+  std::string service_name_;
+  std::string url_;
+  uint64_t generation_{0};
+  bool resolved_{false};
+
+  LoadBalancer balancer_;
+  // Connection per entry of balancer_.endpoints(); null until first used
+  std::vector<ZMQSocket *> connections_;
+  // Advertised service id per endpoint; 0 sends the service name
+  std::vector<uint32_t> service_ids_;
+  size_t current_{0};
+  std::function<std::string(const RequestType &)> key_extractor_;
+  std::chrono::milliseconds timeout_;
+  RetryPolicy retry_;
+
+  HedgePolicy hedge_;
+  double hedge_tokens_{0.0};
+  uint64_t hedges_sent_{0};
+  // Recent call latencies, a ring of HEDGE_WINDOW entries
+  std::vector<std::chrono::nanoseconds> latencies_;
+  std::vector<std::chrono::nanoseconds> sorted_latencies_;
+  size_t next_latency_{0};
+
+  ByteBuffer buffer_;
+  // Reply frames: [request id][empty delimiter][status code][payload]
+  std::array<zmq::message_t, 4> frames_;
+};
+
+} // namespace zlc
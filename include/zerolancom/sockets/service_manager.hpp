@@ -1,14 +1,25 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <zmq.hpp>
 
 #include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/utils/guard_condition.hpp"
+#include "zerolancom/utils/latency_histogram.hpp"
 #include "zerolancom/utils/logger.hpp"
 #include "zerolancom/utils/periodic_task.hpp"
 #include "zerolancom/utils/request_result.hpp"
@@ -18,23 +29,325 @@
 namespace zlc
 {
 
-using ServiceCallback = std::function<Bytes(const ByteView &payload)>;
+// Encodes the response to `payload` into `out`
+using ServiceCallback = std::function<void(const ByteView &payload, ByteBuffer &out)>;
+
+/**
+ * @brief A reply on its way to the ServiceManager polling thread.
+ */
+struct ServiceReply
+{
+  std::vector<zmq::message_t> route; // ROUTER envelope of the request
+  std::string service_name;
+  Response response;
+  bool more{false}; // a stream message; the request is not answered yet
+  bool compact{false}; // the request had a compact header; see sendResponse()
+  // Encoded payload ready for ZMQ; sent instead of response.payload if set
+  zmq::message_t body{};
+};
+
+/**
+ * @brief Replies produced on other threads, sent by the polling thread.
+ *
+ * push() is thread-safe and triggers wakeup(), which the polling thread
+ * waits on together with the ROUTER socket.
+ */
+class ServiceReplyQueue
+{
+public:
+  void push(ServiceReply reply);
+  std::vector<ServiceReply> take();
+
+  GuardCondition &wakeup()
+  {
+    return wakeup_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<ServiceReply> replies_;
+  GuardCondition wakeup_;
+};
+
+/**
+ * @brief Answers one deferred service request.
+ *
+ * Usage:
+ *   manager.registerDeferredHandler("plan",
+ *       [](const ByteView &payload, ServiceResponder responder)
+ *       { jobs.push({decodeRequest(payload), std::move(responder)}); },
+ *       std::chrono::seconds(5));
+ *   ...
+ *   job.responder.reply(encodeResult(result)); // from any thread
+ *
+ * Design notes:
+ * - Copies share one request; only the first reply() or fail() is sent.
+ * - Unanswered requests fail with SERVICE_TIMEOUT once the timeout given at
+ *   registration expires; later replies are ignored.
+ * - A responder may outlive the ServiceManager; replying is then a no-op.
+ */
+class ServiceResponder
+{
+public:
+  ServiceResponder() = default;
+
+  /**
+   * @return false if the request was already answered or timed out.
+   */
+  bool reply(Bytes payload);
+
+  /**
+   * @brief Answer with an error status from ResponseStatus.
+   */
+  bool fail(std::string_view code);
+
+  // Answered, timed out or empty
+  bool done() const;
+
+private:
+  friend class ServiceManager;
+
+  struct State
+  {
+    std::shared_ptr<ServiceReplyQueue> queue;
+    std::vector<zmq::message_t> route;
+    std::string service_name;
+    bool compact{false};
+    std::atomic<bool> done{false};
+  };
+
+  explicit ServiceResponder(std::shared_ptr<State> state) : state_(std::move(state))
+  {
+  }
+
+  bool send(Response response);
+
+  std::shared_ptr<State> state_;
+};
+
+using DeferredServiceCallback =
+    std::function<void(const ByteView &payload, ServiceResponder responder)>;
+
+/**
+ * @brief Sends the messages of one streamed response.
+ *
+ * Usage:
+ *   manager.registerRawStreamHandler("tiles",
+ *       [](const ByteView &payload, ServiceStreamWriter &writer)
+ *       {
+ *         for (auto &tile : loadTiles(decodeQuery(payload)))
+ *           if (!writer.write(encodeTile(tile))) return; // reader is gone
+ *       });
+ *
+ * Design notes:
+ * - The reader grants credit for a window of messages with its request and
+ *   renews it as it consumes them. write() blocks while no credit is left, so
+ *   at most one window of messages is buffered between handler and reader.
+ * - write() returns false once the reader cancelled, granted no credit for
+ *   the time budget of its request, or the ServiceManager stops. The handler
+ *   should return then.
+ * - The stream ends when the handler returns; an exception ends it with an
+ *   error status instead.
+ */
+class ServiceStreamWriter
+{
+public:
+  // Credit wait for requests without a time budget
+  static constexpr std::chrono::milliseconds DEFAULT_IDLE_TIMEOUT{5000};
+
+  /**
+   * @return false if the message was not sent and the stream is over.
+   */
+  bool write(Bytes payload);
+
+  bool cancelled() const;
+
+private:
+  friend class ServiceManager;
+
+  struct State
+  {
+    std::shared_ptr<ServiceReplyQueue> queue;
+    std::vector<zmq::message_t> route;
+    std::string service_name;
+    bool compact{false};
+    std::chrono::milliseconds idle_timeout{DEFAULT_IDLE_TIMEOUT};
+
+    mutable std::mutex mutex;
+    std::condition_variable credit_changed;
+    uint64_t credit{0};
+    bool cancelled{false};
+    bool timed_out{false};
+
+    // Add credit; 0 cancels the stream
+    void grant(uint32_t amount);
+  };
+
+  explicit ServiceStreamWriter(std::shared_ptr<State> state)
+      : state_(std::move(state))
+  {
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+/**
+ * @brief Typed view of a ServiceStreamWriter, see registerStreamHandler().
+ */
+template <typename T> class StreamWriter
+{
+public:
+  explicit StreamWriter(ServiceStreamWriter &writer) : writer_(writer)
+  {
+  }
+
+  bool write(const T &message)
+  {
+    encode(message, buffer_);
+    return writer_.write(Bytes(buffer_.data, buffer_.data + buffer_.size));
+  }
+
+  bool cancelled() const
+  {
+    return writer_.cancelled();
+  }
+
+private:
+  ServiceStreamWriter &writer_;
+  ByteBuffer buffer_;
+};
+
+using StreamServiceCallback =
+    std::function<void(const ByteView &payload, ServiceStreamWriter &writer)>;
+
+/**
+ * @brief Answers a batch of requests; `responses` has one default (SUCCESS)
+ * entry per payload, to be filled in place.
+ */
+using BatchServiceCallback = std::function<void(const std::vector<ByteView> &payloads,
+                                                std::vector<Response> &responses)>;
+
+/**
+ * @brief When a batch handler is called, see registerBatchHandler().
+ */
+struct BatchOptions
+{
+  size_t max_batch_size{32};
+  // Longest time the oldest request of a batch waits for more to arrive
+  std::chrono::microseconds max_wait{std::chrono::milliseconds(2)};
+};
+
+/**
+ * @brief How responses of an idempotent service are shared, see
+ * ServiceManager::setIdempotent().
+ */
+struct ResponseCacheOptions
+{
+  // How long a response is reused; 0 only merges concurrent requests
+  std::chrono::milliseconds ttl{std::chrono::seconds(1)};
+  // Bound on the cached request and response bytes of the service
+  size_t max_bytes{64 << 20};
+};
+
+/**
+ * @brief Limits on the requests of one service, see
+ * ServiceManager::setAdmission(). 0 means no limit.
+ */
+struct AdmissionOptions
+{
+  // Requests handed to workers at once; more wait in line
+  size_t max_in_flight{0};
+  // Requests waiting to start; further ones are rejected with OVERLOADED
+  size_t max_queued{0};
+  // Requests that waited longer to start are rejected with OVERLOADED
+  std::chrono::milliseconds max_queue_time{0};
+};
+
+/**
+ * @brief Admission counters of a service, see
+ * ServiceManager::serviceStatistics().
+ */
+struct ServiceStatistics
+{
+  uint64_t accepted{0}; // handed to the handler
+  uint64_t shed{0};     // rejected with OVERLOADED
+  size_t queued{0};     // waiting to start
+  size_t in_flight{0};  // started and not answered yet
+  // Time from arrival until a worker took the request up
+  std::chrono::microseconds queue_time_p50{0};
+  std::chrono::microseconds queue_time_p90{0};
+  std::chrono::microseconds queue_time_p99{0};
+};
 
 /**
  * @brief ServiceManager handles incoming RPC service requests.
  *
  * Design notes:
- * - Uses ZMQ REP socket for request handling with PeriodicTask for polling.
- * - All polling tasks use the shared ThreadPool from ZeroLanComNode.
+ * - A ZMQ ROUTER socket receives requests on a PeriodicTask of the shared
+ *   ThreadPool and hands them to a dedicated worker pool, so slow handlers
+ *   run concurrently and do not hold up other services.
+ * - Only the polling thread touches the ROUTER socket. Workers queue their
+ *   replies and trigger a GuardCondition that is polled together with the
+ *   socket; replies are routed back by the peer identity of the request.
+ * - The poll blocks until a request or reply arrives; stop() wakes it through
+ *   the same GuardCondition, so there is no polling interval.
+ * - setConcurrencyLimit() caps how many requests of one service run at
+ *   once; requests above the limit wait in arrival order.
+ * - Deferred handlers return without answering and reply later through a
+ *   ServiceResponder, so no thread waits for the answer. They count towards
+ *   the concurrency limit until answered or timed out.
+ * - Stream handlers answer one request with a sequence of STREAM_ITEM
+ *   replies and a final status, paced by credit from the reader (see
+ *   ServiceStreamWriter). Credit messages are matched to their stream by the
+ *   request envelope and never reach a handler.
+ * - Batch handlers receive the requests collected while the previous batch
+ *   of the same service ran, up to a size and age limit. A request arriving
+ *   while no batch runs is handed over at once, so batching costs no
+ *   latency on an idle server and grows with the load.
+ * - Each registered service gets a numeric id (see serviceId()), advertised
+ *   through discovery. Clients that know it send a compact header with the
+ *   id instead of the name and get a one-byte status back; requests with a
+ *   service name are answered with the status as a string, as before.
+ * - One-way requests (SERVICE_FLAG_ONE_WAY in the header) run like any
+ *   other but are never answered; they bypass the response cache.
+ * - Admission control (see setAdmission()) answers OVERLOADED at once when
+ *   a service has too many requests waiting, or when one waited too long
+ *   to start; the polling thread sheds those held back by max_in_flight as
+ *   soon as they are due. A shed request never ran, so a caller can safely
+ *   retry it elsewhere, and the others are answered in time instead of all
+ *   timing out together.
+ * - Requests to an idempotent service (see setIdempotent()) with the same
+ *   payload as one being handled wait for its response instead of running
+ *   the handler again, and successful responses are reused until their
+ *   TTL. They are keyed by a hash of the request bytes, which are kept
+ *   once per entry to rule out collisions, and share the encoded
+ *   response message, so neither costs a handler call or a copy. Expired
+ *   responses are dropped whenever a new one is cached.
+ * - Request payloads are decoded with decodeInPlace() straight from the
+ *   received ZMQ message, so a handler taking std::string_view (or a type
+ *   holding one) reads the request without a copy, valid until the
+ *   handler returns. Responses are encoded into a buffer that ZMQ takes
+ *   over instead of copying; small ones below ZERO_COPY_THRESHOLD are
+ *   copied, which is cheaper.
+ * - Requests carry the caller's remaining time budget. Requests whose
+ *   caller gave up before a worker picked them up are answered with
+ *   SERVICE_TIMEOUT without running the handler.
+ * - Handlers may be called from several workers at the same time.
  * - Template registerHandler functions must remain header-only.
  * - Non-template functions are implemented in service_manager.cpp.
  */
 class ServiceManager : public Singleton<ServiceManager>
 {
 public:
+  // Encoded responses from this size on are handed to ZMQ without a copy
+  static constexpr size_t ZERO_COPY_THRESHOLD = 4096;
+
   int service_port{0};
 
-  explicit ServiceManager(const std::string &ip);
+  /**
+   * @param workers Number of handler threads; 0 uses one per hardware thread.
+   */
+  explicit ServiceManager(const std::string &ip, size_t workers = 0);
   ~ServiceManager();
 
   void start();
@@ -47,15 +360,13 @@ public:
   void registerHandler(const std::string &name,
                        const std::function<ResponseType(const RequestType &)> &func)
   {
-    handlers_[name] = [func](const ByteView &payload) -> Bytes
-    {
-      RequestType req;
-      decode(payload, req);
-      ResponseType resp = func(req);
-      ByteBuffer out;
-      encode(resp, out);
-      return Bytes(out.data, out.data + out.size);
-    };
+    addHandler(name,
+               [func](const ByteView &payload, ByteBuffer &out)
+               {
+                 RequestType req;
+                 decodeInPlace(payload, req);
+                 encode(func(req), out);
+               });
   }
 
   template <typename RequestType, typename ResponseType, typename ClassT>
@@ -63,23 +374,216 @@ public:
                        ResponseType (ClassT::*func)(const RequestType &),
                        ClassT *instance)
   {
-    handlers_[name] = [instance, func](const ByteView &payload) -> Bytes
-    {
-      RequestType req;
-      decode(payload, req);
-      ResponseType resp = (instance->*func)(req);
-      ByteBuffer out;
-      encode(resp, out);
-      return Bytes(out.data, out.data + out.size);
-    };
+    addHandler(name,
+               [instance, func](const ByteView &payload, ByteBuffer &out)
+               {
+                 RequestType req;
+                 decodeInPlace(payload, req);
+                 encode((instance->*func)(req), out);
+               });
   }
 
+  /**
+   * @brief Register a handler that answers through a ServiceResponder.
+   *
+   * The callback runs on a worker and must not block; the payload view is
+   * only valid during the call. Requests still unanswered after `timeout`
+   * fail with SERVICE_TIMEOUT.
+   */
+  void registerDeferredHandler(const std::string &name,
+                               DeferredServiceCallback callback,
+                               std::chrono::milliseconds timeout);
+
+  /**
+   * @brief Register a handler that answers many requests in one call.
+   *
+   * The handler returns one response per request, in request order. Each
+   * response is routed back to its own caller.
+   *
+   * Usage:
+   *   manager.registerBatchHandler<Image, Label>("classify",
+   *       [](const std::vector<Image> &images) { return model.run(images); },
+   *       BatchOptions{64, std::chrono::milliseconds(5)});
+   */
+  template <typename RequestType, typename ResponseType>
+  void registerBatchHandler(
+      const std::string &name,
+      const std::function<std::vector<ResponseType>(const std::vector<RequestType> &)>
+          &func,
+      const BatchOptions &options = {})
+  {
+    registerRawBatchHandler(
+        name,
+        [func](const std::vector<ByteView> &payloads, std::vector<Response> &responses)
+        {
+          // Requests that cannot be decoded fail alone
+          std::vector<RequestType> requests;
+          std::vector<size_t> index;
+          requests.reserve(payloads.size());
+          for (size_t i = 0; i < payloads.size(); ++i)
+          {
+            try
+            {
+              RequestType req;
+              decodeInPlace(payloads[i], req);
+              requests.push_back(std::move(req));
+              index.push_back(i);
+            }
+            catch (const DecodeException &e)
+            {
+              zlc::error("[ServiceManager] Failed to decode batched request: {}",
+                         e.what());
+              responses[i].code = ResponseStatus::INVALID_REQUEST;
+            }
+          }
+          if (requests.empty())
+          {
+            return;
+          }
+
+          std::vector<ResponseType> results = func(requests);
+          if (results.size() != requests.size())
+          {
+            throw std::runtime_error("batch handler returned " +
+                                     std::to_string(results.size()) +
+                                     " responses for " +
+                                     std::to_string(requests.size()) + " requests");
+          }
+          ByteBuffer out;
+          for (size_t k = 0; k < results.size(); ++k)
+          {
+            encode(results[k], out);
+            responses[index[k]].payload.assign(out.data, out.data + out.size);
+          }
+        },
+        options);
+  }
+
+  void registerRawBatchHandler(const std::string &name, BatchServiceCallback callback,
+                               const BatchOptions &options = {});
+
+  /**
+   * @brief Register a handler that streams its response.
+   *
+   * Usage:
+   *   manager.registerStreamHandler<LogQuery, LogLine>("logs",
+   *       [](const LogQuery &query, StreamWriter<LogLine> &writer)
+   *       { for (auto &line : scan(query)) if (!writer.write(line)) return; });
+   */
+  template <typename RequestType, typename ResponseType>
+  void registerStreamHandler(
+      const std::string &name,
+      const std::function<void(const RequestType &, StreamWriter<ResponseType> &)>
+          &func)
+  {
+    registerRawStreamHandler(name,
+                             [func](const ByteView &payload, ServiceStreamWriter &raw)
+                             {
+                               RequestType req;
+                               decodeInPlace(payload, req);
+                               StreamWriter<ResponseType> writer(raw);
+                               func(req, writer);
+                             });
+  }
+
+  /**
+   * @brief Register a stream handler that works on encoded messages.
+   *
+   * The callback runs on a worker for the whole stream.
+   */
+  void registerRawStreamHandler(const std::string &name,
+                                StreamServiceCallback callback);
+
+  /**
+   * @brief Run a registered handler on the calling thread.
+   *
+   * Deferred handlers cannot be run this way and report SERVICE_FAIL.
+   */
   void handleRequest(const std::string &service_name, const ByteView &payload,
                      Response &response);
 
   void clearHandlers();
   void removeHandler(const std::string &name);
 
+  /**
+   * @brief Id of a service for compact request headers; 0 if it was never
+   * registered.
+   *
+   * Assigned when a service is first registered and kept for the lifetime of
+   * the ServiceManager, so a removed and registered again service keeps it.
+   */
+  uint32_t serviceId(const std::string &name);
+
+  /**
+   * @brief Run at most `max_concurrent` requests of a service at once.
+   *
+   * 0 removes the limit. The limit may be set before the handler exists.
+   * Same as AdmissionOptions::max_in_flight.
+   */
+  void setConcurrencyLimit(const std::string &name, size_t max_concurrent);
+
+  /**
+   * @brief Limit the requests of a service that wait or run at once.
+   *
+   * Replaces all limits of the service; default options remove them. May be
+   * set before the handler exists and applies to requests received after.
+   */
+  void setAdmission(const std::string &name, const AdmissionOptions &options);
+
+  // Admission counters of a registered service; all zero for other names
+  ServiceStatistics serviceStatistics(const std::string &name);
+
+  /**
+   * @brief Mark a service as idempotent, so that identical requests share
+   * one handler call and its response; std::nullopt unmarks it.
+   *
+   * Only for handlers whose response depends on nothing but the request,
+   * e.g. read-only lookups. Not for stream handlers. May be set before the
+   * handler exists.
+   */
+  void setIdempotent(
+      const std::string &name,
+      std::optional<ResponseCacheOptions> options = ResponseCacheOptions{});
+
+  /**
+   * @brief Deadline of the request being handled on the calling thread.
+   *
+   * Callers send how long they will wait for the reply; a long-running
+   * handler can check this to stop early. time_point::max() if the caller
+   * sent no deadline, the thread is not running a handler or it runs a batch.
+   */
+  static std::chrono::steady_clock::time_point requestDeadline();
+
+  // Requests skipped because their caller's deadline passed before they ran
+  uint64_t expiredRequests() const
+  {
+    return expired_.load(std::memory_order_relaxed);
+  }
+
+  // Requests received that wanted no reply
+  uint64_t oneWayRequests() const
+  {
+    return one_way_.load(std::memory_order_relaxed);
+  }
+
+  // Requests of idempotent services answered from the response cache
+  uint64_t cacheHits() const
+  {
+    return cache_hits_.load(std::memory_order_relaxed);
+  }
+
+  // Requests of idempotent services that waited for an identical one
+  uint64_t coalescedRequests() const
+  {
+    return coalesced_.load(std::memory_order_relaxed);
+  }
+
+  // Number of handler threads
+  size_t workerCount() const
+  {
+    return workers_->size();
+  }
+
   // Non-copyable, movable
   ServiceManager(const ServiceManager &) = delete;
   ServiceManager &operator=(const ServiceManager &) = delete;
@@ -87,14 +591,194 @@ public:
   ServiceManager &operator=(ServiceManager &&) = default;
 
 private:
-  // Poll once for incoming service requests
+  struct Handler
+  {
+    ServiceCallback callback;
+    DeferredServiceCallback deferred;
+    std::chrono::milliseconds timeout{0}; // deferred handlers only
+    StreamServiceCallback stream;
+    BatchServiceCallback batch;
+    BatchOptions batch_options;
+  };
+
+  // Admission counters of one registered service; updated by the polling
+  // thread and the workers
+  struct ServiceCounters
+  {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> shed{0};
+    std::atomic<int64_t> queued{0};
+    // Decremented with the reply, which may overtake the start of a
+    // deferred request, so it can briefly be negative
+    std::atomic<int64_t> in_flight{0};
+    LatencyHistogram queue_time;
+  };
+
+  // A received request together with the ROUTER envelope needed to answer it
+  struct Job
+  {
+    std::vector<zmq::message_t> route; // empty for one-way requests
+    std::string service_name;
+    zmq::message_t payload;
+    std::shared_ptr<const Handler> handler;          // null if unknown
+    std::shared_ptr<ServiceResponder::State> answer; // deferred handlers only
+    std::shared_ptr<ServiceStreamWriter::State> stream; // stream handlers only
+    std::chrono::milliseconds budget{0};
+    bool compact{false};
+
+    // When the caller stops waiting, from the budget in its request header
+    std::chrono::steady_clock::time_point deadline{
+        std::chrono::steady_clock::time_point::max()};
+
+    std::chrono::steady_clock::time_point received{std::chrono::steady_clock::now()};
+    std::chrono::milliseconds max_queue_time{0}; // from AdmissionOptions
+    std::shared_ptr<ServiceCounters> counters;   // null until admitted
+  };
+
+  using Deadline = std::pair<std::chrono::steady_clock::time_point,
+                             std::shared_ptr<ServiceResponder::State>>;
+
+  // Requests of a batch service waiting for the next batch
+  struct BatchQueue
+  {
+    std::vector<std::shared_ptr<Job>> pending;
+    std::chrono::steady_clock::time_point flush_at;
+    // Batches handed to workers; decremented by the worker when done
+    std::shared_ptr<std::atomic<size_t>> running{
+        std::make_shared<std::atomic<size_t>>(0)};
+  };
+
+  // Caller waiting for the response to an identical request
+  struct Follower
+  {
+    std::vector<zmq::message_t> route;
+    bool compact{false};
+  };
+
+  // Shared responses of one idempotent service, keyed by a hash of the
+  // request payload; only used by the polling thread
+  struct ResponseCache
+  {
+    struct Entry
+    {
+      std::string request; // tells hash collisions apart
+      std::string code;
+      zmq::message_t payload;
+      std::chrono::steady_clock::time_point expires;
+      std::list<uint64_t>::iterator order;
+    };
+    // A request being handled, with the callers waiting for it
+    struct Flight
+    {
+      std::string request; // moves into the entry once answered
+      std::vector<Follower> followers;
+    };
+    std::unordered_map<uint64_t, Entry> entries;
+    std::list<uint64_t> order; // oldest first, evicted first
+    size_t bytes{0};
+    std::unordered_map<uint64_t, Flight> in_flight;
+
+    void erase(std::unordered_map<uint64_t, Entry>::iterator entry);
+  };
+
+  // Concurrency state of one service; only used by the polling thread
+  struct Slot
+  {
+    size_t running{0};
+    std::deque<std::shared_ptr<Job>> waiting;
+    std::shared_ptr<ServiceCounters> counters; // null for unknown services
+  };
+
+  void addHandler(const std::string &name, ServiceCallback callback);
+  // Register under `name` and assign a service id if it has none
+  void installHandler(const std::string &name, std::shared_ptr<Handler> handler);
+  std::shared_ptr<const Handler> findHandler(const std::string &name);
+  // Name of a service id; empty if unknown
+  std::string serviceName(uint32_t id);
+
+  // Run a synchronous handler, mapping exceptions to status codes; the
+  // encoded response is left in `out`
+  void invoke(const Handler &handler, const std::string &service_name,
+              const ByteView &payload, Response &response, ByteBuffer &out);
+
+  // Wait for and handle incoming requests and finished replies
   void pollOnce();
 
+  // Read every queued request from the ROUTER socket
+  void receiveRequests();
+  // Answer `job` from the cache or attach it to an identical request;
+  // false if it has to run
+  bool coalesce(const std::shared_ptr<Job> &job);
+  // Count `job` as queued, or answer OVERLOADED if its service is full
+  bool admit(const std::shared_ptr<Job> &job);
+  // Answer a request that is not run; from the polling thread
+  void reject(const std::shared_ptr<Job> &job, std::string_view code);
+  // Shed requests held back by max_in_flight that waited too long; returns
+  // when the next one will be due
+  std::chrono::steady_clock::time_point
+  shedWaiting(std::chrono::steady_clock::time_point now);
+  // Account for a worker taking `job` up; returns the code to answer
+  // instead of running it, or an empty one
+  std::string_view startJob(Job &job, std::chrono::steady_clock::time_point now);
+  // Share the final reply of a request other callers wait for
+  void finishFlight(ServiceReply &reply);
+  void dispatch(std::shared_ptr<Job> job);
+  void runJob(const std::shared_ptr<Job> &job);
+  void runStream(const std::shared_ptr<Job> &job, ByteView payload);
+  void enqueueBatch(std::shared_ptr<Job> job);
+  void flushBatch(BatchQueue &queue);
+  // Flush the batches that are due; returns when the next one will be
+  std::chrono::steady_clock::time_point
+  flushBatches(std::chrono::steady_clock::time_point now);
+  void runBatch(std::vector<std::shared_ptr<Job>> jobs,
+                const std::shared_ptr<std::atomic<size_t>> &running);
+  // Run a batch handler, mapping exceptions to status codes
+  void invokeBatch(const Handler &handler, const std::string &service_name,
+                   const std::vector<ByteView> &payloads,
+                   std::vector<Response> &responses);
+  void grantCredit(std::vector<zmq::message_t> &route, const zmq::message_t &payload);
+  void sendReplies();
+  void sendReply(ServiceReply &reply);
+  // A compact request gets the status as one byte where it has a wire value
+  void sendResponse(std::vector<zmq::message_t> &route, const Response &response,
+                    bool compact, zmq::message_t body = {});
+  // Count a request of the service as answered; returns the next waiting
+  // request, which the caller dispatches
+  std::shared_ptr<Job> releaseSlot(const std::string &service_name);
+  void expireDeferred(std::chrono::steady_clock::time_point now);
+
 private:
-  std::unordered_map<std::string, std::function<Bytes(const ByteView &)>> handlers_;
+  std::mutex handlers_mutex_;
+  std::unordered_map<std::string, std::shared_ptr<const Handler>> handlers_;
+  std::unordered_map<std::string, AdmissionOptions> admission_;
+  std::unordered_map<std::string, std::shared_ptr<ServiceCounters>> counters_;
+  std::unordered_map<std::string, ResponseCacheOptions> idempotent_;
+  std::unordered_map<std::string, uint32_t> service_ids_;
+  std::unordered_map<uint32_t, std::string> service_names_;
 
   ZMQSocket *res_socket_;
-  static constexpr int SOCKET_TIMEOUT_MS = 100;
+
+  std::unique_ptr<ThreadPool> workers_;
+  std::unordered_map<std::string, Slot> slots_;
+  std::unordered_map<std::string, BatchQueue> batches_;
+  std::unordered_map<std::string, ResponseCache> caches_;
+  // Requests other callers may wait for, by envelope: service and payload hash
+  std::unordered_map<std::string, std::pair<std::string, uint64_t>> leaders_;
+  // Running streams by request envelope, for credit messages
+  std::unordered_map<std::string, std::shared_ptr<ServiceStreamWriter::State>>
+      streams_;
+
+  // Min-heap of deferred request deadlines; answered ones are skipped
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>
+      deadlines_;
+
+  // Its GuardCondition is also triggered when the poll loop should stop
+  std::shared_ptr<ServiceReplyQueue> replies_{std::make_shared<ServiceReplyQueue>()};
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> expired_{0};
+  std::atomic<uint64_t> cache_hits_{0};
+  std::atomic<uint64_t> coalesced_{0};
+  std::atomic<uint64_t> one_way_{0};
 
   std::unique_ptr<PeriodicTask> poll_task_;
 };
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "zerolancom/nodes/node_info_manager.hpp"
+#include "zerolancom/sockets/service_manager.hpp"
+#include "zerolancom/utils/guard_condition.hpp"
+#include "zerolancom/utils/logger.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief ServiceQueue lets an application thread serve a service itself.
+ *
+ * Incoming requests are queued instead of being handled on the service
+ * thread; the application picks them up with serveOne(), typically after a
+ * WaitSet reported the queue as ready.
+ *
+ * Usage:
+ *   ServiceQueue<AddRequest, int> queue("add");
+ *   waitSet.attach(queue);
+ *   while (waitSet.wait(100ms))
+ *     queue.serveOne([](const AddRequest &r) { return r.a + r.b; });
+ *
+ * Design notes:
+ * - This is a template class and MUST remain header-only.
+ * - Requests are registered as deferred: the worker that received one
+ *   returns at once, and serveOne() answers through a ServiceResponder.
+ * - Requests not served within `timeout` fail with SERVICE_TIMEOUT; a
+ *   later serveOne() skips them.
+ * - Destroying the queue removes the handler and the service advertisement
+ *   and fails pending requests with SERVICE_FAIL.
+ */
+template <typename RequestType, typename ResponseType> class ServiceQueue
+{
+public:
+  using Handler = std::function<ResponseType(const RequestType &)>;
+
+  explicit ServiceQueue(const std::string &service_name,
+                        std::chrono::milliseconds timeout = std::chrono::seconds(5))
+      : service_name_(service_name), state_(std::make_shared<State>())
+  {
+    std::shared_ptr<State> state = state_;
+    auto &serviceManager = ServiceManager::instance();
+    serviceManager.registerDeferredHandler(
+        service_name,
+        [state](const ByteView &payload, ServiceResponder responder)
+        {
+          RequestType req;
+          decode(payload, req);
+          state->enqueue(std::move(req), std::move(responder));
+        },
+        timeout);
+    NodeInfoManager::instance().registerLocalService(
+        service_name, serviceManager.service_port,
+        serviceManager.serviceId(service_name));
+
+    zlc::info("[ServiceQueue] Queued service '{}' registered", service_name);
+  }
+
+  ~ServiceQueue()
+  {
+    if (ServiceManager::isInitialized())
+    {
+      ServiceManager::instance().removeHandler(service_name_);
+    }
+    if (NodeInfoManager::isInitialized())
+    {
+      NodeInfoManager::instance().unregisterLocalService(service_name_);
+    }
+    state_->failAll();
+  }
+
+  // Non-copyable
+  ServiceQueue(const ServiceQueue &) = delete;
+  ServiceQueue &operator=(const ServiceQueue &) = delete;
+
+  /**
+   * @brief Handle the oldest queued request on the calling thread.
+   *
+   * Exceptions thrown by the handler are reported to the caller as
+   * SERVICE_FAIL.
+   *
+   * @return false if no request was pending.
+   */
+  bool serveOne(const Handler &handler)
+  {
+    std::unique_ptr<Pending> pending = state_->pop();
+    if (!pending)
+    {
+      return false;
+    }
+
+    try
+    {
+      ResponseType resp = handler(pending->request);
+      ByteBuffer out;
+      encode(resp, out);
+      pending->responder.reply(Bytes(out.data, out.data + out.size));
+    }
+    catch (const std::exception &e)
+    {
+      zlc::error("[ServiceQueue] Exception while serving '{}': {}", service_name_,
+                 e.what());
+      pending->responder.fail(ResponseStatus::SERVICE_FAIL);
+    }
+    return true;
+  }
+
+  // Number of requests waiting to be served
+  size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->prune();
+    return state_->queue.size();
+  }
+
+  /**
+   * @brief Condition triggered when a request is queued (used by WaitSet).
+   */
+  GuardCondition &readyCondition()
+  {
+    return state_->ready;
+  }
+
+  const std::string &name() const
+  {
+    return service_name_;
+  }
+
+private:
+  struct Pending
+  {
+    RequestType request;
+    ServiceResponder responder;
+  };
+
+  struct State
+  {
+    // Called on a service worker
+    void enqueue(RequestType req, ServiceResponder responder)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::make_unique<Pending>(
+            Pending{std::move(req), std::move(responder)}));
+      }
+      ready.trigger();
+    }
+
+    // Oldest request that has not timed out yet
+    std::unique_ptr<Pending> pop()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      prune();
+      if (queue.empty())
+      {
+        return nullptr;
+      }
+      std::unique_ptr<Pending> pending = std::move(queue.front());
+      queue.pop_front();
+      return pending;
+    }
+
+    // Drop requests that were answered by a timeout; requires mutex
+    void prune()
+    {
+      while (!queue.empty() && queue.front()->responder.done())
+      {
+        queue.pop_front();
+      }
+    }
+
+    void failAll()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto &pending : queue)
+      {
+        pending->responder.fail(ResponseStatus::SERVICE_FAIL);
+      }
+      queue.clear();
+    }
+
+    mutable std::mutex mutex;
+    std::deque<std::unique_ptr<Pending>> queue;
+    GuardCondition ready;
+  };
+
+  std::string service_name_;
+  std::shared_ptr<State> state_;
+};
+
+} // namespace zlc
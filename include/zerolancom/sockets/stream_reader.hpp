@@ -0,0 +1,305 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <zmq.hpp>
+
+#include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/client_manager.hpp"
+#include "zerolancom/sockets/load_balancer.hpp"
+#include "zerolancom/utils/logger.hpp"
+#include "zerolancom/utils/request_result.hpp"
+#include "zerolancom/utils/zmq_utils.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief StreamReader consumes the messages of a streamed service response.
+ *
+ * Usage:
+ *   auto lines = Client::requestStream<LogQuery, LogLine>("logs", query);
+ *   for (const LogLine &line : lines)
+ *     print(line);
+ *   if (lines.status() != ResponseStatus::SUCCESS) ...
+ *
+ * Design notes:
+ * - This is a template class and MUST remain header-only.
+ * - The request grants the server a window of messages. Half a window is
+ *   granted again each time that many messages were taken, so the server
+ *   never runs more than one window ahead of the application and memory
+ *   stays bounded however long the stream is.
+ * - `timeout` applies to each message, not to the whole stream. It is also
+ *   sent as the request budget, and the server stops streaming when it got
+ *   no credit for that long.
+ * - The connection is borrowed from the ClientManager pool and handed back
+ *   once the stream ended. A stream abandoned early is cancelled and its
+ *   connection closed, since messages may still be on their way.
+ * - Not thread-safe; movable but not copyable.
+ */
+template <typename ResponseType> class StreamReader
+{
+public:
+  static constexpr uint32_t DEFAULT_WINDOW = 16;
+
+  class iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ResponseType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ResponseType *;
+    using reference = const ResponseType &;
+
+    iterator() = default;
+
+    reference operator*() const
+    {
+      return message_;
+    }
+    pointer operator->() const
+    {
+      return &message_;
+    }
+    iterator &operator++()
+    {
+      if (!reader_->next(message_))
+      {
+        reader_ = nullptr;
+      }
+      return *this;
+    }
+    bool operator==(const iterator &other) const
+    {
+      return reader_ == other.reader_;
+    }
+    bool operator!=(const iterator &other) const
+    {
+      return reader_ != other.reader_;
+    }
+
+  private:
+    friend class StreamReader;
+
+    explicit iterator(StreamReader *reader) : reader_(reader)
+    {
+      ++*this;
+    }
+
+    StreamReader *reader_{nullptr};
+    ResponseType message_{};
+  };
+
+  /**
+   * @brief Send an encoded stream request to a provider of `service_name`.
+   */
+  StreamReader(std::string service_name, const ByteView &request,
+               uint32_t window = DEFAULT_WINDOW,
+               std::chrono::milliseconds timeout =
+                   ClientManager::DEFAULT_REQUEST_TIMEOUT)
+      : service_name_(std::move(service_name)), window_(std::max<uint32_t>(1, window)),
+        timeout_(timeout)
+  {
+    url_ = ClientManager::instance().selectProvider(service_name_);
+    if (url_.empty())
+    {
+      zlc::error("[StreamReader] Service '{}' is not available", service_name_);
+      status_ = ResponseStatus::NOSERVICE;
+      return;
+    }
+
+    socket_ = ClientManager::instance().acquireConnection(url_);
+    load_ = EndpointLoad::of(url_);
+    load_->start();
+
+    // Frames: [request id][empty delimiter][service header][window + payload]
+    Bytes header = ClientManager::instance().serviceHeader(
+        service_name_, url_, ClientManager::budgetMillis(timeout_));
+    Bytes payload = encodeStreamCredit(window_, request);
+    socket_->send(zmq::buffer(&id_, sizeof(id_)), zmq::send_flags::sndmore);
+    socket_->send(zmq::message_t(), zmq::send_flags::sndmore);
+    socket_->send(zmq::buffer(header), zmq::send_flags::sndmore);
+    socket_->send(zmq::buffer(payload), zmq::send_flags::none);
+  }
+
+  ~StreamReader()
+  {
+    cancel();
+  }
+
+  StreamReader(StreamReader &&other) noexcept
+      : service_name_(std::move(other.service_name_)), url_(std::move(other.url_)),
+        socket_(std::exchange(other.socket_, nullptr)), load_(std::move(other.load_)),
+        id_(other.id_), window_(other.window_), taken_(other.taken_),
+        timeout_(other.timeout_), status_(std::move(other.status_)),
+        frames_(std::move(other.frames_))
+  {
+  }
+
+  StreamReader(const StreamReader &) = delete;
+  StreamReader &operator=(const StreamReader &) = delete;
+  StreamReader &operator=(StreamReader &&) = delete;
+
+  /**
+   * @brief Wait for the next message of the stream.
+   *
+   * @return false at the end of the stream; status() tells whether it ended
+   * normally.
+   */
+  bool next(ResponseType &message)
+  {
+    while (socket_ != nullptr)
+    {
+      zmq::pollitem_t item{socket_->handle(), 0, ZMQ_POLLIN, 0};
+      if (zmq::poll(&item, 1, timeout_) == 0)
+      {
+        zlc::warn("[StreamReader] Stream of '{}' timed out", service_name_);
+        cancelWith(ResponseStatus::SERVICE_TIMEOUT);
+        return false;
+      }
+
+      // Replies to earlier calls on this connection are skipped
+      size_t count = receiveMultipart(*socket_, frames_);
+      if (count != frames_.size() || frames_[0].size() != sizeof(id_) ||
+          std::memcmp(frames_[0].data(), &id_, sizeof(id_)) != 0)
+      {
+        continue;
+      }
+
+      std::string code(decodeStatus(ByteView{
+          static_cast<const uint8_t *>(frames_[2].data()), frames_[2].size()}));
+      if (code != ResponseStatus::STREAM_ITEM)
+      {
+        // Final status; nothing more is in flight on this connection
+        finish(code);
+        ClientManager::instance().releaseConnection(url_, socket_);
+        socket_ = nullptr;
+        return false;
+      }
+
+      try
+      {
+        decode(ByteView{static_cast<const uint8_t *>(frames_[3].data()),
+                        frames_[3].size()},
+               message);
+      }
+      catch (const std::exception &e)
+      {
+        zlc::error("[StreamReader] Failed to decode message of '{}': {}",
+                   service_name_, e.what());
+        cancelWith(ResponseStatus::INVALID_RESPONSE);
+        return false;
+      }
+
+      if (++taken_ >= std::max<uint32_t>(1, window_ / 2))
+      {
+        sendCredit(taken_);
+        taken_ = 0;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Pass every remaining message to `callback`.
+   *
+   * @return the final status of the stream.
+   */
+  std::string forEach(const std::function<void(const ResponseType &)> &callback)
+  {
+    ResponseType message{};
+    while (next(message))
+    {
+      callback(message);
+    }
+    return status_;
+  }
+
+  /**
+   * @brief Stop the stream; the server stops at its next write.
+   */
+  void cancel()
+  {
+    cancelWith({});
+  }
+
+  // True once the stream ended, failed or was cancelled
+  bool done() const
+  {
+    return socket_ == nullptr;
+  }
+
+  // Empty while the stream is open or after cancel(); SUCCESS if it ended
+  // normally, an error from ResponseStatus otherwise
+  const std::string &status() const
+  {
+    return status_;
+  }
+
+  iterator begin()
+  {
+    return iterator(this);
+  }
+
+  iterator end()
+  {
+    return iterator();
+  }
+
+private:
+  void sendCredit(uint32_t credit)
+  {
+    Bytes payload = encodeStreamCredit(credit);
+    socket_->send(zmq::buffer(&id_, sizeof(id_)), zmq::send_flags::sndmore);
+    socket_->send(zmq::message_t(), zmq::send_flags::sndmore);
+    socket_->send(zmq::buffer(std::string(STREAM_CREDIT_SERVICE)),
+                  zmq::send_flags::sndmore);
+    socket_->send(zmq::buffer(payload), zmq::send_flags::none);
+  }
+
+  // Tell the server to stop and close the connection, which may still
+  // receive messages of this stream
+  void cancelWith(std::string_view code)
+  {
+    if (socket_ == nullptr)
+    {
+      return;
+    }
+    sendCredit(0);
+    finish(code);
+    ZMQContext::releaseSocket(socket_);
+    socket_ = nullptr;
+  }
+
+  void finish(std::string_view code)
+  {
+    status_ = code;
+    // Streams last arbitrarily long, so they take no part in latency estimates
+    load_->abandon();
+  }
+
+  std::string service_name_;
+  std::string url_;
+  ZMQSocket *socket_{nullptr};
+  std::shared_ptr<EndpointLoad> load_;
+  uint64_t id_{ClientManager::nextCallId()};
+  uint32_t window_;
+  uint32_t taken_{0}; // messages taken since credit was last granted
+  std::chrono::milliseconds timeout_;
+  std::string status_;
+
+  // Reply frames: [request id][empty delimiter][status code][payload]
+  std::array<zmq::message_t, 4> frames_;
+};
+
+} // namespace zlc
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/subscriber_manager.hpp"
+#include "zerolancom/utils/guard_condition.hpp"
+#include "zerolancom/utils/logger.hpp"
+#include "zerolancom/utils/spsc_queue.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief Subscriber is a pull-based counterpart of Publisher<T>.
+ *
+ * Messages are decoded on the SubscriberManager polling thread and handed over
+ * through a bounded lock-free SPSC queue, so the owning thread decides when to
+ * read them instead of receiving callbacks on a foreign thread.
+ *
+ * Design notes:
+ * - This is a template class and MUST remain header-only.
+ * - take()/takeLatest() never lock a mutex or allocate; they only move an
+ *   already decoded message into the caller's object.
+ * - Only one thread may read from a Subscriber at a time.
+ * - When the queue is full, newly received messages are dropped and counted.
+ * - Destroying the Subscriber unsubscribes and closes its socket.
+ */
+template <typename T> class Subscriber
+{
+public:
+  /**
+   * @brief Subscribe to a topic.
+   *
+   * @param topic_name Topic name (exactly as registered by the publisher)
+   * @param queue_size Maximum number of undelivered messages kept
+   * @param options Lifespan / deadline settings
+   */
+  explicit Subscriber(const std::string &topic_name, size_t queue_size = 16,
+                      const SubscribeOptions &options = {})
+      : topic_name_(topic_name), state_(std::make_shared<State>(queue_size))
+  {
+    // The callback shares ownership of the queue so that it stays valid for as
+    // long as the polling thread may deliver into it.
+    std::shared_ptr<State> state = state_;
+    SubscriptionId id = SubscriberManager::instance().registerRawTopicSubscriber(
+        topic_name, [state](const MessageHeader &, const ByteView &view)
+        { state->deliver(view); }, options);
+    subscription_ = Subscription(id);
+
+    zlc::info("[Subscriber] Pull subscriber for topic '{}' (queue size {})",
+              topic_name, queue_size);
+  }
+
+  ~Subscriber() = default;
+
+  // Non-copyable
+  Subscriber(const Subscriber &) = delete;
+  Subscriber &operator=(const Subscriber &) = delete;
+
+  /**
+   * @brief Move the oldest pending message into `out`.
+   * @return false if no message is pending.
+   */
+  bool take(T &out)
+  {
+    return state_->queue.tryPop(out);
+  }
+
+  /**
+   * @brief Move the newest pending message into `out`, discarding older ones.
+   * @return false if no message is pending.
+   */
+  bool takeLatest(T &out)
+  {
+    return state_->queue.tryPopLatest(out);
+  }
+
+  /**
+   * @brief Block until a message is pending or the timeout expires.
+   * @return true if a message can be taken.
+   */
+  template <typename Rep, typename Period>
+  bool waitFor(const std::chrono::duration<Rep, Period> &timeout)
+  {
+    return state_->waitFor(timeout);
+  }
+
+  /**
+   * @brief Number of messages waiting to be taken.
+   */
+  size_t pending() const
+  {
+    return state_->queue.size();
+  }
+
+  /**
+   * @brief Number of messages dropped because the queue was full.
+   */
+  uint64_t dropped() const
+  {
+    return state_->dropped.load(std::memory_order_relaxed);
+  }
+
+  const std::string &topic() const
+  {
+    return topic_name_;
+  }
+
+  /**
+   * @brief Condition triggered when a message is queued (used by WaitSet).
+   *
+   * Created on first use, so subscribers that are never waited on do not
+   * allocate a descriptor. Callers reset it before re-checking pending().
+   */
+  GuardCondition &readyCondition()
+  {
+    return state_->readyCondition();
+  }
+
+private:
+  struct State
+  {
+    explicit State(size_t queue_size) : queue(queue_size)
+    {
+    }
+
+    // Called on the polling thread (single producer)
+    void deliver(const ByteView &view)
+    {
+      decode(view, scratch);
+      if (!queue.tryPush(std::move(scratch)))
+      {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      if (GuardCondition *guard = ready_guard.load(std::memory_order_acquire))
+      {
+        guard->trigger();
+      }
+
+      // Pairs with the fence in waitFor(): either the waiter sees the new
+      // element or we see the waiter and wake it up.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters.load(std::memory_order_relaxed) > 0)
+      {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        cv.notify_all();
+      }
+    }
+
+    template <typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period> &timeout)
+    {
+      if (!queue.empty())
+      {
+        return true;
+      }
+
+      waiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      bool ready;
+      {
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        ready = cv.wait_for(lock, timeout, [this] { return !queue.empty(); });
+      }
+      waiters.fetch_sub(1, std::memory_order_relaxed);
+      return ready;
+    }
+
+    GuardCondition &readyCondition()
+    {
+      std::call_once(guard_once,
+                     [this]()
+                     {
+                       guard_owner = std::make_unique<GuardCondition>();
+                       ready_guard.store(guard_owner.get(), std::memory_order_release);
+                     });
+      return *guard_owner;
+    }
+
+    SPSCQueue<T> queue;
+    std::atomic<uint64_t> dropped{0};
+
+    // Only allocated once a WaitSet asks for it
+    std::unique_ptr<GuardCondition> guard_owner;
+    std::atomic<GuardCondition *> ready_guard{nullptr};
+    std::once_flag guard_once;
+
+    // Decode target reused by the polling thread
+    T scratch{};
+
+    // Only used by waitFor(); the fast path never touches them
+    std::atomic<int> waiters{0};
+    std::mutex wait_mutex;
+    std::condition_variable cv;
+  };
+
+  std::string topic_name_;
+  std::shared_ptr<State> state_;
+  Subscription subscription_;
+};
+
+} // namespace zlc
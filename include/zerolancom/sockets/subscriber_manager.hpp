@@ -1,6 +1,9 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -13,27 +16,95 @@
 
 #include "zerolancom/nodes/node_info.hpp"
 #include "zerolancom/nodes/node_info_manager.hpp"
+#include "zerolancom/nodes/node_options.hpp"
 #include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/flow_control.hpp"
+#include "zerolancom/sockets/message_header.hpp"
 #include "zerolancom/utils/logger.hpp"
 #include "zerolancom/utils/periodic_task.hpp"
 #include "zerolancom/utils/thread_pool.hpp"
+#include "zerolancom/utils/topic_trie.hpp"
 #include "zerolancom/utils/zmq_utils.hpp"
 
 namespace zlc
 {
 
+// Identifies one registration made through SubscriberManager (0 is invalid)
+using SubscriptionId = uint64_t;
+
+/**
+ * @brief Per-subscription quality-of-service settings.
+ *
+ * - lifespan: messages whose envelope stamp is older than this on arrival are
+ *   discarded before decode(). Stamps are wall-clock times of the sender, so
+ *   hosts should be clock-synchronized. Zero disables the check.
+ * - deadline: on_deadline_missed fires when no message arrived for this long,
+ *   and again after every further period of silence. Zero disables it.
+ * - flow_control_window: with publishers that enable flow control, at most
+ *   this many messages are in flight per publisher; credit is returned as
+ *   callbacks complete, so a slow callback slows the publisher down instead
+ *   of losing messages. Zero (best effort) uses plain PUB/SUB.
+ * - consumer_group: subscriptions sharing a group name split the topic's
+ *   messages between them, each message going to exactly one member. Only
+ *   publishers with flow control enabled serve groups. The window defaults to
+ *   DEFAULT_CONSUMER_GROUP_WINDOW.
+ * - keys: only receive messages whose publisher-assigned key (see
+ *   Publisher<T>::setKeyExtractor) is one of these. The filter is applied by
+ *   the publisher, so other messages are neither sent nor decoded. Messages
+ *   without a key never match. Empty receives every message.
+ *
+ * on_deadline_missed runs on the polling thread of the topic's shard, like
+ * the message callbacks, so it must not block.
+ */
+struct SubscribeOptions
+{
+  std::chrono::nanoseconds lifespan{0};
+  std::chrono::nanoseconds deadline{0};
+  std::function<void(const std::string &topicName)> on_deadline_missed;
+  uint32_t flow_control_window{0};
+  std::string consumer_group;
+  std::vector<std::string> keys;
+};
+
+/**
+ * @brief Message counters of all registrations of one topic.
+ */
+struct TopicStatistics
+{
+  uint64_t received{0};        // delivered to callbacks
+  uint64_t expired{0};         // discarded because of lifespan
+  uint64_t deadline_missed{0}; // deadline periods without a message
+};
+
 /**
  * @brief SubscriberManager manages topic subscriptions and message dispatch.
  *
  * Design notes:
  * - Automatically discovers publishers via NodeInfoManager callbacks.
- * - Uses one SUB socket per topic.
+ * - Uses one SUB socket per registration.
+ * - Registrations are spread over one or more shards. Each shard runs its own
+ *   poll loop on a dedicated pool thread, optionally pinned to a CPU. A topic
+ *   is placed by explicit affinity or, by default, by hashing its name, so all
+ *   registrations of a topic share one shard and keep their ordering.
+ * - Sockets are owned by their shard's thread. Unregistered subscriptions are
+ *   closed by that thread on its next cycle and released to ZMQContext.
+ * - Topic names may be patterns (see TopicTrie). A pattern registration owns
+ *   one ordinary registration per matching topic, created as publishers of
+ *   that topic are discovered and retired when its last publisher is gone.
+ * - Discovery events look up exact names in a hash index and patterns in a
+ *   TopicTrie, so they never scan all registrations.
  * - Template subscription API must remain header-only.
  */
 class SubscriberManager : public Singleton<SubscriberManager>
 {
 public:
-  explicit SubscriberManager();
+  using RawMessageCallback =
+      std::function<void(const MessageHeader &header, const ByteView &payload)>;
+  using TopicMessageCallback =
+      std::function<void(const std::string &topicName, const MessageHeader &header,
+                         const ByteView &payload)>;
+
+  explicit SubscriberManager(const NodeOptions &options = NodeOptions{});
   ~SubscriberManager();
 
   /**
@@ -44,36 +115,124 @@ public:
    * - Callback is executed in the polling thread.
    */
   template <typename MessageType>
-  void registerTopicSubscriber(const std::string &topicName,
-                               void (*callback)(const MessageType &))
-  {
-    _registerTopicSubscriber(topicName,
-                             [callback](const ByteView &view)
-                             {
-                               MessageType msg;
-                               decode(view, msg);
-                               callback(msg);
-                             });
+  SubscriptionId registerTopicSubscriber(const std::string &topicName,
+                                         void (*callback)(const MessageType &),
+                                         const SubscribeOptions &options = {})
+  {
+    return registerRawTopicSubscriber(
+        topicName,
+        [callback](const MessageHeader &, const ByteView &view)
+        {
+          MessageType msg;
+          decode(view, msg);
+          callback(msg);
+        },
+        options);
   }
 
   template <typename MessageType, typename ClassT>
-  void registerTopicSubscriber(const std::string &topicName,
-                               void (ClassT::*callback)(const MessageType &),
-                               ClassT *instance)
-  {
-    _registerTopicSubscriber(topicName,
-                             [instance, callback](const ByteView &view)
-                             {
-                               MessageType msg;
-                               decode(view, msg);
-                               (instance->*callback)(msg);
-                             });
+  SubscriptionId registerTopicSubscriber(const std::string &topicName,
+                                         void (ClassT::*callback)(const MessageType &),
+                                         ClassT *instance,
+                                         const SubscribeOptions &options = {})
+  {
+    return registerRawTopicSubscriber(
+        topicName,
+        [instance, callback](const MessageHeader &, const ByteView &view)
+        {
+          MessageType msg;
+          decode(view, msg);
+          (instance->*callback)(msg);
+        },
+        options);
   }
 
-  // Start polling thread
+  /**
+   * @brief Register a subscriber callback for every topic matching a pattern.
+   *
+   * The callback receives the name of the topic the message was published on.
+   */
+  template <typename MessageType>
+  SubscriptionId registerPatternSubscriber(
+      const std::string &pattern,
+      void (*callback)(const std::string &topicName, const MessageType &),
+      const SubscribeOptions &options = {})
+  {
+    return registerRawPatternSubscriber(
+        pattern,
+        [callback](const std::string &topicName, const MessageHeader &,
+                   const ByteView &view)
+        {
+          MessageType msg;
+          decode(view, msg);
+          callback(topicName, msg);
+        },
+        options);
+  }
+
+  /**
+   * @brief Register a callback receiving the envelope and undecoded payload.
+   *
+   * The view is only valid for the duration of the callback. This is the
+   * building block used by the typed overloads, Subscriber<T> and
+   * Synchronizer. A topic pattern is forwarded to registerRawPatternSubscriber.
+   */
+  SubscriptionId registerRawTopicSubscriber(const std::string &topicName,
+                                            const RawMessageCallback &callback,
+                                            const SubscribeOptions &options = {});
+
+  /**
+   * @brief Subscribe to every topic matching a pattern (syntax: see TopicTrie).
+   *
+   * The callback also receives the name of the topic each message came from.
+   * Matching publishers that appear later are connected as they are
+   * discovered.
+   *
+   * @throws std::invalid_argument if the pattern is malformed
+   */
+  SubscriptionId registerRawPatternSubscriber(const std::string &pattern,
+                                              const TopicMessageCallback &callback,
+                                              const SubscribeOptions &options = {});
+
+  /**
+   * @brief Remove a registration and close its socket.
+   *
+   * Once this returns, the callback is no longer invoked, unless it is called
+   * from inside a subscriber callback, in which case the current dispatch
+   * finishes normally.
+   *
+   * @return false if the id is unknown (e.g. already unregistered).
+   */
+  bool unregisterTopicSubscriber(SubscriptionId id);
+
+  // Number of active registrations, each pattern counting once
+  size_t subscriptionCount();
+
+  /**
+   * @brief Counters summed over the active registrations of a topic.
+   */
+  TopicStatistics topicStatistics(const std::string &topicName);
+
+  // Number of subscriber I/O shards
+  size_t shardCount() const
+  {
+    return shards_.size();
+  }
+
+  // Shard that registrations for this topic are placed on
+  size_t shardForTopic(const std::string &topicName);
+
+  /**
+   * @brief Place future registrations of a topic on a given shard.
+   *
+   * Existing registrations stay where they are.
+   */
+  void setTopicAffinity(const std::string &topicName, size_t shard);
+
+  // Start polling threads
   void start();
 
-  // Stop polling thread
+  // Stop polling threads
   void stop();
 
   // Called by NodeInfoManager when a node announces new topics
@@ -83,29 +242,213 @@ public:
   void removeTopicSubscriber(const NodeInfo &nodeInfo);
 
 private:
-  // Find all publisher endpoints for a topic
-  std::vector<std::string> findTopicURLs(const std::string &topicName);
-
-  // Poll once for incoming messages
-  void pollOnce();
+  // DEALER connected to the credit channel of one flow-controlled publisher
+  struct CreditLink
+  {
+    std::string url; // data endpoint, used as key like publisherURLs
+    ZMQSocket *socket{nullptr};
+    uint32_t consumed{0}; // messages handled since the last grant
+    std::chrono::steady_clock::time_point last_sent;
+    std::chrono::steady_clock::time_point last_hello;
+  };
 
-private:
-  struct Subscriber
+  struct TopicEntry
   {
+    SubscriptionId id{0};
+    SubscriptionId pattern{0}; // owning pattern registration, if any
+    std::atomic<bool> active{true};
     std::string topicName;
     std::vector<std::string> publisherURLs;
-    std::function<void(const ByteView &)> callback;
+    RawMessageCallback callback;
     ZMQSocket *socket;
+
+    SubscribeOptions options;
+    std::chrono::steady_clock::time_point last_message;
+
+    // Flow-controlled publishers are reached through these instead of `socket`
+    std::vector<std::unique_ptr<CreditLink>> credit_links;
+
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> expired{0};
+    std::atomic<uint64_t> deadline_missed{0};
+  };
+
+  // One poll loop and the sockets it owns
+  struct Shard
+  {
+    size_t index{0};
+    int cpu{-1};
+
+    // Entries are heap-allocated so pointers handed to the polling thread
+    // stay valid when new subscriptions are registered concurrently.
+    std::vector<std::unique_ptr<TopicEntry>> subscribers;
+    std::mutex mutex;
+
+    // Unregistered entries waiting for the polling thread to close their socket
+    std::vector<std::unique_ptr<TopicEntry>> retired;
+    std::vector<std::unique_ptr<CreditLink>> retired_links;
+
+    // Held while callbacks run, so unregistering can wait for in-flight dispatch
+    std::mutex dispatch_mutex;
+
+    std::unique_ptr<PeriodicTask> poll_task;
+    bool pinned{false};
+  };
+
+  // Registration of a topic pattern
+  struct PatternEntry
+  {
+    std::string pattern;
+    TopicMessageCallback callback;
+    SubscribeOptions options;
+
+    // Registration created for each matching topic
+    std::unordered_map<std::string, SubscriptionId> topics;
+  };
+
+  // Entry location kept in the discovery index
+  struct IndexedEntry
+  {
+    Shard *shard;
+    TopicEntry *entry;
   };
 
+  // Create an entry and connect it to the given publishers (index mutex held).
+  // Publishers are looked up by the caller beforehand: NodeInfoManager may
+  // call back into this class while holding its own lock.
+  SubscriptionId addEntry(const std::string &topicName,
+                          const RawMessageCallback &callback,
+                          const SubscribeOptions &options, SubscriptionId pattern,
+                          const std::vector<SocketInfo> &publishers);
+
+  // Create the entry of a pattern for one matching topic (index mutex held)
+  void addPatternTopic(SubscriptionId id, PatternEntry &pattern,
+                       const std::string &topicName,
+                       const std::vector<SocketInfo> &publishers);
+
+  // Unindex an entry and hand it to its shard thread for closing
+  bool retireEntry(SubscriptionId id);
+
+  // Connect an entry to one publisher (shard mutex held)
+  void connectPublisher(TopicEntry &entry, const SocketInfo &info);
+
+  // Disconnect an entry from one publisher (shard mutex held)
+  void disconnectPublisher(Shard &shard, TopicEntry &entry, const SocketInfo &info);
+
+  // Send a control message on a credit link
+  void sendCredit(CreditLink &link, uint8_t type, uint32_t credits);
+  void sendControl(CreditLink &link, const CreditMessage &msg);
+
+  // Announce the entry's full window, group and keys on a credit link
+  void sendHello(const TopicEntry &entry, CreditLink &link);
+
+  // Poll one shard once for incoming messages
+  void pollOnce(Shard &shard);
+
+  // Receive and dispatch every queued message of one socket of an entry
+  void drain(TopicEntry &entry, ZMQSocket &socket, CreditLink *link);
+
+  // Handle a control message a publisher sent on a credit link
+  void handleControl(TopicEntry &entry, CreditLink &link, const zmq::message_t &frame);
+
+  // Report the entry's deadline as missed if it has been silent too long
+  void checkDeadline(TopicEntry &entry, std::chrono::steady_clock::time_point now);
+
+  // Tell flow-controlled publishers that the entry is still alive (shard
+  // mutex held)
+  void sendKeepalives(TopicEntry &entry, std::chrono::steady_clock::time_point now);
+
+  // Close sockets of unregistered entries (shard thread only)
+  void releaseRetired(Shard &shard);
+
 private:
-  std::vector<Subscriber> subscribers_;
-  std::mutex mutex_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  std::mutex affinity_mutex_;
+  std::unordered_map<std::string, size_t> topic_affinity_;
+
+  std::atomic<SubscriptionId> next_id_{1};
 
-  std::unique_ptr<PeriodicTask> poll_task_;
+  // Discovery index; locked before any shard mutex
+  std::mutex index_mutex_;
+  std::unordered_map<std::string, std::vector<IndexedEntry>> topic_index_;
+  std::unordered_map<SubscriptionId, PatternEntry> patterns_;
+  TopicTrie pattern_index_;
+};
+
+/**
+ * @brief RAII handle that unregisters a subscription when destroyed.
+ *
+ * Usage:
+ *   Subscription sub(zlc::registerSubscriberHandler("camera", &onImage));
+ *   ...
+ *   sub.reset(); // or let it go out of scope
+ */
+class Subscription
+{
+public:
+  Subscription() = default;
 
-  void _registerTopicSubscriber(const std::string &topicName,
-                                const std::function<void(const ByteView &)> &callback);
+  explicit Subscription(SubscriptionId id) : id_(id)
+  {
+  }
+
+  ~Subscription()
+  {
+    reset();
+  }
+
+  Subscription(const Subscription &) = delete;
+  Subscription &operator=(const Subscription &) = delete;
+
+  Subscription(Subscription &&other) noexcept : id_(other.release())
+  {
+  }
+
+  Subscription &operator=(Subscription &&other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      id_ = other.release();
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Unregister now. Safe to call repeatedly and after shutdown.
+   */
+  void reset()
+  {
+    if (id_ != 0 && SubscriberManager::isInitialized())
+    {
+      SubscriberManager::instance().unregisterTopicSubscriber(id_);
+    }
+    id_ = 0;
+  }
+
+  /**
+   * @brief Give up ownership without unregistering.
+   */
+  SubscriptionId release()
+  {
+    SubscriptionId id = id_;
+    id_ = 0;
+    return id;
+  }
+
+  SubscriptionId id() const
+  {
+    return id_;
+  }
+
+  bool valid() const
+  {
+    return id_ != 0;
+  }
+
+private:
+  SubscriptionId id_{0};
 };
 
 } // namespace zlc
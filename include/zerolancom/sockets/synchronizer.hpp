@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "zerolancom/serialization/serializer.hpp"
+#include "zerolancom/sockets/message_header.hpp"
+#include "zerolancom/sockets/subscriber_manager.hpp"
+#include "zerolancom/utils/logger.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief Matching policy used by Synchronizer.
+ *
+ * - ExactTime: emit only when every topic has a message with the same stamp.
+ * - ApproximateTime: emit when the oldest pending message of every topic lies
+ *   within `max_interval` of each other.
+ */
+enum class SyncPolicy
+{
+  ExactTime,
+  ApproximateTime
+};
+
+/**
+ * @brief Synchronizer aligns messages from several topics by timestamp.
+ *
+ * Usage:
+ *   Synchronizer<Image, Scan> sync({"camera", "lidar"},
+ *       [](const Image &img, const Scan &scan) { ... },
+ *       SyncPolicy::ApproximateTime, 10, std::chrono::milliseconds(5));
+ *
+ * Design notes:
+ * - This is a template class and MUST remain header-only.
+ * - Each topic is registered through SubscriberManager and keeps a bounded
+ *   ring of `queue_size` pre-allocated slots; messages are decoded in place,
+ *   so matching itself never allocates.
+ * - Stamps are taken from the message envelope unless key extractors are given.
+ * - Messages on each topic are expected to arrive in stamp order.
+ * - Destroying the Synchronizer unsubscribes from every topic.
+ * - The callback runs on the polling thread while the synchronizer lock is
+ *   held; the references passed to it are only valid during the call.
+ */
+template <typename... Ts> class Synchronizer
+{
+  static_assert(sizeof...(Ts) >= 2, "Synchronizer needs at least two topics");
+
+public:
+  static constexpr size_t TOPIC_COUNT = sizeof...(Ts);
+
+  using Callback = std::function<void(const Ts &...)>;
+  using Topics = std::array<std::string, TOPIC_COUNT>;
+  using KeyExtractors = std::tuple<std::function<int64_t(const Ts &)>...>;
+
+  /**
+   * @brief Synchronize on envelope stamps (nanoseconds since the Unix epoch).
+   */
+  Synchronizer(const Topics &topics, Callback callback,
+               SyncPolicy policy = SyncPolicy::ApproximateTime, size_t queue_size = 10,
+               std::chrono::nanoseconds max_interval = std::chrono::milliseconds(10))
+      : Synchronizer(topics, KeyExtractors{}, std::move(callback), policy, queue_size,
+                     max_interval)
+  {
+  }
+
+  /**
+   * @brief Synchronize on user-defined keys extracted from each message.
+   *
+   * With ApproximateTime, `max_interval.count()` is compared against key
+   * differences directly, so it should use the same unit as the keys.
+   */
+  Synchronizer(const Topics &topics, KeyExtractors keys, Callback callback,
+               SyncPolicy policy = SyncPolicy::ApproximateTime, size_t queue_size = 10,
+               std::chrono::nanoseconds max_interval = std::chrono::milliseconds(10))
+      : state_(std::make_shared<State>(std::move(keys), std::move(callback), policy,
+                                       queue_size, max_interval))
+  {
+    registerTopics(topics, std::index_sequence_for<Ts...>{});
+  }
+
+  // Non-copyable
+  Synchronizer(const Synchronizer &) = delete;
+  Synchronizer &operator=(const Synchronizer &) = delete;
+
+  /**
+   * @brief Number of matched tuples delivered to the callback.
+   */
+  uint64_t matched() const
+  {
+    return state_->matched.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Number of messages discarded without being part of a match.
+   */
+  uint64_t dropped() const
+  {
+    return state_->dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Fixed-capacity FIFO of decoded messages
+  template <typename T> struct Ring
+  {
+    struct Slot
+    {
+      int64_t stamp{0};
+      T msg{};
+    };
+
+    explicit Ring(size_t capacity) : slots(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    bool empty() const
+    {
+      return count == 0;
+    }
+    bool full() const
+    {
+      return count == slots.size();
+    }
+    Slot &front()
+    {
+      return slots[head];
+    }
+    // Slot that the next push will fill
+    Slot &back()
+    {
+      return slots[(head + count) % slots.size()];
+    }
+    void commit()
+    {
+      ++count;
+    }
+    void pop()
+    {
+      head = (head + 1) % slots.size();
+      --count;
+    }
+
+    std::vector<Slot> slots;
+    size_t head{0};
+    size_t count{0};
+  };
+
+  struct State
+  {
+    State(KeyExtractors keys_, Callback callback_, SyncPolicy policy_,
+          size_t queue_size, std::chrono::nanoseconds max_interval)
+        : keys(std::move(keys_)), callback(std::move(callback_)), policy(policy_),
+          slop(policy_ == SyncPolicy::ExactTime ? 0 : max_interval.count()),
+          rings(Ring<Ts>(queue_size)...)
+    {
+    }
+
+    template <size_t I>
+    void deliver(const MessageHeader &header, const ByteView &view)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      auto &ring = std::get<I>(rings);
+      if (ring.full())
+      {
+        ring.pop();
+        dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      auto &slot = ring.back();
+      decode(view, slot.msg);
+      const auto &key = std::get<I>(keys);
+      slot.stamp = key ? key(slot.msg) : header.stamp_ns;
+      ring.commit();
+
+      match(std::index_sequence_for<Ts...>{});
+    }
+
+    template <size_t... Is> void match(std::index_sequence<Is...>)
+    {
+      while ((!std::get<Is>(rings).empty() && ...))
+      {
+        const int64_t newest = std::max({std::get<Is>(rings).front().stamp...});
+        const int64_t threshold = newest - slop;
+
+        // A head older than `newest - slop` can never be matched: every other
+        // queue only holds messages at least as new as its own head.
+        size_t discarded = 0;
+        (
+            [&]
+            {
+              auto &ring = std::get<Is>(rings);
+              if (ring.front().stamp < threshold)
+              {
+                ring.pop();
+                ++discarded;
+              }
+            }(),
+            ...);
+
+        if (discarded > 0)
+        {
+          dropped.fetch_add(discarded, std::memory_order_relaxed);
+          continue;
+        }
+
+        // Counted first so that the callback already observes its own match
+        matched.fetch_add(1, std::memory_order_relaxed);
+        callback(std::get<Is>(rings).front().msg...);
+        (std::get<Is>(rings).pop(), ...);
+      }
+    }
+
+    KeyExtractors keys;
+    Callback callback;
+    SyncPolicy policy;
+    int64_t slop;
+
+    std::mutex mutex;
+    std::tuple<Ring<Ts>...> rings;
+
+    std::atomic<uint64_t> matched{0};
+    std::atomic<uint64_t> dropped{0};
+  };
+
+  template <size_t... Is>
+  void registerTopics(const Topics &topics, std::index_sequence<Is...>)
+  {
+    auto &manager = SubscriberManager::instance();
+    std::shared_ptr<State> state = state_;
+    ((subscriptions_[Is] = Subscription(manager.registerRawTopicSubscriber(
+          topics[Is], [state](const MessageHeader &header, const ByteView &view)
+          { state->template deliver<Is>(header, view); }))),
+     ...);
+  }
+
+  std::shared_ptr<State> state_;
+  std::array<Subscription, TOPIC_COUNT> subscriptions_;
+};
+
+} // namespace zlc
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "zerolancom/sockets/service_queue.hpp"
+#include "zerolancom/sockets/subscriber.hpp"
+#include "zerolancom/utils/guard_condition.hpp"
+
+namespace zlc
+{
+
+/**
+ * @brief WaitSet blocks one application thread on many event sources.
+ *
+ * Usage:
+ *   WaitSet ws;
+ *   auto cam = ws.attach(camera_sub);       // Subscriber<T>
+ *   auto srv = ws.attach(service_queue);    // ServiceQueue<Req, Res>
+ *   auto tick = ws.addTimer(std::chrono::milliseconds(100));
+ *   auto quit = ws.attach(stop_guard);      // GuardCondition
+ *
+ *   while (ws.wait(std::chrono::seconds(1)))
+ *   {
+ *     if (ws.isReady(cam)) { ... camera_sub.take(img); }
+ *     if (ws.isReady(quit)) break;
+ *   }
+ *
+ * Design notes:
+ * - Every source is represented by a GuardCondition descriptor and all of
+ *   them are waited on with a single zmq::poll, the same primitive used by
+ *   SubscriberManager, so the thread sleeps until something is ready.
+ * - Subscriber and ServiceQueue readiness is re-evaluated on every wait
+ *   (pending() > 0); their conditions are reset by the WaitSet.
+ * - User GuardConditions stay ready until the user calls reset().
+ * - Attached objects must outlive the WaitSet. An object should be attached
+ *   to at most one WaitSet.
+ * - A WaitSet is used from one thread only.
+ */
+class WaitSet
+{
+public:
+  using Handle = size_t;
+
+  WaitSet() = default;
+
+  // Non-copyable
+  WaitSet(const WaitSet &) = delete;
+  WaitSet &operator=(const WaitSet &) = delete;
+
+  /**
+   * @brief Ready while the subscriber has pending messages.
+   */
+  template <typename T> Handle attach(Subscriber<T> &subscriber)
+  {
+    return addSource(&subscriber.readyCondition(),
+                     [&subscriber]() { return subscriber.pending() > 0; });
+  }
+
+  /**
+   * @brief Ready while the service queue has unserved requests.
+   */
+  template <typename RequestType, typename ResponseType>
+  Handle attach(ServiceQueue<RequestType, ResponseType> &queue)
+  {
+    return addSource(&queue.readyCondition(),
+                     [&queue]() { return queue.pending() > 0; });
+  }
+
+  /**
+   * @brief Ready while the guard condition is triggered.
+   */
+  Handle attach(GuardCondition &guard);
+
+  /**
+   * @brief Ready once every `period`, starting one period from now.
+   *
+   * Missed periods are coalesced into a single ready report.
+   */
+  Handle addTimer(std::chrono::nanoseconds period);
+
+  /**
+   * @brief Block until at least one source is ready or the timeout expires.
+   *
+   * A negative timeout waits indefinitely.
+   *
+   * @return false on timeout.
+   */
+  template <typename Rep, typename Period>
+  bool wait(const std::chrono::duration<Rep, Period> &timeout)
+  {
+    return waitFor(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout));
+  }
+
+  /**
+   * @brief Whether a source was ready at the end of the last wait().
+   */
+  bool isReady(Handle handle) const;
+
+  // Number of attached sources and timers
+  size_t size() const
+  {
+    return entries_.size();
+  }
+
+private:
+  struct Entry
+  {
+    GuardCondition *guard{nullptr};
+
+    // Readiness of queue-backed sources; empty for user guard conditions
+    std::function<bool()> has_data;
+
+    // Timer state (period > 0 marks a timer)
+    std::chrono::nanoseconds period{0};
+    std::chrono::steady_clock::time_point next_fire;
+
+    bool ready{false};
+  };
+
+  Handle addSource(GuardCondition *guard, std::function<bool()> has_data);
+
+  // Evaluate all entries; returns true if any is ready
+  bool collectReady(std::chrono::steady_clock::time_point now);
+
+  bool waitFor(std::chrono::nanoseconds timeout);
+
+  std::vector<Entry> entries_;
+};
+
+} // namespace zlc
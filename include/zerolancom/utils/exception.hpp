@@ -1,5 +1,6 @@
 #pragma once
 #include <stdexcept>
+#include <string>
 
 namespace zlc
 {
@@ -29,4 +30,22 @@ public:
   }
 };
 
-} // namespace zlc
\ No newline at end of file
+// A service call that completed with a ResponseStatus other than SUCCESS
+class ServiceException : public std::runtime_error
+{
+public:
+  ServiceException(const std::string &service, const std::string &code)
+      : std::runtime_error("Service '" + service + "' failed: " + code), code_(code)
+  {
+  }
+
+  const std::string &code() const
+  {
+    return code_;
+  }
+
+private:
+  std::string code_;
+};
+
+} // namespace zlc
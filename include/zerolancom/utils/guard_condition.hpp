@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+
+namespace zlc
+{
+
+/**
+ * @brief GuardCondition is a pollable, user-triggered flag.
+ *
+ * Usage:
+ *   GuardCondition stop;
+ *   waitSet.attach(stop);
+ *   ...
+ *   stop.trigger(); // from any thread, wakes the waiting thread
+ *
+ * Design notes:
+ * - Backed by an eventfd (Linux) or a pipe, so it can be waited on together
+ *   with ZMQ sockets in zmq::poll.
+ * - trigger() only writes to the descriptor when the flag flips from false to
+ *   true, so repeated triggers cost a single atomic exchange.
+ * - The condition stays triggered until reset() is called.
+ */
+class GuardCondition
+{
+public:
+  GuardCondition();
+  ~GuardCondition();
+
+  // Non-copyable
+  GuardCondition(const GuardCondition &) = delete;
+  GuardCondition &operator=(const GuardCondition &) = delete;
+
+  /**
+   * @brief Set the flag and wake up any poll on fd(). Thread-safe.
+   */
+  void trigger();
+
+  /**
+   * @brief Clear the flag and drain the descriptor.
+   */
+  void reset();
+
+  bool isTriggered() const
+  {
+    return triggered_.load(std::memory_order_acquire);
+  }
+
+  // Descriptor that becomes readable while the condition is triggered
+  int fd() const
+  {
+    return read_fd_;
+  }
+
+private:
+  std::atomic<bool> triggered_{false};
+  int read_fd_{-1};
+  int write_fd_{-1};
+};
+
+} // namespace zlc
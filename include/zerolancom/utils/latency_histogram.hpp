@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace zlc
+{
+
+/**
+ * @brief LatencyHistogram counts durations for percentile estimates.
+ *
+ * Usage:
+ *   LatencyHistogram waits;
+ *   waits.record(std::chrono::steady_clock::now() - queued_at);
+ *   auto p99 = waits.percentile(0.99);
+ *
+ * Design notes:
+ * - Buckets are spaced logarithmically, four per power of two of
+ *   microseconds, so a percentile is within 25% of the true value for any
+ *   duration up to days, with a fixed 160 counters.
+ * - record() is one relaxed atomic increment and may be called from any
+ *   thread. Readers scan all buckets and may miss samples that are being
+ *   recorded at the same time.
+ * - Counts accumulate for the lifetime of the histogram.
+ */
+class LatencyHistogram
+{
+public:
+  static constexpr size_t BUCKETS = 160;
+
+  void record(std::chrono::nanoseconds duration);
+
+  // Samples recorded so far
+  uint64_t count() const;
+
+  /**
+   * @brief Duration that `fraction` (0 to 1) of the samples did not exceed.
+   *
+   * Reports the upper bound of the bucket holding that sample; zero without
+   * samples.
+   */
+  std::chrono::microseconds percentile(double fraction) const;
+
+private:
+  static size_t bucketOf(uint64_t micros);
+  static uint64_t upperBound(size_t bucket);
+
+  std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+};
+
+} // namespace zlc
@@ -46,11 +46,12 @@ public:
    */
   void start()
   {
-    if (is_running_)
+    if (started_)
     {
       return;
     }
 
+    started_ = true;
     is_running_ = true;
 
     // Use thread pool to enqueue the loop
@@ -67,11 +68,12 @@ public:
    */
   void stop()
   {
-    if (!is_running_)
+    if (!started_)
     {
       return;
     }
 
+    started_ = false;
     is_running_ = false;
 
     // Wait for the task to actually finish (with timeout of 5 seconds)
@@ -93,6 +95,17 @@ public:
     stop();
   }
 
+  /**
+   * @brief Let the loop exit after the current iteration without waiting.
+   *
+   * Unlike stop(), this may be called from the callback itself, e.g. when the
+   * resources it polls are gone. stop() still waits for the loop to finish.
+   */
+  void cancel()
+  {
+    is_running_ = false;
+  }
+
   bool is_running() const
   {
     return is_running_;
@@ -128,6 +141,7 @@ private:
   int interval_ms_;
   ThreadPool *pool_;
   std::atomic<bool> is_running_;
+  bool started_{false}; // start() was called and stop() has not waited yet
 
   // Use std::promise/future for clean one-time synchronization
   std::promise<void> promise_done_;
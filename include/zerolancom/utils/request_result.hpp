@@ -17,6 +17,10 @@ constexpr std::string_view SERVICE_FAIL = "SERVICE_FAIL"sv;
 constexpr std::string_view SERVICE_TIMEOUT = "SERVICE_TIMEOUT"sv;
 constexpr std::string_view INVALID_REQUEST = "INVALID_REQUEST"sv;
 constexpr std::string_view UNKNOWN_ERROR = "UNKNOWN_ERROR"sv;
+// One message of a streamed response; more follow until a final status
+constexpr std::string_view STREAM_ITEM = "STREAM_ITEM"sv;
+// Not run because the service is overloaded; safe to retry elsewhere
+constexpr std::string_view OVERLOADED = "OVERLOADED"sv;
 
 // Helper to validate incoming status strings
 inline bool is_error(std::string_view status)
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace zlc
+{
+
+/**
+ * @brief Bounded lock-free single-producer / single-consumer queue.
+ *
+ * Usage:
+ *   SPSCQueue<Msg> queue(64);
+ *   queue.tryPush(std::move(msg));   // producer thread only
+ *   Msg out;
+ *   queue.tryPop(out);               // consumer thread only
+ *
+ * Design notes:
+ * - All slots are allocated once in the constructor; push/pop never allocate.
+ * - Elements are moved in and out of pre-constructed slots, so T must be
+ *   default-constructible and move-assignable.
+ * - Exactly one thread may push and exactly one thread may pop at a time.
+ */
+template <typename T> class SPSCQueue
+{
+public:
+  /**
+   * @brief Create a queue holding up to `capacity` elements.
+   *
+   * @param capacity Maximum number of queued elements (at least 1)
+   */
+  explicit SPSCQueue(size_t capacity)
+      : capacity_(capacity > 0 ? capacity : 1), slots_(capacity_ + 1)
+  {
+  }
+
+  // Non-copyable, non-movable (atomics are shared between two threads)
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  /**
+   * @brief Push an element (producer side).
+   * @return false if the queue is full; `value` is left untouched.
+   */
+  bool tryPush(T &&value)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = increment(tail);
+    if (next == head_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Pop the oldest element into `out` (consumer side).
+   * @return false if the queue is empty.
+   */
+  bool tryPop(T &out)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    out = std::move(slots_[head]);
+    head_.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Discard all but the newest element and pop it into `out`.
+   * @return false if the queue is empty.
+   */
+  bool tryPopLatest(T &out)
+  {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail)
+    {
+      return false;
+    }
+    const size_t last = tail == 0 ? slots_.size() - 1 : tail - 1;
+    out = std::move(slots_[last]);
+    head_.store(tail, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const
+  {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Approximate number of queued elements.
+   */
+  size_t size() const
+  {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return tail >= head ? tail - head : slots_.size() - head + tail;
+  }
+
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+private:
+  size_t increment(size_t index) const
+  {
+    return index + 1 == slots_.size() ? 0 : index + 1;
+  }
+
+private:
+  size_t capacity_;
+  // One spare slot distinguishes "full" from "empty"
+  std::vector<T> slots_;
+
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+} // namespace zlc
@@ -8,6 +8,11 @@
 #include <thread>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include "zerolancom/utils/logger.hpp"
 #include "zerolancom/utils/singleton.hpp"
 namespace zlc
@@ -250,4 +255,32 @@ private:
   std::condition_variable cv_done_; // Notify wait() of completion
 };
 
+/**
+ * @brief Pin the calling thread to a single CPU.
+ *
+ * Intended for long-running pool tasks (e.g. subscriber shards) that own
+ * their worker thread for the lifetime of the node.
+ *
+ * @return false if pinning failed or is not supported on this platform.
+ */
+inline bool pinCurrentThreadToCpu(int cpu)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (rc != 0)
+  {
+    zlc::warn("[ThreadPool] Failed to pin thread to CPU {} (error {})", cpu, rc);
+    return false;
+  }
+  return true;
+#else
+  zlc::warn("[ThreadPool] Thread pinning is not supported on this platform");
+  (void)cpu;
+  return false;
+#endif
+}
+
 } // namespace zlc
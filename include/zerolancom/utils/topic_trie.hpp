@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace zlc
+{
+
+/**
+ * @brief TopicTrie indexes topic patterns by their '/'-separated segments.
+ *
+ * Pattern syntax:
+ *   - a segment "*" matches exactly one segment of a topic name
+ *   - a final segment "**" matches one or more remaining segments
+ *   e.g. both "robot1", "*", "imu" and "robot1", "**" (joined by '/') match
+ *   the topic "robot1/sensors/imu".
+ *
+ * Usage:
+ *   TopicTrie trie;
+ *   trie.insert(pattern, subscription_id);
+ *   trie.match(topic_name, ids); // appends the ids of all matching patterns
+ *
+ * Design notes:
+ * - match() walks the trie along the topic name, following the literal child
+ *   and the "*" child of each node, so its cost depends on the name length and
+ *   the number of wildcard branches, not on the number of patterns stored.
+ * - Nodes are removed again when their last pattern is erased.
+ * - Not thread-safe; callers serialize access.
+ */
+class TopicTrie
+{
+public:
+  using Value = uint64_t;
+
+  TopicTrie();
+  ~TopicTrie();
+
+  // Non-copyable
+  TopicTrie(const TopicTrie &) = delete;
+  TopicTrie &operator=(const TopicTrie &) = delete;
+
+  /**
+   * @brief True if the name contains a wildcard segment.
+   */
+  static bool isPattern(const std::string &name);
+
+  /**
+   * @throws std::invalid_argument if "**" is not the last segment
+   */
+  void insert(const std::string &pattern, Value value);
+
+  /**
+   * @return false if the pattern/value pair was not stored.
+   */
+  bool erase(const std::string &pattern, Value value);
+
+  /**
+   * @brief Append the values of every pattern matching the topic name.
+   */
+  void match(const std::string &topic, std::vector<Value> &out) const;
+
+  // Number of stored pattern/value pairs
+  size_t size() const
+  {
+    return size_;
+  }
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+private:
+  struct Node
+  {
+    std::unordered_map<std::string, std::unique_ptr<Node>> children;
+    std::unique_ptr<Node> any; // "*"
+
+    std::vector<Value> values; // patterns ending at this node
+    std::vector<Value> rest;   // patterns ending with "**" below this node
+
+    bool unused() const
+    {
+      return children.empty() && !any && values.empty() && rest.empty();
+    }
+  };
+
+  void matchFrom(const Node &node, const std::vector<std::string> &segments,
+                 size_t depth, std::vector<Value> &out) const;
+
+  bool eraseFrom(Node &node, const std::vector<std::string> &segments, size_t depth,
+                 Value value);
+
+  std::unique_ptr<Node> root_;
+  size_t size_{0};
+};
+
+} // namespace zlc
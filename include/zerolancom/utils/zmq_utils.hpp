@@ -1,9 +1,15 @@
 #pragma once
 #include "zerolancom/utils/singleton.hpp"
+#include <algorithm>
+#include <array>
 #include <arpa/inet.h>
+#include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 #include <zmq.hpp>
 
 namespace zlc
@@ -54,6 +60,32 @@ public:
     assert(instance_ != nullptr);
     return ZMQSocket(instance_->context_, type);
   }
+
+  /**
+   * @brief Close a socket obtained from createSocket() and free its slot.
+   *
+   * Must be called from the thread that currently uses the socket. The pointer
+   * is invalid afterwards. Pending outgoing messages are delivered in the
+   * background for up to `linger` and discarded after that. Does nothing once
+   * the context has been destroyed, since the destructor already closed every
+   * remaining socket.
+   */
+  static void releaseSocket(ZMQSocket *socket, std::chrono::milliseconds linger = {})
+  {
+    if (instance_ == nullptr || socket == nullptr)
+    {
+      return;
+    }
+    instance_->_releaseSocket(socket, linger);
+  }
+
+  // Number of sockets currently owned by the context
+  static size_t socketCount()
+  {
+    assert(instance_ != nullptr);
+    std::lock_guard<std::mutex> lock(instance_->mutex_);
+    return instance_->sockets_.size();
+  }
   ~ZMQContext()
   {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -72,11 +104,56 @@ private:
     return sockets_.back().get();
   }
 
+  void _releaseSocket(ZMQSocket *socket, std::chrono::milliseconds linger)
+  {
+    std::unique_ptr<ZMQSocket> owned;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = std::find_if(sockets_.begin(), sockets_.end(),
+                             [socket](const std::unique_ptr<ZMQSocket> &s)
+                             { return s.get() == socket; });
+      if (it == sockets_.end())
+      {
+        return;
+      }
+      owned = std::move(*it);
+      sockets_.erase(it);
+    }
+    owned->set(zmq::sockopt::linger, static_cast<int>(linger.count()));
+    owned->close();
+  }
+
   std::mutex mutex_;
   zmq::context_t context_;
   std::vector<std::unique_ptr<ZMQSocket>> sockets_;
 };
 
+/**
+ * @brief Receive one whole multipart message into `frames`.
+ *
+ * Frames beyond N are read and dropped. Returns the number of frames of the
+ * message, or 0 if the receive failed.
+ */
+template <size_t N>
+size_t receiveMultipart(ZMQSocket &socket, std::array<zmq::message_t, N> &frames)
+{
+  size_t count = 0;
+  zmq::message_t extra;
+  do
+  {
+    zmq::message_t &frame = count < N ? frames[count] : extra;
+    if (!socket.recv(frame, zmq::recv_flags::none))
+    {
+      return 0;
+    }
+    ++count;
+    if (!frame.more())
+    {
+      return count;
+    }
+  } while (true);
+}
+
 inline int getBoundPort(ZMQSocket &socket)
 {
   // fetch endpoint string using modern cppzmq API
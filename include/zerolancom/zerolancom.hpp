@@ -5,10 +5,16 @@
 
 // Core headers
 #include "zerolancom/nodes/node_info_manager.hpp"
+#include "zerolancom/nodes/node_options.hpp"
 #include "zerolancom/sockets/client.hpp"
 #include "zerolancom/sockets/publisher.hpp"
+#include "zerolancom/sockets/service_client.hpp"
 #include "zerolancom/sockets/service_manager.hpp"
+#include "zerolancom/sockets/service_queue.hpp"
+#include "zerolancom/sockets/subscriber.hpp"
 #include "zerolancom/sockets/subscriber_manager.hpp"
+#include "zerolancom/sockets/synchronizer.hpp"
+#include "zerolancom/sockets/wait_set.hpp"
 #include "zerolancom/utils/logger.hpp"
 
 namespace zlc
@@ -21,6 +27,12 @@ namespace zlc
 void init(const std::string &node_name, const std::string &ip_address,
           const std::string &group = "224.0.0.1", int groupPort = 7720,
           const std::string &groupName = "zlc_default_group_name");
+
+/**
+ * @brief Initialize the node with full configuration (e.g. subscriber shards).
+ */
+void init(const std::string &node_name, const std::string &ip_address,
+          const NodeOptions &options);
 void shutdown();
 void sleep(int ms);
 void spin();
@@ -38,12 +50,42 @@ void registerServiceHandler(const std::string &service_name, HandlerT handler)
   auto &serviceManager = ServiceManager::instance();
 
   serviceManager.registerHandler(service_name, std::function(handler));
-  nodeInfoManager.registerLocalService(service_name, serviceManager.service_port);
+  nodeInfoManager.registerLocalService(service_name, serviceManager.service_port,
+                                       serviceManager.serviceId(service_name));
 
   zlc::info("Service {} registered at port {}", service_name,
             serviceManager.service_port);
 }
 
+/**
+ * @brief Register a handler that streams its response through a
+ * StreamWriter; clients read it with Client::requestStream().
+ */
+template <typename HandlerT>
+void registerStreamHandler(const std::string &service_name, HandlerT handler)
+{
+  auto &serviceManager = ServiceManager::instance();
+  serviceManager.registerStreamHandler(service_name, std::function(handler));
+  uint16_t port = serviceManager.service_port;
+  NodeInfoManager::instance().registerLocalService(
+      service_name, port, serviceManager.serviceId(service_name));
+}
+
+/**
+ * @brief Register a handler that takes a vector of requests and returns one
+ * response per request; see ServiceManager::registerBatchHandler().
+ */
+template <typename HandlerT>
+void registerBatchHandler(const std::string &service_name, HandlerT handler,
+                          const BatchOptions &options = {})
+{
+  auto &serviceManager = ServiceManager::instance();
+  serviceManager.registerBatchHandler(service_name, std::function(handler), options);
+  uint16_t port = serviceManager.service_port;
+  NodeInfoManager::instance().registerLocalService(
+      service_name, port, serviceManager.serviceId(service_name));
+}
+
 template <typename HandlerT, typename ClassT>
 void registerServiceHandler(const std::string &service_name, HandlerT handler,
                             ClassT *instance)
@@ -53,22 +95,60 @@ void registerServiceHandler(const std::string &service_name, HandlerT handler,
   serviceManager.registerHandler(service_name, handler, instance);
 
   uint16_t port = serviceManager.service_port;
-  NodeInfoManager::instance().registerLocalService(service_name, port);
+  NodeInfoManager::instance().registerLocalService(
+      service_name, port, serviceManager.serviceId(service_name));
+}
+
+/**
+ * @brief Stop delivering messages to a handler and close its socket.
+ * @return false if the id is unknown.
+ */
+bool unregisterSubscriberHandler(SubscriptionId id);
+
+/**
+ * @brief Subscribe a handler to a topic.
+ *
+ * The returned id can be passed to unregisterSubscriberHandler() or wrapped in
+ * a Subscription to unsubscribe automatically.
+ */
+template <typename HandlerT>
+SubscriptionId registerSubscriberHandler(const std::string &name, HandlerT callback)
+{
+  auto &subscriberManager = SubscriberManager::instance();
+  return subscriberManager.registerTopicSubscriber(name, callback);
 }
 
 template <typename HandlerT>
-void registerSubscriberHandler(const std::string &name, HandlerT callback)
+SubscriptionId registerSubscriberHandler(const std::string &name, HandlerT callback,
+                                         const SubscribeOptions &options)
 {
   auto &subscriberManager = SubscriberManager::instance();
-  subscriberManager.registerTopicSubscriber(name, callback);
+  return subscriberManager.registerTopicSubscriber(name, callback, options);
 }
 
 template <typename HandlerT, typename ClassT>
-void registerSubscriberHandler(const std::string &name, HandlerT callback,
-                               ClassT *instance)
+SubscriptionId registerSubscriberHandler(const std::string &name, HandlerT callback,
+                                         ClassT *instance,
+                                         const SubscribeOptions &options = {})
 {
   auto &subscriberManager = SubscriberManager::instance();
-  subscriberManager.registerTopicSubscriber(name, callback, instance);
+  return subscriberManager.registerTopicSubscriber(name, callback, instance, options);
+}
+
+/**
+ * @brief Received / expired / deadline-missed counters of a topic.
+ */
+inline TopicStatistics topicStatistics(const std::string &name)
+{
+  return SubscriberManager::instance().topicStatistics(name);
+}
+
+/**
+ * @brief Accepted / shed / queued counters and queue times of a service.
+ */
+inline ServiceStatistics serviceStatistics(const std::string &name)
+{
+  return ServiceManager::instance().serviceStatistics(name);
 }
 
 template <typename RequestType, typename ResponseType>
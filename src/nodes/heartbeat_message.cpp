@@ -37,9 +37,9 @@ Bytes HeartbeatMessage::encode() const
     buf.insert(buf.end(), ptr, ptr + 4);
   }
 
-  // Write service_port (int32, network byte order)
+  // Write control_port (int32, network byte order)
   {
-    uint32_t val = htonl(static_cast<uint32_t>(service_port));
+    uint32_t val = htonl(static_cast<uint32_t>(control_port));
     const uint8_t *ptr = reinterpret_cast<const uint8_t *>(&val);
     buf.insert(buf.end(), ptr, ptr + 4);
   }
@@ -82,11 +82,11 @@ HeartbeatMessage HeartbeatMessage::decode(const uint8_t *data, size_t size)
     offset += 4;
   }
 
-  // Read service_port (int32, network byte order)
+  // Read control_port (int32, network byte order)
   {
     uint32_t val;
     std::memcpy(&val, data + offset, 4);
-    msg.service_port = static_cast<int32_t>(ntohl(val));
+    msg.control_port = static_cast<int32_t>(ntohl(val));
     offset += 4;
   }
 
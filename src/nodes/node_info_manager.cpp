@@ -30,6 +30,7 @@ void NodeInfoManager::updateNodeUnlocked(const std::string &nodeID,
   nodes_info_[nodeID] = info;
   nodes_info_id_[nodeID] = info.infoID;
   nodes_heartbeat_[nodeID] = std::chrono::steady_clock::now();
+  generation_.fetch_add(1, std::memory_order_release);
 }
 
 bool NodeInfoManager::checkNodeIDUnlocked(const std::string &nodeID) const
@@ -47,12 +48,12 @@ bool NodeInfoManager::checkNodeInfoIDUnlocked(const std::string &nodeID,
 }
 
 std::optional<NodeInfo> NodeInfoManager::fetchNodeInfo(const std::string &ip,
-                                                       int32_t servicePort)
+                                                       int32_t controlPort)
 {
   try
   {
-    zlc::info("[NodeInfoManager] Fetching node info from {}:{}", ip, servicePort);
-    const std::string service_url = "tcp://" + ip + ":" + std::to_string(servicePort);
+    zlc::info("[NodeInfoManager] Fetching node info from {}:{}", ip, controlPort);
+    const std::string service_url = "tcp://" + ip + ":" + std::to_string(controlPort);
     // Create a temporary REQ socket
     NodeInfo info;
     Client::zlcRequest<Empty, NodeInfo>("get_node_info", service_url, Empty{}, info);
@@ -61,7 +62,7 @@ std::optional<NodeInfo> NodeInfoManager::fetchNodeInfo(const std::string &ip,
   catch (const std::exception &e)
   {
     zlc::warn("[NodeInfoManager] Failed to fetch node info from {}:{}: {}", ip,
-              servicePort, e.what());
+              controlPort, e.what());
     return std::nullopt;
   }
 }
@@ -86,6 +87,7 @@ void NodeInfoManager::removeNode(const std::string &nodeID)
   nodes_info_.erase(nodeID);
   nodes_info_id_.erase(nodeID);
   nodes_heartbeat_.erase(nodeID);
+  generation_.fetch_add(1, std::memory_order_release);
 }
 
 std::vector<SocketInfo>
@@ -114,6 +116,20 @@ NodeInfoManager::getPublisherInfo(const std::string &topicName) const
   return result;
 }
 
+std::vector<SocketInfo> NodeInfoManager::getAllPublisherInfo() const
+{
+  std::shared_lock lock(data_mutex_);
+
+  std::vector<SocketInfo> result;
+  for (const auto &[id, node] : nodes_info_)
+  {
+    result.insert(result.end(), node.topics.begin(), node.topics.end());
+  }
+  result.insert(result.end(), localNodeInfo_.topics.begin(),
+                localNodeInfo_.topics.end());
+  return result;
+}
+
 const SocketInfo *NodeInfoManager::getServiceInfo(const std::string &serviceName) const
 {
   std::shared_lock lock(data_mutex_);
@@ -138,6 +154,35 @@ const SocketInfo *NodeInfoManager::getServiceInfo(const std::string &serviceName
   return nullptr;
 }
 
+std::vector<SocketInfo>
+NodeInfoManager::getServiceProviders(const std::string &serviceName) const
+{
+  std::vector<SocketInfo> result;
+  {
+    std::shared_lock lock(data_mutex_);
+    for (const auto &[id, node] : nodes_info_)
+    {
+      for (const auto &t : node.services)
+      {
+        if (t.name == serviceName)
+        {
+          result.push_back(t);
+        }
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(local_mutex_);
+  for (const auto &t : localNodeInfo_.services)
+  {
+    if (t.name == serviceName)
+    {
+      result.push_back(t);
+    }
+  }
+  return result;
+}
+
 void NodeInfoManager::checkHeartbeats()
 {
   std::unique_lock lock(data_mutex_);
@@ -161,6 +206,7 @@ void NodeInfoManager::checkHeartbeats()
     nodes_info_.erase(nodeID);
     nodes_info_id_.erase(nodeID);
     nodes_heartbeat_.erase(nodeID);
+    generation_.fetch_add(1, std::memory_order_release);
     zlc::info("Node {} removed due to heartbeat timeout", nodeID);
   }
 }
@@ -193,9 +239,18 @@ void NodeInfoManager::processHeartbeat(const HeartbeatMessage &heartbeat,
       }
     }
 
+    if (isNew && (heartbeat.zlc_version[0] != ZLC_VERSION_MAJOR ||
+                  heartbeat.zlc_version[1] != ZLC_VERSION_MINOR))
+    {
+      zlc::warn("[NodeInfoManager] Node at {} uses protocol {}.{} but this node uses "
+                "{}.{}; messages between them will not decode",
+                nodeIP, heartbeat.zlc_version[0], heartbeat.zlc_version[1],
+                ZLC_VERSION_MAJOR, ZLC_VERSION_MINOR);
+    }
+
     if (needsFetch)
     {
-      auto nodeInfoOpt = fetchNodeInfo(nodeIP, heartbeat.service_port);
+      auto nodeInfoOpt = fetchNodeInfo(nodeIP, heartbeat.control_port);
       if (nodeInfoOpt.has_value())
       {
         NodeInfo &nodeInfo = nodeInfoOpt.value();
@@ -234,10 +289,16 @@ void NodeInfoManager::setGroupName(const std::string &name)
   groupName_ = name;
 }
 
-void NodeInfoManager::setServicePort(int32_t port)
+void NodeInfoManager::setControlPort(int32_t port)
 {
   std::lock_guard<std::mutex> lock(local_mutex_);
-  servicePort_ = port;
+  controlPort_ = port;
+}
+
+int32_t NodeInfoManager::controlPort() const
+{
+  std::lock_guard<std::mutex> lock(local_mutex_);
+  return controlPort_;
 }
 
 HeartbeatMessage NodeInfoManager::createHeartbeat() const
@@ -247,7 +308,7 @@ HeartbeatMessage NodeInfoManager::createHeartbeat() const
   msg.zlc_version = {ZLC_VERSION_MAJOR, ZLC_VERSION_MINOR, ZLC_VERSION_PATCH};
   msg.node_id = localNodeInfo_.nodeID;
   msg.info_id = static_cast<int32_t>(localNodeInfo_.infoID);
-  msg.service_port = servicePort_;
+  msg.control_port = controlPort_;
   msg.group_name = groupName_;
   return msg;
 }
@@ -258,18 +319,39 @@ NodeInfo NodeInfoManager::getLocalNodeInfo() const
   return localNodeInfo_;
 }
 
-void NodeInfoManager::registerLocalTopic(const std::string &name, uint16_t port)
+void NodeInfoManager::registerLocalTopic(const std::string &name, uint16_t port,
+                                         uint16_t credit_port)
 {
   std::lock_guard<std::mutex> lock(local_mutex_);
-  localNodeInfo_.topics.push_back(SocketInfo{name, localNodeInfo_.ip, port});
+  localNodeInfo_.topics.push_back(
+      SocketInfo{name, localNodeInfo_.ip, port, credit_port});
   ++localNodeInfo_.infoID;
 }
 
-void NodeInfoManager::registerLocalService(const std::string &name, uint16_t port)
+void NodeInfoManager::registerLocalService(const std::string &name, uint16_t port,
+                                           uint32_t service_id)
 {
   std::lock_guard<std::mutex> lock(local_mutex_);
-  localNodeInfo_.services.push_back(SocketInfo{name, localNodeInfo_.ip, port});
+  localNodeInfo_.services.push_back(
+      SocketInfo{name, localNodeInfo_.ip, port, 0, service_id});
+  ++localNodeInfo_.infoID;
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+void NodeInfoManager::unregisterLocalService(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(local_mutex_);
+  auto &services = localNodeInfo_.services;
+  auto it = std::remove_if(services.begin(), services.end(),
+                           [&name](const SocketInfo &info)
+                           { return info.name == name; });
+  if (it == services.end())
+  {
+    return;
+  }
+  services.erase(it, services.end());
   ++localNodeInfo_.infoID;
+  generation_.fetch_add(1, std::memory_order_release);
 }
 
 } // namespace zlc
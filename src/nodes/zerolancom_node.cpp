@@ -5,6 +5,21 @@
 namespace zlc
 {
 
+namespace
+{
+
+NodeOptions makeOptions(const std::string &group, int groupPort,
+                        const std::string &groupName)
+{
+  NodeOptions options;
+  options.group = group;
+  options.groupPort = groupPort;
+  options.groupName = groupName;
+  return options;
+}
+
+} // namespace
+
 ZeroLanComNode::ZeroLanComNode(const std::string &name, const std::string &ip,
                                const std::string &group, int groupPort)
     : ZeroLanComNode(name, ip, group, groupPort, "zlc_default_group_name")
@@ -14,18 +29,31 @@ ZeroLanComNode::ZeroLanComNode(const std::string &name, const std::string &ip,
 ZeroLanComNode::ZeroLanComNode(const std::string &name, const std::string &ip,
                                const std::string &group, int groupPort,
                                const std::string &groupName)
+    : ZeroLanComNode(name, ip, makeOptions(group, groupPort, groupName))
+{
+}
+
+ZeroLanComNode::ZeroLanComNode(const std::string &name, const std::string &ip,
+                               const NodeOptions &options)
 {
-  ThreadPool::initExternal(4); // 4 worker threads
+  // One worker per long-running task (multicast, services, client I/O, shards)
+  ThreadPool::initExternal(options.threadPoolSize());
   ZMQContext::initExternal();
   NodeInfoManager::initExternal(name, ip);
-  ServiceManager::initExternal(ip);
+  ServiceManager::initExternal(ip, options.service_workers);
+  ClientManager::initExternal();
+
+  // Discovery gets its own socket and worker, so user load cannot delay it
+  control_ = std::make_unique<ServiceManager>(ip, 1);
 
-  // Set service port in NodeInfoManager before starting multicast
-  NodeInfoManager::instance().setServicePort(ServiceManager::instance().service_port);
+  // Set control port in NodeInfoManager before starting multicast
+  NodeInfoManager::instance().setControlPort(control_->service_port);
 
-  MulticastReceiver::initExternal(group, groupPort, ip, groupName);
-  MulticastSender::initExternal(group, groupPort, ip, groupName);
-  SubscriberManager::initExternal();
+  MulticastReceiver::initExternal(options.group, options.groupPort, ip,
+                                  options.groupName);
+  MulticastSender::initExternal(options.group, options.groupPort, ip,
+                                options.groupName);
+  SubscriberManager::initExternal(options);
 
   // Register internal get_node_info service
   registerGetNodeInfoService();
@@ -33,7 +61,9 @@ ZeroLanComNode::ZeroLanComNode(const std::string &name, const std::string &ip,
   ThreadPool::instance().start();
   MulticastSender::instance().start();
   MulticastReceiver::instance().start();
+  control_->start();
   ServiceManager::instance().start();
+  ClientManager::instance().start();
   SubscriberManager::instance().start();
   running = true;
 }
@@ -45,11 +75,17 @@ ZeroLanComNode::~ZeroLanComNode()
 
 void ZeroLanComNode::registerGetNodeInfoService()
 {
-  auto &serviceManager = ServiceManager::instance();
-  serviceManager.registerHandler<Empty, NodeInfo>(
-      "get_node_info",
-      [](const Empty &) -> NodeInfo
-      { return NodeInfoManager::instance().getLocalNodeInfo(); });
+  auto getNodeInfo = [](const Empty &) -> NodeInfo
+  { return NodeInfoManager::instance().getLocalNodeInfo(); };
+  control_->registerHandler<Empty, NodeInfo>("get_node_info", getNodeInfo);
+  // Still answered on the service port for peers that fetch it there
+  ServiceManager::instance().registerHandler<Empty, NodeInfo>("get_node_info",
+                                                              getNodeInfo);
+}
+
+int ZeroLanComNode::controlPort() const
+{
+  return control_ ? control_->service_port : 0;
 }
 
 void ZeroLanComNode::stop()
@@ -57,13 +93,20 @@ void ZeroLanComNode::stop()
   running = false;
   MulticastSender::instance().stop();
   MulticastReceiver::instance().stop();
+  if (control_)
+  {
+    control_->stop();
+  }
   ServiceManager::instance().stop();
+  ClientManager::instance().stop();
   SubscriberManager::instance().stop();
   ThreadPool::instance().stop();
 
   // Destroy in reverse order of initialization, respecting dependencies
   // SubscriberManager subscribes to NodeInfoManager events, so destroy first
   SubscriberManager::destroy();
+  ClientManager::destroy();
+  control_.reset();
   ServiceManager::destroy();
   MulticastReceiver::destroy();
   MulticastSender::destroy();
@@ -1,6 +1,7 @@
 #include "zerolancom/serialization/binary_codec.hpp"
 
 #include "zerolancom/utils/exception.hpp"
+#include "zerolancom/utils/request_result.hpp"
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
@@ -42,8 +43,165 @@ void ByteBuffer::write(const char *buf, size_t len)
   size += len;
 }
 
+uint8_t *ByteBuffer::release()
+{
+  uint8_t *released = data;
+  data = nullptr;
+  size = 0;
+  capacity = 0;
+  return released;
+}
+
 /* ================= Utilities ================= */
 
+namespace
+{
+
+// Position is the wire value; only ever append
+constexpr std::string_view STATUS_CODES[] = {
+    ResponseStatus::SUCCESS,         ResponseStatus::NOSERVICE,
+    ResponseStatus::INVALID_RESPONSE, ResponseStatus::SERVICE_FAIL,
+    ResponseStatus::SERVICE_TIMEOUT, ResponseStatus::INVALID_REQUEST,
+    ResponseStatus::UNKNOWN_ERROR,   ResponseStatus::STREAM_ITEM,
+    ResponseStatus::OVERLOADED,
+};
+
+constexpr size_t COMPACT_HEADER_SIZE = 9;
+
+void putUint32(Bytes &buf, uint32_t value)
+{
+  buf.push_back(static_cast<uint8_t>((value >> 24) & 0xFF));
+  buf.push_back(static_cast<uint8_t>((value >> 16) & 0xFF));
+  buf.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+  buf.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+uint32_t getUint32(const uint8_t *p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+bool isCompactHeader(ByteView payload)
+{
+  // Optionally followed by a flags byte
+  const bool sized =
+      payload.size == COMPACT_HEADER_SIZE || payload.size == COMPACT_HEADER_SIZE + 1;
+  return payload.data && sized && payload.data[0] == 0;
+}
+
+// Budget and flags of a named header, after its NUL byte; null if it has none
+const uint8_t *namedHeaderTail(ByteView payload)
+{
+  const uint8_t *nul = std::find(payload.begin(), payload.end(), 0);
+  const auto tail = payload.end() - nul;
+  return tail == 5 || tail == 6 ? nul + 1 : nullptr;
+}
+
+} // namespace
+
+Bytes encodeServiceHeader(const std::string &service_name, uint32_t budget_ms,
+                          uint8_t flags)
+{
+  Bytes buf(service_name.begin(), service_name.end());
+  if (budget_ms == 0 && flags == 0)
+  {
+    return buf;
+  }
+  buf.push_back(0);
+  putUint32(buf, budget_ms);
+  if (flags != 0)
+  {
+    buf.push_back(flags);
+  }
+  return buf;
+}
+
+Bytes encodeServiceHeader(uint32_t service_id, uint32_t budget_ms, uint8_t flags)
+{
+  Bytes buf;
+  buf.reserve(COMPACT_HEADER_SIZE + 1);
+  buf.push_back(0);
+  putUint32(buf, service_id);
+  putUint32(buf, budget_ms);
+  if (flags != 0)
+  {
+    buf.push_back(flags);
+  }
+  return buf;
+}
+
+uint32_t decodeServiceId(ByteView payload)
+{
+  return isCompactHeader(payload) ? getUint32(payload.data + 1) : 0;
+}
+
+uint32_t decodeServiceBudget(ByteView payload)
+{
+  if (!payload.data)
+    return 0;
+
+  if (isCompactHeader(payload))
+    return getUint32(payload.data + 5);
+
+  const uint8_t *tail = namedHeaderTail(payload);
+  return tail ? getUint32(tail) : 0;
+}
+
+uint8_t decodeServiceFlags(ByteView payload)
+{
+  if (!payload.data)
+    return 0;
+
+  if (isCompactHeader(payload))
+    return payload.size > COMPACT_HEADER_SIZE ? payload.data[COMPACT_HEADER_SIZE] : 0;
+
+  const uint8_t *tail = namedHeaderTail(payload);
+  return tail && payload.end() - tail == 5 ? tail[4] : 0;
+}
+
+bool encodeStatus(std::string_view code, uint8_t &status)
+{
+  for (size_t i = 0; i < std::size(STATUS_CODES); ++i)
+  {
+    if (STATUS_CODES[i] == code)
+    {
+      status = static_cast<uint8_t>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string_view decodeStatus(ByteView frame)
+{
+  if (frame.size != 1)
+    return std::string_view(reinterpret_cast<const char *>(frame.data), frame.size);
+
+  return frame.data[0] < std::size(STATUS_CODES) ? STATUS_CODES[frame.data[0]]
+                                                 : ResponseStatus::UNKNOWN_ERROR;
+}
+
+Bytes encodeStreamCredit(uint32_t credit, ByteView request)
+{
+  Bytes buf;
+  buf.reserve(4 + request.size);
+  putUint32(buf, credit);
+  buf.insert(buf.end(), request.begin(), request.end());
+  return buf;
+}
+
+uint32_t decodeStreamCredit(ByteView &payload)
+{
+  if (!payload.data || payload.size < 4)
+    throw DecodeException("stream credit too short");
+
+  uint32_t credit = getUint32(payload.data);
+  payload.data += 4;
+  payload.size -= 4;
+  return credit;
+}
+
 std::string decodeServiceHeader(ByteView payload)
 {
   constexpr size_t kMaxLen = 1024;
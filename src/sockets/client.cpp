@@ -7,44 +7,51 @@ namespace zlc
 {
 
 void Client::sendRequest(const std::string &service_name, const ByteView &payload,
-                         ZMQSocket &socket)
+                         ZMQSocket &socket, std::chrono::milliseconds budget)
 {
-  // Send service name frame
-  socket.send(zmq::buffer(service_name), zmq::send_flags::sndmore);
-
-  // Send payload frame
-  socket.send(zmq::buffer(payload.data, payload.size), zmq::send_flags::none);
+  // Send service name frame, with the caller's deadline if it has one
+  Bytes header = encodeServiceHeader(service_name, ClientManager::budgetMillis(budget));
+  sendRequest(header, payload, socket);
 
   zlc::info("[Client] Sent request to service '{}'", service_name);
 }
 
-void Client::receiveResponse(ZMQSocket &socket, zmq::message_t &payloadMsg,
-                             const std::string &service_name)
+void Client::sendRequest(const Bytes &header, const ByteView &payload,
+                         ZMQSocket &socket)
+{
+  socket.send(zmq::buffer(header), zmq::send_flags::sndmore);
+  socket.send(zmq::buffer(payload.data, payload.size), zmq::send_flags::none);
+}
+
+std::string Client::receiveResponse(ZMQSocket &socket, zmq::message_t &payloadMsg,
+                                    const std::string &service_name)
 {
   zmq::message_t statusMsg;
 
   if (!socket.recv(statusMsg, zmq::recv_flags::none))
   {
     zlc::error("Timeout waiting for response from service {}", service_name);
-    return;
+    return std::string(ResponseStatus::SERVICE_TIMEOUT);
   }
 
   if (!statusMsg.more())
   {
     zlc::error("No payload frame received for service response from {}", service_name);
-    return;
+    return std::string(ResponseStatus::INVALID_RESPONSE);
   }
 
   if (!socket.recv(payloadMsg, zmq::recv_flags::none))
   {
     zlc::error("Timeout waiting for payload from service {}", service_name);
-    return;
+    return std::string(ResponseStatus::SERVICE_TIMEOUT);
   }
 
   if (payloadMsg.more())
   {
     zlc::error("More frames received than expected from service {}", service_name);
   }
+  return std::string(decodeStatus(
+      ByteView{static_cast<const uint8_t *>(statusMsg.data()), statusMsg.size()}));
 }
 
 } // namespace zlc
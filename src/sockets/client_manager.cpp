@@ -0,0 +1,529 @@
+#include "zerolancom/sockets/client_manager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "zerolancom/nodes/node_info_manager.hpp"
+#include "zerolancom/utils/logger.hpp"
+#include "zerolancom/utils/request_result.hpp"
+
+namespace zlc
+{
+
+ClientManager::~ClientManager()
+{
+  stop();
+}
+
+void ClientManager::start()
+{
+  stopping_ = false;
+
+  // zmq::poll blocks until there is work, so no extra delay is needed
+  poll_task_ = std::make_unique<PeriodicTask>([this]() { this->pollOnce(); }, 0,
+                                              ThreadPool::instance());
+  poll_task_->start();
+}
+
+void ClientManager::stop()
+{
+  if (!poll_task_)
+  {
+    return;
+  }
+
+  stopping_ = true;
+  wakeup_.trigger();
+  poll_task_->stop();
+  poll_task_.reset();
+
+  // The I/O thread is gone, so its sockets can be closed from here
+  for (auto &[url, socket] : endpoints_)
+  {
+    ZMQContext::releaseSocket(socket);
+  }
+  endpoints_.clear();
+  failAll();
+
+  size_t unsent = 0;
+  for (auto &[url, requests] : backlog_)
+  {
+    unsent += requests.size();
+  }
+  if (unsent > 0)
+  {
+    zlc::warn("[ClientManager] Dropping {} unsent one-way requests", unsent);
+    dropped_one_way_.fetch_add(unsent, std::memory_order_relaxed);
+  }
+  backlog_.clear();
+
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  for (auto &[url, sockets] : idle_connections_)
+  {
+    for (ZMQSocket *socket : sockets)
+    {
+      ZMQContext::releaseSocket(socket);
+    }
+  }
+  idle_connections_.clear();
+}
+
+uint32_t ClientManager::budgetMillis(std::chrono::nanoseconds remaining)
+{
+  if (remaining.count() <= 0)
+  {
+    return 0;
+  }
+  auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+  return static_cast<uint32_t>(
+      std::min<int64_t>(ms, std::numeric_limits<uint32_t>::max()));
+}
+
+ZMQSocket *ClientManager::acquireConnection(const std::string &url)
+{
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    auto it = idle_connections_.find(url);
+    if (it != idle_connections_.end() && !it->second.empty())
+    {
+      ZMQSocket *socket = it->second.back();
+      it->second.pop_back();
+      return socket;
+    }
+  }
+
+  ZMQSocket *socket = ZMQContext::createSocket(zmq::socket_type::dealer);
+  socket->connect(url);
+  zlc::info("[ClientManager] Opened pooled connection to {}", url);
+  return socket;
+}
+
+void ClientManager::releaseConnection(const std::string &url, ZMQSocket *socket)
+{
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    auto &idle = idle_connections_[url];
+    if (!stopping_ && idle.size() < MAX_IDLE_CONNECTIONS)
+    {
+      idle.push_back(socket);
+      return;
+    }
+  }
+  ZMQContext::releaseSocket(socket);
+}
+
+size_t ClientManager::idleConnections() const
+{
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  size_t count = 0;
+  for (const auto &[url, sockets] : idle_connections_)
+  {
+    count += sockets.size();
+  }
+  return count;
+}
+
+std::vector<std::string> ClientManager::providerUrls(const std::string &service_name)
+{
+  std::vector<std::string> urls;
+  for (const auto &info : NodeInfoManager::instance().getServiceProviders(service_name))
+  {
+    urls.push_back("tcp://" + info.ip + ":" + std::to_string(info.port));
+  }
+  return urls;
+}
+
+ClientManager::Route &ClientManager::route(const std::string &service_name,
+                                           uint64_t generation)
+{
+  auto [it, inserted] = routes_.try_emplace(service_name);
+  Route &route = it->second;
+  if (inserted || route.generation != generation)
+  {
+    std::vector<std::string> urls;
+    route.ids.clear();
+    auto providers = NodeInfoManager::instance().getServiceProviders(service_name);
+    for (const auto &info : providers)
+    {
+      urls.push_back("tcp://" + info.ip + ":" + std::to_string(info.port));
+      route.ids[urls.back()] = info.service_id;
+    }
+    route.balancer.setEndpoints(std::move(urls));
+    route.generation = generation;
+  }
+  return route;
+}
+
+std::string ClientManager::selectProvider(const std::string &service_name,
+                                          std::string_view key)
+{
+  uint64_t generation = NodeInfoManager::instance().discoveryGeneration();
+
+  std::lock_guard<std::mutex> lock(routes_mutex_);
+  Route &selected = route(service_name, generation);
+  selected.balancer.setPolicy(policy_);
+
+  const auto &urls = selected.balancer.endpoints();
+  if (urls.empty())
+  {
+    routes_.erase(service_name);
+    return {};
+  }
+  return urls[selected.balancer.pick(key)];
+}
+
+uint32_t ClientManager::serviceId(const std::string &service_name,
+                                  const std::string &url)
+{
+  uint64_t generation = NodeInfoManager::instance().discoveryGeneration();
+
+  std::lock_guard<std::mutex> lock(routes_mutex_);
+  const auto &ids = route(service_name, generation).ids;
+  auto it = ids.find(url);
+  return it == ids.end() ? 0 : it->second;
+}
+
+Bytes ClientManager::serviceHeader(const std::string &service_name,
+                                   const std::string &url, uint32_t budget_ms,
+                                   uint8_t flags)
+{
+  if (uint32_t id = serviceId(service_name, url))
+  {
+    return encodeServiceHeader(id, budget_ms, flags);
+  }
+  return encodeServiceHeader(service_name, budget_ms, flags);
+}
+
+void ClientManager::setLoadBalancing(LoadBalancing policy)
+{
+  std::lock_guard<std::mutex> lock(routes_mutex_);
+  policy_ = policy;
+}
+
+void ClientManager::send(const std::string &url, const std::string &service_name,
+                         Bytes payload, ReplyCallback callback,
+                         std::chrono::milliseconds timeout)
+{
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  pending_count_.fetch_add(1, std::memory_order_relaxed);
+  {
+    // Checked under the lock so that stop() either sees the request or we
+    // see the stop
+    std::lock_guard<std::mutex> lock(outbox_mutex_);
+    if (!stopping_)
+    {
+      outbox_.push_back({url, service_name, std::move(payload), std::move(callback),
+                         deadline, EndpointLoad::of(url)});
+      wakeup_.trigger();
+      return;
+    }
+  }
+  complete(callback, std::string(ResponseStatus::UNKNOWN_ERROR), ByteView{});
+}
+
+bool ClientManager::sendOneWay(const std::string &url, const std::string &service_name,
+                               Bytes payload)
+{
+  std::lock_guard<std::mutex> lock(outbox_mutex_);
+  if (stopping_)
+  {
+    return false;
+  }
+  outbox_.push_back({url, service_name, std::move(payload), nullptr, {}, nullptr});
+  wakeup_.trigger();
+  return true;
+}
+
+void ClientManager::pollOnce()
+{
+  if (stopping_)
+  {
+    return;
+  }
+
+  try
+  {
+    std::vector<zmq::pollitem_t> items;
+    std::vector<ZMQSocket *> sockets;
+    items.reserve(endpoints_.size() + 1);
+    items.push_back({nullptr, wakeup_.fd(), ZMQ_POLLIN, 0});
+    for (auto &[url, socket] : endpoints_)
+    {
+      // Waiting to write only while one-way requests are held back
+      short events = backlog_.count(url) ? ZMQ_POLLIN | ZMQ_POLLOUT : ZMQ_POLLIN;
+      items.push_back({socket->handle(), 0, events, 0});
+      sockets.push_back(socket);
+    }
+
+    zmq::poll(items.data(), items.size(),
+              pollTimeout(std::chrono::steady_clock::now()));
+
+    if (items[0].revents & ZMQ_POLLIN)
+    {
+      sendQueued();
+    }
+    bool writable = false;
+    for (size_t i = 1; i < items.size(); ++i)
+    {
+      if (items[i].revents & ZMQ_POLLIN)
+      {
+        receiveReplies(*sockets[i - 1]);
+      }
+      writable |= (items[i].revents & ZMQ_POLLOUT) != 0;
+    }
+    if (writable)
+    {
+      sendBacklog();
+    }
+    expireRequests(std::chrono::steady_clock::now());
+  }
+  catch (const zmq::error_t &e)
+  {
+    if (e.num() == ETERM)
+    {
+      // The loop has no interval, so rerunning it would spin until stop()
+      zlc::info("[ClientManager] Context terminated during poll");
+      poll_task_->cancel();
+      return;
+    }
+    zlc::error("[ClientManager] ZMQ error: {}", e.what());
+  }
+}
+
+ZMQSocket *ClientManager::endpoint(const std::string &url)
+{
+  auto it = endpoints_.find(url);
+  if (it != endpoints_.end())
+  {
+    return it->second;
+  }
+
+  ZMQSocket *socket = ZMQContext::createSocket(zmq::socket_type::dealer);
+  socket->connect(url);
+  endpoints_.emplace(url, socket);
+  zlc::info("[ClientManager] Connected to {}", url);
+  return socket;
+}
+
+void ClientManager::sendQueued()
+{
+  // Reset before taking the queue so that a later trigger is not lost
+  wakeup_.reset();
+
+  std::vector<Outgoing> outgoing;
+  {
+    std::lock_guard<std::mutex> lock(outbox_mutex_);
+    outgoing.swap(outbox_);
+  }
+
+  bool one_way = false;
+  for (auto &request : outgoing)
+  {
+    if (!request.callback)
+    {
+      // Sent after those held back earlier, to keep their order
+      auto &backlog = backlog_[request.url];
+      if (backlog.size() >= MAX_ONE_WAY_BACKLOG)
+      {
+        dropped_one_way_.fetch_add(1, std::memory_order_relaxed);
+        zlc::warn("[ClientManager] One-way backlog to {} is full, dropping request "
+                  "for '{}'",
+                  request.url, request.service_name);
+        continue;
+      }
+      backlog.push_back(std::move(request));
+      one_way = true;
+      continue;
+    }
+
+    ZMQSocket *socket = endpoint(request.url);
+    uint64_t id = next_id_++;
+
+    // Frames: [request id][empty delimiter][service name][payload]
+    if (!socket->send(zmq::buffer(&id, sizeof(id)),
+                      zmq::send_flags::sndmore | zmq::send_flags::dontwait))
+    {
+      zlc::warn("[ClientManager] Send queue to {} is full, failing request for '{}'",
+                request.url, request.service_name);
+      complete(request.callback, std::string(ResponseStatus::SERVICE_FAIL),
+               ByteView{});
+      continue;
+    }
+    // Tell the service when this request stops being worth answering
+    uint32_t budget = std::max<uint32_t>(
+        1, budgetMillis(request.deadline - std::chrono::steady_clock::now()));
+    Bytes header = serviceHeader(request.service_name, request.url, budget);
+    socket->send(zmq::message_t(), zmq::send_flags::sndmore);
+    socket->send(zmq::buffer(header), zmq::send_flags::sndmore);
+    socket->send(zmq::buffer(request.payload), zmq::send_flags::none);
+
+    request.load->start();
+    pending_.emplace(id, Pending{std::move(request.callback), std::move(request.load),
+                                 std::chrono::steady_clock::now()});
+    deadlines_.emplace(request.deadline, id);
+  }
+  if (one_way)
+  {
+    sendBacklog();
+  }
+}
+
+void ClientManager::sendBacklog()
+{
+  for (auto it = backlog_.begin(); it != backlog_.end();)
+  {
+    ZMQSocket *socket = endpoint(it->first);
+    auto &requests = it->second;
+    while (!requests.empty())
+    {
+      Outgoing &request = requests.front();
+
+      // Frames: [empty delimiter][service header][payload]; without an id,
+      // since no reply is correlated
+      if (!socket->send(zmq::message_t(),
+                        zmq::send_flags::sndmore | zmq::send_flags::dontwait))
+      {
+        break; // queue full; retried once the socket is writable
+      }
+      Bytes header =
+          serviceHeader(request.service_name, request.url, 0, SERVICE_FLAG_ONE_WAY);
+      socket->send(zmq::buffer(header), zmq::send_flags::sndmore);
+      socket->send(zmq::buffer(request.payload), zmq::send_flags::none);
+      requests.pop_front();
+    }
+    it = requests.empty() ? backlog_.erase(it) : std::next(it);
+  }
+}
+
+void ClientManager::receiveReplies(ZMQSocket &socket)
+{
+  while (true)
+  {
+    // Frames: [request id][empty delimiter][status code][payload]
+    std::vector<zmq::message_t> frames;
+    zmq::message_t frame;
+    if (!socket.recv(frame, zmq::recv_flags::dontwait))
+    {
+      return;
+    }
+    frames.push_back(std::move(frame));
+    while (frames.back().more())
+    {
+      socket.recv(frame, zmq::recv_flags::none);
+      frames.push_back(std::move(frame));
+    }
+
+    if (frames.size() != 4 || frames[0].size() != sizeof(uint64_t) ||
+        frames[1].size() != 0)
+    {
+      zlc::warn("[ClientManager] Dropping malformed reply ({} frames)",
+                frames.size());
+      continue;
+    }
+
+    uint64_t id;
+    std::memcpy(&id, frames[0].data(), sizeof(id));
+    auto it = pending_.find(id);
+    if (it == pending_.end())
+    {
+      continue;
+    }
+    Pending request = std::move(it->second);
+    pending_.erase(it);
+
+    ByteView status{static_cast<const uint8_t *>(frames[2].data()), frames[2].size()};
+    complete(request, std::string(decodeStatus(status)),
+             ByteView{static_cast<const uint8_t *>(frames[3].data()),
+                      frames[3].size()});
+  }
+}
+
+std::chrono::milliseconds
+ClientManager::pollTimeout(std::chrono::steady_clock::time_point now)
+{
+  if (deadlines_.empty())
+  {
+    return std::chrono::milliseconds(-1);
+  }
+  auto remaining = deadlines_.top().first - now;
+  if (remaining <= std::chrono::steady_clock::duration::zero())
+  {
+    return std::chrono::milliseconds(0);
+  }
+  // Round up so that the poll does not return just before the deadline
+  return std::chrono::ceil<std::chrono::milliseconds>(remaining);
+}
+
+void ClientManager::expireRequests(std::chrono::steady_clock::time_point now)
+{
+  while (!deadlines_.empty() && deadlines_.top().first <= now)
+  {
+    uint64_t id = deadlines_.top().second;
+    deadlines_.pop();
+
+    auto it = pending_.find(id);
+    if (it == pending_.end())
+    {
+      continue; // already answered
+    }
+    Pending request = std::move(it->second);
+    pending_.erase(it);
+
+    zlc::warn("[ClientManager] Request {} timed out", id);
+    complete(request, std::string(ResponseStatus::SERVICE_TIMEOUT), ByteView{});
+  }
+}
+
+void ClientManager::complete(const ReplyCallback &callback, const std::string &code,
+                             const ByteView &payload)
+{
+  // Counted first so that the callback already observes its own completion
+  pending_count_.fetch_sub(1, std::memory_order_relaxed);
+  try
+  {
+    callback(code, payload);
+  }
+  catch (const std::exception &e)
+  {
+    zlc::error("[ClientManager] Exception in reply callback: {}", e.what());
+  }
+}
+
+void ClientManager::complete(Pending &request, const std::string &code,
+                             const ByteView &payload)
+{
+  // A timed-out call counts with the time it waited, which keeps balancers
+  // away from a provider that stopped answering
+  request.load->finish(std::chrono::steady_clock::now() - request.sent);
+  complete(request.callback, code, payload);
+}
+
+void ClientManager::failAll()
+{
+  std::vector<Outgoing> outgoing;
+  {
+    std::lock_guard<std::mutex> lock(outbox_mutex_);
+    outgoing.swap(outbox_);
+  }
+
+  const std::string code(ResponseStatus::UNKNOWN_ERROR);
+  for (auto &request : outgoing)
+  {
+    if (!request.callback)
+    {
+      dropped_one_way_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    complete(request.callback, code, ByteView{});
+  }
+  for (auto &[id, request] : pending_)
+  {
+    request.load->abandon();
+    complete(request.callback, code, ByteView{});
+  }
+  pending_.clear();
+  deadlines_ = {};
+}
+
+} // namespace zlc
@@ -0,0 +1,492 @@
+#include "zerolancom/sockets/flow_control.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "zerolancom/utils/logger.hpp"
+
+namespace zlc
+{
+
+/* ================= CreditMessage ================= */
+
+namespace
+{
+
+void writeString(Bytes &buf, const std::string &value)
+{
+  if (value.size() > 0xFFFF)
+  {
+    throw std::runtime_error("CreditMessage: string longer than 65535 bytes");
+  }
+  buf.push_back(static_cast<uint8_t>((value.size() >> 8) & 0xFF));
+  buf.push_back(static_cast<uint8_t>(value.size() & 0xFF));
+  buf.insert(buf.end(), value.begin(), value.end());
+}
+
+uint16_t readU16(const uint8_t *data, size_t size, size_t &offset)
+{
+  if (offset + 2 > size)
+  {
+    throw std::runtime_error("CreditMessage: truncated HELLO");
+  }
+  uint16_t value = static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+  offset += 2;
+  return value;
+}
+
+std::string readString(const uint8_t *data, size_t size, size_t &offset)
+{
+  uint16_t length = readU16(data, size, offset);
+  if (offset + length > size)
+  {
+    throw std::runtime_error("CreditMessage: truncated HELLO");
+  }
+  std::string value(reinterpret_cast<const char *>(data) + offset, length);
+  offset += length;
+  return value;
+}
+
+} // namespace
+
+Bytes CreditMessage::encode() const
+{
+  Bytes buf(SIZE);
+  buf[0] = type;
+  buf[1] = static_cast<uint8_t>((credits >> 24) & 0xFF);
+  buf[2] = static_cast<uint8_t>((credits >> 16) & 0xFF);
+  buf[3] = static_cast<uint8_t>((credits >> 8) & 0xFF);
+  buf[4] = static_cast<uint8_t>(credits & 0xFF);
+
+  if (!group.empty() || !keys.empty())
+  {
+    writeString(buf, group);
+    buf.push_back(static_cast<uint8_t>((keys.size() >> 8) & 0xFF));
+    buf.push_back(static_cast<uint8_t>(keys.size() & 0xFF));
+    for (const auto &key : keys)
+    {
+      writeString(buf, key);
+    }
+  }
+  return buf;
+}
+
+CreditMessage CreditMessage::decode(const uint8_t *data, size_t size)
+{
+  if (size < SIZE)
+  {
+    throw std::runtime_error("CreditMessage: data too short, expected 5 bytes");
+  }
+
+  CreditMessage msg;
+  msg.type = data[0];
+  msg.credits = (static_cast<uint32_t>(data[1]) << 24) |
+                (static_cast<uint32_t>(data[2]) << 16) |
+                (static_cast<uint32_t>(data[3]) << 8) | static_cast<uint32_t>(data[4]);
+
+  if (size > SIZE)
+  {
+    size_t offset = SIZE;
+    msg.group = readString(data, size, offset);
+    uint16_t key_count = readU16(data, size, offset);
+    for (uint16_t i = 0; i < key_count; ++i)
+    {
+      msg.keys.push_back(readString(data, size, offset));
+    }
+  }
+  return msg;
+}
+
+/* ================= CreditChannel ================= */
+
+CreditChannel::CreditChannel(const std::string &ip, const FlowControlOptions &options)
+    : options_(options)
+{
+  socket_ = ZMQContext::createSocket(zmq::socket_type::router);
+  // Report departed subscribers instead of silently dropping their messages
+  socket_->set(zmq::sockopt::router_mandatory, 1);
+  socket_->bind("tcp://" + ip + ":0");
+  port_ = getBoundPort(*socket_);
+}
+
+CreditChannel::~CreditChannel()
+{
+  ZMQContext::releaseSocket(socket_);
+}
+
+CreditChannel::Peer *CreditChannel::Target::pick()
+{
+  Peer *best = nullptr;
+  for (size_t n = 0; n < members.size(); ++n)
+  {
+    Peer &peer = members[(cursor + n) % members.size()];
+    if (!peer.alive || peer.credits == 0)
+      continue;
+
+    if (best == nullptr || peer.credits > best->credits)
+    {
+      best = &peer;
+    }
+  }
+  return best;
+}
+
+bool CreditChannel::Target::ready() const
+{
+  return std::any_of(members.begin(), members.end(),
+                     [](const Peer &p) { return p.alive && p.credits > 0; });
+}
+
+bool CreditChannel::Target::accepts(const std::string &key_frame) const
+{
+  if (key_frames.empty())
+  {
+    return true;
+  }
+  return std::find(key_frames.begin(), key_frames.end(), key_frame) !=
+         key_frames.end();
+}
+
+size_t CreditChannel::peerCount() const
+{
+  size_t count = 0;
+  for (const auto &target : targets_)
+  {
+    count += target.members.size();
+  }
+  return count;
+}
+
+size_t CreditChannel::groupCount() const
+{
+  return std::count_if(targets_.begin(), targets_.end(),
+                       [](const Target &t) { return !t.group.empty(); });
+}
+
+PublishStatus
+CreditChannel::send(const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+                    const uint8_t *payload, size_t size)
+{
+  return sendFrames(std::string(), header, payload, size);
+}
+
+PublishStatus
+CreditChannel::send(const std::string &key,
+                    const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+                    const uint8_t *payload, size_t size)
+{
+  return sendFrames(MessageKey::encode(key), header, payload, size);
+}
+
+PublishStatus
+CreditChannel::sendFrames(const std::string &key_frame,
+                          const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+                          const uint8_t *payload, size_t size)
+{
+  flush();
+
+  if (options_.policy == OverflowPolicy::Block && !canSendDirectly(key_frame))
+  {
+    auto deadline = std::chrono::steady_clock::now() + options_.block_timeout;
+    while (!canSendDirectly(key_frame))
+    {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline)
+      {
+        return PublishStatus::Timeout;
+      }
+      processControl(std::chrono::ceil<std::chrono::milliseconds>(deadline - now));
+      expirePeers(std::chrono::steady_clock::now());
+    }
+  }
+
+  if (canSendDirectly(key_frame))
+  {
+    for (auto &target : targets_)
+    {
+      ++target.next;
+      if (target.accepts(key_frame))
+      {
+        sendTo(target, key_frame, header, payload, size);
+      }
+    }
+    removeDead();
+    ++buffer_base_; // the message is never stored
+    return PublishStatus::Ok;
+  }
+
+  if (options_.policy != OverflowPolicy::Buffer ||
+      buffered_bytes_ + size > options_.max_buffered_bytes)
+  {
+    return PublishStatus::WouldBlock;
+  }
+
+  buffer_.push_back(
+      BufferedMessage{key_frame, header, Bytes(payload, payload + size)});
+  buffered_bytes_ += size;
+  flushBuffer();
+  return PublishStatus::Buffered;
+}
+
+void CreditChannel::flush()
+{
+  processControl(std::chrono::milliseconds(0));
+  expirePeers(std::chrono::steady_clock::now());
+  flushBuffer();
+}
+
+void CreditChannel::processControl(std::chrono::milliseconds timeout)
+{
+  zmq::pollitem_t item{socket_->handle(), 0, ZMQ_POLLIN, 0};
+  if (timeout.count() > 0 && zmq::poll(&item, 1, timeout) == 0)
+  {
+    return;
+  }
+
+  while (true)
+  {
+    zmq::message_t identity;
+    if (!socket_->recv(identity, zmq::recv_flags::dontwait))
+    {
+      break;
+    }
+    if (!identity.more())
+    {
+      continue;
+    }
+
+    zmq::message_t body;
+    if (!socket_->recv(body, zmq::recv_flags::none))
+    {
+      break;
+    }
+
+    CreditMessage msg;
+    try
+    {
+      msg = CreditMessage::decode(static_cast<const uint8_t *>(body.data()),
+                                  body.size());
+    }
+    catch (const std::exception &e)
+    {
+      zlc::warn("[CreditChannel] Invalid control message: {}", e.what());
+      continue;
+    }
+
+    std::string id(static_cast<const char *>(identity.data()), identity.size());
+    Peer *peer = findPeer(id);
+
+    if (msg.type == CreditMessage::Bye)
+    {
+      if (peer != nullptr)
+      {
+        peer->alive = false;
+      }
+      continue;
+    }
+
+    if (peer == nullptr && msg.type != CreditMessage::Hello)
+    {
+      requestRejoin(identity);
+      continue;
+    }
+
+    if (peer == nullptr)
+    {
+      // Join the member's group; a new target only receives messages
+      // published from now on
+      auto it = std::find_if(targets_.begin(), targets_.end(),
+                             [&msg](const Target &t)
+                             { return !msg.group.empty() && t.group == msg.group; });
+      if (it == targets_.end())
+      {
+        Target target;
+        target.group = msg.group;
+        for (const auto &key : msg.keys)
+        {
+          target.key_frames.push_back(MessageKey::encode(key));
+        }
+        target.next = buffer_base_ + buffer_.size();
+        targets_.push_back(std::move(target));
+        it = targets_.end() - 1;
+      }
+
+      it->members.push_back(Peer{id, 0, {}, true});
+      peer = &it->members.back();
+
+      if (msg.group.empty())
+      {
+        zlc::info("[CreditChannel] Flow-controlled subscriber joined on port {}",
+                  port_);
+      }
+      else
+      {
+        zlc::info("[CreditChannel] Member joined consumer group '{}' on port {}",
+                  msg.group, port_);
+      }
+    }
+
+    peer->credits += msg.credits;
+    peer->last_seen = std::chrono::steady_clock::now();
+  }
+
+  removeDead();
+}
+
+void CreditChannel::requestRejoin(zmq::message_t &identity)
+{
+  CreditMessage rejoin;
+  rejoin.type = CreditMessage::Rejoin;
+  Bytes bytes = rejoin.encode();
+
+  try
+  {
+    socket_->send(identity, zmq::send_flags::sndmore);
+    socket_->send(zmq::buffer(bytes), zmq::send_flags::none);
+  }
+  catch (const zmq::error_t &e)
+  {
+    if (e.num() != EHOSTUNREACH)
+    {
+      throw;
+    }
+    return; // already gone
+  }
+  zlc::info("[CreditChannel] Asked unknown subscriber on port {} to rejoin", port_);
+}
+
+CreditChannel::Peer *CreditChannel::findPeer(const std::string &identity)
+{
+  for (auto &target : targets_)
+  {
+    for (auto &peer : target.members)
+    {
+      if (peer.identity == identity)
+      {
+        return &peer;
+      }
+    }
+  }
+  return nullptr;
+}
+
+void CreditChannel::expirePeers(std::chrono::steady_clock::time_point now)
+{
+  size_t expired = 0;
+  for (auto &target : targets_)
+  {
+    for (auto &peer : target.members)
+    {
+      if (peer.alive && now - peer.last_seen > options_.peer_timeout)
+      {
+        peer.alive = false;
+        ++expired;
+      }
+    }
+  }
+
+  if (expired > 0)
+  {
+    zlc::warn("[CreditChannel] Dropped {} unresponsive subscriber(s) on port {}",
+              expired, port_);
+    removeDead();
+  }
+}
+
+void CreditChannel::removeDead()
+{
+  for (auto &target : targets_)
+  {
+    auto &members = target.members;
+    members.erase(std::remove_if(members.begin(), members.end(),
+                                 [](const Peer &p) { return !p.alive; }),
+                  members.end());
+  }
+  targets_.erase(std::remove_if(targets_.begin(), targets_.end(),
+                                [](const Target &t) { return t.members.empty(); }),
+                 targets_.end());
+}
+
+bool CreditChannel::canSendDirectly(const std::string &key_frame) const
+{
+  if (!buffer_.empty())
+  {
+    return false;
+  }
+  return std::all_of(targets_.begin(), targets_.end(),
+                     [&key_frame](const Target &target)
+                     { return !target.accepts(key_frame) || target.ready(); });
+}
+
+void CreditChannel::sendTo(Target &target, const std::string &key_frame,
+                           const std::array<uint8_t, MESSAGE_HEADER_SIZE> &header,
+                           const uint8_t *payload, size_t size)
+{
+  while (Peer *peer = target.pick())
+  {
+    // Ties go to the member after the last one served
+    target.cursor = static_cast<size_t>(peer - target.members.data()) + 1;
+    --peer->credits;
+    try
+    {
+      socket_->send(zmq::buffer(peer->identity), zmq::send_flags::sndmore);
+      if (!key_frame.empty())
+      {
+        socket_->send(zmq::buffer(key_frame), zmq::send_flags::sndmore);
+      }
+      socket_->send(zmq::buffer(header), zmq::send_flags::sndmore);
+      socket_->send(zmq::buffer(payload, size), zmq::send_flags::none);
+      return;
+    }
+    catch (const zmq::error_t &e)
+    {
+      if (e.num() != EHOSTUNREACH)
+      {
+        throw;
+      }
+    }
+
+    // Departed without BYE; another group member may take the message
+    zlc::warn("[CreditChannel] Subscriber disconnected from port {}", port_);
+    peer->alive = false;
+  }
+}
+
+void CreditChannel::flushBuffer()
+{
+  for (auto &target : targets_)
+  {
+    while (target.next < buffer_base_ + buffer_.size())
+    {
+      const BufferedMessage &msg = buffer_[target.next - buffer_base_];
+      if (!target.accepts(msg.key_frame))
+      {
+        ++target.next; // filtered out, costs no credit
+        continue;
+      }
+      if (!target.ready())
+      {
+        break;
+      }
+      ++target.next;
+      sendTo(target, msg.key_frame, msg.header, msg.payload.data(),
+             msg.payload.size());
+    }
+  }
+  removeDead();
+
+  // Drop messages every target has received
+  uint64_t delivered = buffer_base_ + buffer_.size();
+  for (const auto &target : targets_)
+  {
+    delivered = std::min(delivered, target.next);
+  }
+  while (buffer_base_ < delivered)
+  {
+    buffered_bytes_ -= buffer_.front().payload.size();
+    buffer_.pop_front();
+    ++buffer_base_;
+  }
+}
+
+} // namespace zlc
@@ -0,0 +1,158 @@
+#include "zerolancom/sockets/load_balancer.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace zlc
+{
+
+namespace
+{
+
+// FNV-1a, so that every process hashes a sticky key the same way
+uint64_t fnv1a(std::string_view data, uint64_t hash = 14695981039346656037ull)
+{
+  for (unsigned char c : data)
+  {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Final mix of splitmix64; spreads scores of similar urls apart
+uint64_t mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+} // namespace
+
+/* ================= EndpointLoad ================= */
+
+std::shared_ptr<EndpointLoad> EndpointLoad::of(const std::string &url)
+{
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::shared_ptr<EndpointLoad>> loads;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto &load = loads[url];
+  if (!load)
+  {
+    load = std::make_shared<EndpointLoad>();
+  }
+  return load;
+}
+
+void EndpointLoad::finish(std::chrono::nanoseconds latency)
+{
+  outstanding_.fetch_sub(1, std::memory_order_relaxed);
+
+  int64_t sample = latency.count();
+  int64_t current = latency_ns_.load(std::memory_order_relaxed);
+  int64_t next;
+  do
+  {
+    next = current == 0
+               ? sample
+               : static_cast<int64_t>(current + EWMA_ALPHA * (sample - current));
+  } while (
+      !latency_ns_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+/* ================= LoadBalancer ================= */
+
+LoadBalancer::LoadBalancer(LoadBalancing policy)
+    : policy_(policy), rng_(std::random_device{}())
+{
+}
+
+void LoadBalancer::setEndpoints(std::vector<std::string> urls)
+{
+  urls_ = std::move(urls);
+  loads_.clear();
+  for (const auto &url : urls_)
+  {
+    loads_.push_back(EndpointLoad::of(url));
+  }
+}
+
+size_t LoadBalancer::pick(std::string_view key)
+{
+  if (urls_.size() == 1)
+  {
+    return 0;
+  }
+
+  switch (policy_)
+  {
+  case LoadBalancing::RoundRobin:
+    return next_++ % urls_.size();
+  case LoadBalancing::LeastOutstanding:
+    return pickLeastOutstanding();
+  case LoadBalancing::PowerOfTwoChoices:
+    return pickPowerOfTwo();
+  case LoadBalancing::StickyKey:
+    return pickSticky(key);
+  }
+  return 0;
+}
+
+size_t LoadBalancer::pickLeastOutstanding()
+{
+  // Start the scan one past the last pick, so ties rotate
+  const size_t start = next_++;
+  size_t best = start % urls_.size();
+  for (size_t i = 1; i < urls_.size(); ++i)
+  {
+    size_t index = (start + i) % urls_.size();
+    if (loads_[index]->outstanding() < loads_[best]->outstanding())
+    {
+      best = index;
+    }
+  }
+  return best;
+}
+
+size_t LoadBalancer::pickPowerOfTwo()
+{
+  std::uniform_int_distribution<size_t> dist(0, urls_.size() - 1);
+  size_t a = dist(rng_);
+  size_t b = dist(rng_);
+  while (b == a)
+  {
+    b = dist(rng_);
+  }
+
+  // Expected wait: latency estimate scaled by the calls queued ahead
+  auto cost = [this](size_t index)
+  {
+    const EndpointLoad &load = *loads_[index];
+    return static_cast<double>(load.latency().count()) * (load.outstanding() + 1);
+  };
+  return cost(b) < cost(a) ? b : a;
+}
+
+size_t LoadBalancer::pickSticky(std::string_view key) const
+{
+  const uint64_t key_hash = fnv1a(key);
+  size_t best = 0;
+  uint64_t best_score = 0;
+  for (size_t i = 0; i < urls_.size(); ++i)
+  {
+    uint64_t score = mix(fnv1a(urls_[i], key_hash));
+    if (i == 0 || score > best_score)
+    {
+      best = i;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+} // namespace zlc
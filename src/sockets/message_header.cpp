@@ -0,0 +1,96 @@
+#include "zerolancom/sockets/message_header.hpp"
+
+#include <stdexcept>
+
+namespace zlc
+{
+
+namespace
+{
+
+void writeU64(uint8_t *out, uint64_t value)
+{
+  for (int i = 7; i >= 0; --i)
+  {
+    out[i] = static_cast<uint8_t>(value & 0xFF);
+    value >>= 8;
+  }
+}
+
+uint64_t readU64(const uint8_t *data)
+{
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+} // namespace
+
+std::array<uint8_t, MESSAGE_HEADER_SIZE> MessageHeader::encode() const
+{
+  std::array<uint8_t, MESSAGE_HEADER_SIZE> buf{};
+  buf[0] = version;
+  buf[1] = flags;
+  writeU64(buf.data() + 2, sequence);
+  writeU64(buf.data() + 10, static_cast<uint64_t>(stamp_ns));
+  return buf;
+}
+
+MessageHeader MessageHeader::decode(const uint8_t *data, size_t size)
+{
+  if (size < MESSAGE_HEADER_SIZE)
+  {
+    throw std::runtime_error("MessageHeader: data too short, expected 18 bytes");
+  }
+
+  MessageHeader header;
+  header.version = data[0];
+  header.flags = data[1];
+  header.sequence = readU64(data + 2);
+  header.stamp_ns = static_cast<int64_t>(readU64(data + 10));
+  return header;
+}
+
+MessageHeader MessageHeader::legacy()
+{
+  MessageHeader header;
+  header.version = 0;
+  header.stamp_ns = now();
+  return header;
+}
+
+int64_t MessageHeader::now()
+{
+  return toStamp(std::chrono::system_clock::now());
+}
+
+int64_t MessageHeader::toStamp(std::chrono::system_clock::time_point time)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch())
+      .count();
+}
+
+std::string MessageKey::encode(const std::string &key)
+{
+  std::string frame;
+  frame.reserve(key.size() + 2);
+  frame.push_back(static_cast<char>(MESSAGE_KEY_MARKER));
+  frame.append(key);
+  frame.push_back('\0');
+  return frame;
+}
+
+bool MessageKey::isKeyFrame(const uint8_t *data, size_t size)
+{
+  return size >= 2 && data[0] == MESSAGE_KEY_MARKER && data[size - 1] == 0;
+}
+
+std::string MessageKey::decode(const uint8_t *data, size_t size)
+{
+  return std::string(reinterpret_cast<const char *>(data) + 1, size - 2);
+}
+
+} // namespace zlc
@@ -1,17 +1,195 @@
 #include "zerolancom/sockets/service_manager.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
 #include "zerolancom/utils/exception.hpp"
 
 namespace zlc
 {
 
-ServiceManager::ServiceManager(const std::string &ip)
+/* ================= ServiceReplyQueue ================= */
+
+void ServiceReplyQueue::push(ServiceReply reply)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    replies_.push_back(std::move(reply));
+  }
+  wakeup_.trigger();
+}
+
+std::vector<ServiceReply> ServiceReplyQueue::take()
+{
+  // Reset before taking the queue so that a later trigger is not lost
+  wakeup_.reset();
+
+  std::vector<ServiceReply> replies;
+  std::lock_guard<std::mutex> lock(mutex_);
+  replies.swap(replies_);
+  return replies;
+}
+
+/* ================= ServiceResponder ================= */
+
+bool ServiceResponder::reply(Bytes payload)
+{
+  return send(Response(std::string(ResponseStatus::SUCCESS), std::move(payload)));
+}
+
+bool ServiceResponder::fail(std::string_view code)
+{
+  return send(Response(std::string(code)));
+}
+
+bool ServiceResponder::done() const
+{
+  return !state_ || state_->done.load(std::memory_order_acquire);
+}
+
+bool ServiceResponder::send(Response response)
+{
+  if (!state_ || state_->done.exchange(true))
+  {
+    return false;
+  }
+  state_->queue->push(ServiceReply{std::move(state_->route), state_->service_name,
+                                   std::move(response), false, state_->compact});
+  return true;
+}
+
+/* ================= ServiceStreamWriter ================= */
+
+namespace
+{
+
+std::vector<zmq::message_t> copyRoute(const std::vector<zmq::message_t> &route)
+{
+  std::vector<zmq::message_t> copy;
+  copy.reserve(route.size());
+  for (const auto &frame : route)
+  {
+    copy.emplace_back(frame.data(), frame.size());
+  }
+  return copy;
+}
+
+// Message with the encoded bytes of `buffer`, taking its memory over unless
+// copying is cheaper
+zmq::message_t toMessage(ByteBuffer &buffer)
+{
+  if (buffer.size == 0)
+  {
+    return zmq::message_t();
+  }
+  if (buffer.size < ServiceManager::ZERO_COPY_THRESHOLD)
+  {
+    return zmq::message_t(buffer.data, buffer.size);
+  }
+  size_t size = buffer.size;
+  return zmq::message_t(
+      buffer.release(), size, [](void *data, void *) { std::free(data); }, nullptr);
+}
+
+// Identifies a request by its envelope (peer identity and request id)
+std::string routeKey(const std::vector<zmq::message_t> &route)
+{
+  std::string key;
+  for (const auto &frame : route)
+  {
+    key.push_back(static_cast<char>(frame.size()));
+    key.append(static_cast<const char *>(frame.data()), frame.size());
+  }
+  return key;
+}
+
+} // namespace
+
+void ServiceStreamWriter::State::grant(uint32_t amount)
 {
-  res_socket_ = ZMQContext::createSocket(zmq::socket_type::rep);
-  res_socket_->set(zmq::sockopt::rcvtimeo, SOCKET_TIMEOUT_MS);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (amount == 0)
+    {
+      cancelled = true;
+    }
+    credit += amount;
+  }
+  credit_changed.notify_all();
+}
+
+bool ServiceStreamWriter::write(Bytes payload)
+{
+  State &state = *state_;
+  {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    if (!state.credit_changed.wait_for(lock, state.idle_timeout,
+                                       [&state]()
+                                       { return state.credit > 0 || state.cancelled; }))
+    {
+      zlc::warn("[ServiceManager] Stream of '{}' got no credit in time",
+                state.service_name);
+      state.cancelled = true;
+      state.timed_out = true;
+      return false;
+    }
+    if (state.cancelled)
+    {
+      return false;
+    }
+    --state.credit;
+  }
+
+  state.queue->push(ServiceReply{
+      copyRoute(state.route), state.service_name,
+      Response(std::string(ResponseStatus::STREAM_ITEM), std::move(payload)), true,
+      state.compact});
+  return true;
+}
+
+bool ServiceStreamWriter::cancelled() const
+{
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->cancelled;
+}
+
+/* ================= ServiceManager ================= */
+
+namespace
+{
+
+// Deadline of the request the current worker is running
+thread_local std::chrono::steady_clock::time_point t_request_deadline =
+    std::chrono::steady_clock::time_point::max();
+
+struct DeadlineScope
+{
+  explicit DeadlineScope(std::chrono::steady_clock::time_point deadline)
+  {
+    t_request_deadline = deadline;
+  }
+  ~DeadlineScope()
+  {
+    t_request_deadline = std::chrono::steady_clock::time_point::max();
+  }
+};
+
+} // namespace
+
+std::chrono::steady_clock::time_point ServiceManager::requestDeadline()
+{
+  return t_request_deadline;
+}
+
+ServiceManager::ServiceManager(const std::string &ip, size_t workers)
+    : workers_(std::make_unique<ThreadPool>(workers))
+{
+  res_socket_ = ZMQContext::createSocket(zmq::socket_type::router);
   res_socket_->bind("tcp://" + ip + ":0");
   service_port = getBoundPort(*res_socket_);
 
-  zlc::info("[ServiceManager] ServiceManager bound to port {}", service_port);
+  zlc::info("[ServiceManager] ServiceManager bound to port {} ({} workers)",
+            service_port, workers_->size());
 }
 
 ServiceManager::~ServiceManager()
@@ -21,9 +199,12 @@ ServiceManager::~ServiceManager()
 
 void ServiceManager::start()
 {
-  poll_task_ =
-      std::make_unique<PeriodicTask>([this]() { this->pollOnce(); }, 100,
-                                     ThreadPool::instance()); // Poll every 100ms
+  workers_->start();
+  stopping_ = false;
+
+  // zmq::poll blocks until there is work, so no extra delay is needed
+  poll_task_ = std::make_unique<PeriodicTask>([this]() { this->pollOnce(); }, 0,
+                                              ThreadPool::instance());
 
   poll_task_->start();
 }
@@ -32,40 +213,153 @@ void ServiceManager::stop()
 {
   if (poll_task_)
   {
+    stopping_ = true;
+    replies_->wakeup().trigger();
     poll_task_->stop();
   }
+  // Streams waiting for credit would hold their workers until they time out
+  for (auto &[key, stream] : streams_)
+  {
+    stream->grant(0);
+  }
+  streams_.clear();
+  // Lets running handlers finish; their replies are no longer sent
+  workers_->stop();
 }
 
-void ServiceManager::handleRequest(const std::string &service_name,
-                                   const ByteView &payload, Response &response)
+void ServiceManager::addHandler(const std::string &name, ServiceCallback callback)
+{
+  auto handler = std::make_shared<Handler>();
+  handler->callback = std::move(callback);
+  installHandler(name, std::move(handler));
+}
+
+void ServiceManager::registerDeferredHandler(const std::string &name,
+                                             DeferredServiceCallback callback,
+                                             std::chrono::milliseconds timeout)
 {
-  auto it = handlers_.find(service_name);
+  auto handler = std::make_shared<Handler>();
+  handler->deferred = std::move(callback);
+  handler->timeout = timeout;
+  installHandler(name, std::move(handler));
+}
 
-  zlc::info("[ServiceManager] Handling request for service '{}'", service_name);
+void ServiceManager::registerRawStreamHandler(const std::string &name,
+                                              StreamServiceCallback callback)
+{
+  auto handler = std::make_shared<Handler>();
+  handler->stream = std::move(callback);
+  installHandler(name, std::move(handler));
+}
 
-  if (it == handlers_.end())
+void ServiceManager::registerRawBatchHandler(const std::string &name,
+                                             BatchServiceCallback callback,
+                                             const BatchOptions &options)
+{
+  auto handler = std::make_shared<Handler>();
+  handler->batch = std::move(callback);
+  handler->batch_options = options;
+  handler->batch_options.max_batch_size = std::max<size_t>(1, options.max_batch_size);
+  installHandler(name, std::move(handler));
+}
+
+void ServiceManager::installHandler(const std::string &name,
+                                    std::shared_ptr<Handler> handler)
+{
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
+  handlers_[name] = std::move(handler);
+  auto &counters = counters_[name];
+  if (!counters)
+  {
+    counters = std::make_shared<ServiceCounters>();
+  }
+  auto [it, inserted] = service_ids_.try_emplace(name, 0);
+  if (inserted)
   {
+    it->second = static_cast<uint32_t>(service_ids_.size());
+    service_names_[it->second] = name;
+  }
+}
+
+uint32_t ServiceManager::serviceId(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
+  auto it = service_ids_.find(name);
+  return it == service_ids_.end() ? 0 : it->second;
+}
+
+std::string ServiceManager::serviceName(uint32_t id)
+{
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
+  auto it = service_names_.find(id);
+  return it == service_names_.end() ? std::string() : it->second;
+}
+
+std::shared_ptr<const ServiceManager::Handler>
+ServiceManager::findHandler(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
+  auto it = handlers_.find(name);
+  return it == handlers_.end() ? nullptr : it->second;
+}
+
+void ServiceManager::handleRequest(const std::string &service_name,
+                                   const ByteView &payload, Response &response)
+{
+  std::shared_ptr<const Handler> handler = findHandler(service_name);
+  if (!handler)
+  {
+    zlc::info("[ServiceManager] Request for unknown service '{}'", service_name);
     response.code = ResponseStatus::NOSERVICE;
     return;
   }
+  if (handler->deferred || handler->stream)
+  {
+    zlc::error("[ServiceManager] Service '{}' is deferred or streamed and cannot "
+               "be called synchronously",
+               service_name);
+    response.code = ResponseStatus::SERVICE_FAIL;
+    return;
+  }
+  if (handler->batch)
+  {
+    // A batch of one
+    std::vector<Response> responses(1);
+    invokeBatch(*handler, service_name, {payload}, responses);
+    response = std::move(responses[0]);
+    return;
+  }
+  ByteBuffer out;
+  invoke(*handler, service_name, payload, response, out);
+  if (response.code == ResponseStatus::SUCCESS)
+  {
+    response.payload.assign(out.data, out.data + out.size);
+  }
+}
+
+void ServiceManager::invoke(const Handler &handler, const std::string &service_name,
+                            const ByteView &payload, Response &response,
+                            ByteBuffer &out)
+{
+  zlc::info("[ServiceManager] Handling request for service '{}'", service_name);
 
   response.code = ResponseStatus::SUCCESS;
 
   try
   {
-    response.payload = it->second(payload);
+    handler.callback(payload, out);
   }
   catch (const DecodeException &e)
   {
-    zlc::error("[ServiceManager] ZMQ error while handling service '{}': {}",
+    zlc::error("[ServiceManager] Failed to decode request for service '{}': {}",
                service_name, e.what());
-    response.code = ResponseStatus::INVALID_RESPONSE;
+    response.code = ResponseStatus::INVALID_REQUEST;
   }
   catch (const EncodeException &e)
   {
-    zlc::error("[ServiceManager] ZMQ error while handling service '{}': {}",
+    zlc::error("[ServiceManager] Failed to encode response of service '{}': {}",
                service_name, e.what());
-    response.code = ResponseStatus::INVALID_REQUEST;
+    response.code = ResponseStatus::INVALID_RESPONSE;
   }
   catch (const std::exception &e)
   {
@@ -75,66 +369,963 @@ void ServiceManager::handleRequest(const std::string &service_name,
   }
 }
 
+void ServiceManager::invokeBatch(const Handler &handler,
+                                 const std::string &service_name,
+                                 const std::vector<ByteView> &payloads,
+                                 std::vector<Response> &responses)
+{
+  zlc::info("[ServiceManager] Handling batch of {} requests for service '{}'",
+            payloads.size(), service_name);
+
+  // A failure of the whole call fails every request of the batch
+  auto failAll = [&responses](std::string_view code)
+  {
+    for (auto &response : responses)
+    {
+      response = Response(std::string(code));
+    }
+  };
+
+  try
+  {
+    handler.batch(payloads, responses);
+  }
+  catch (const DecodeException &e)
+  {
+    zlc::error("[ServiceManager] Failed to decode batch for service '{}': {}",
+               service_name, e.what());
+    failAll(ResponseStatus::INVALID_REQUEST);
+  }
+  catch (const EncodeException &e)
+  {
+    zlc::error("[ServiceManager] Failed to encode batch of service '{}': {}",
+               service_name, e.what());
+    failAll(ResponseStatus::INVALID_RESPONSE);
+  }
+  catch (const std::exception &e)
+  {
+    zlc::error("[ServiceManager] Exception while handling batch of service '{}': {}",
+               service_name, e.what());
+    failAll(ResponseStatus::SERVICE_FAIL);
+  }
+}
+
 void ServiceManager::clearHandlers()
 {
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
   handlers_.clear();
 }
 
 void ServiceManager::removeHandler(const std::string &name)
 {
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
   handlers_.erase(name);
 }
 
+void ServiceManager::setConcurrencyLimit(const std::string &name,
+                                         size_t max_concurrent)
+{
+  AdmissionOptions options;
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    auto it = admission_.find(name);
+    if (it != admission_.end())
+    {
+      options = it->second;
+    }
+  }
+  options.max_in_flight = max_concurrent;
+  setAdmission(name, options);
+}
+
+void ServiceManager::setAdmission(const std::string &name,
+                                  const AdmissionOptions &options)
+{
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
+  if (options.max_in_flight == 0 && options.max_queued == 0 &&
+      options.max_queue_time.count() <= 0)
+  {
+    admission_.erase(name);
+  }
+  else
+  {
+    admission_[name] = options;
+  }
+}
+
+ServiceStatistics ServiceManager::serviceStatistics(const std::string &name)
+{
+  std::shared_ptr<ServiceCounters> counters;
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    auto it = counters_.find(name);
+    if (it != counters_.end())
+    {
+      counters = it->second;
+    }
+  }
+
+  ServiceStatistics stats;
+  if (!counters)
+  {
+    return stats;
+  }
+  stats.accepted = counters->accepted.load(std::memory_order_relaxed);
+  stats.shed = counters->shed.load(std::memory_order_relaxed);
+  stats.queued = static_cast<size_t>(
+      std::max<int64_t>(0, counters->queued.load(std::memory_order_relaxed)));
+  stats.in_flight = static_cast<size_t>(
+      std::max<int64_t>(0, counters->in_flight.load(std::memory_order_relaxed)));
+  stats.queue_time_p50 = counters->queue_time.percentile(0.5);
+  stats.queue_time_p90 = counters->queue_time.percentile(0.9);
+  stats.queue_time_p99 = counters->queue_time.percentile(0.99);
+  return stats;
+}
+
+void ServiceManager::setIdempotent(const std::string &name,
+                                   std::optional<ResponseCacheOptions> options)
+{
+  std::lock_guard<std::mutex> lock(handlers_mutex_);
+  if (options)
+  {
+    idempotent_[name] = *options;
+  }
+  else
+  {
+    idempotent_.erase(name);
+  }
+}
+
 void ServiceManager::pollOnce()
 {
+  if (stopping_)
+  {
+    return;
+  }
+
   try
   {
-    zmq::message_t service_name_msg;
+    // Wake up for the earliest deferred deadline, batch flush or queue time
+    // limit, if any
+    auto now = std::chrono::steady_clock::now();
+    auto wake_at = std::min(flushBatches(now), shedWaiting(now));
+    if (!deadlines_.empty())
+    {
+      wake_at = std::min(wake_at, deadlines_.top().first);
+    }
+    auto timeout = std::chrono::milliseconds(-1);
+    if (wake_at != std::chrono::steady_clock::time_point::max())
+    {
+      timeout = std::max(std::chrono::milliseconds(0),
+                         std::chrono::ceil<std::chrono::milliseconds>(wake_at - now));
+    }
+
+    zmq::pollitem_t items[] = {{res_socket_->handle(), 0, ZMQ_POLLIN, 0},
+                               {nullptr, replies_->wakeup().fd(), ZMQ_POLLIN, 0}};
+    zmq::poll(items, 2, timeout);
 
-    if (!res_socket_->recv(service_name_msg, zmq::recv_flags::none))
+    if (items[1].revents & ZMQ_POLLIN)
+    {
+      sendReplies();
+    }
+    if (items[0].revents & ZMQ_POLLIN)
     {
+      receiveRequests();
+    }
+    expireDeferred(std::chrono::steady_clock::now());
+  }
+  catch (const zmq::error_t &e)
+  {
+    if (e.num() == ETERM)
+    {
+      // The loop has no interval, so rerunning it would spin until stop()
+      zlc::info("[ServiceManager] Context terminated during poll");
+      poll_task_->cancel();
       return;
     }
+    zlc::error("[ServiceManager] ZMQ error: {}", e.what());
+  }
+}
+
+void ServiceManager::receiveRequests()
+{
+  while (true)
+  {
+    auto job = std::make_shared<Job>();
 
-    std::string service_name = decodeServiceHeader(
-        ByteView{static_cast<const uint8_t *>(service_name_msg.data()),
-                 service_name_msg.size()});
+    // Envelope: peer identity (plus any proxy hops) up to the empty delimiter
+    zmq::message_t frame;
+    if (!res_socket_->recv(frame, zmq::recv_flags::dontwait))
+    {
+      return;
+    }
+    while (frame.size() != 0 && frame.more())
+    {
+      job->route.push_back(std::move(frame));
+      res_socket_->recv(frame, zmq::recv_flags::none);
+    }
+    if (frame.size() != 0 || !frame.more() || job->route.empty())
+    {
+      zlc::warn("[ServiceManager] Dropping request without envelope");
+      while (frame.more())
+      {
+        res_socket_->recv(frame, zmq::recv_flags::none);
+      }
+      continue;
+    }
+    job->route.push_back(std::move(frame));
+
+    zmq::message_t service_name_msg;
+    res_socket_->recv(service_name_msg, zmq::recv_flags::none);
+    uint8_t flags = 0;
+    try
+    {
+      ByteView header{static_cast<const uint8_t *>(service_name_msg.data()),
+                      service_name_msg.size()};
+      if (uint32_t id = decodeServiceId(header))
+      {
+        job->compact = true;
+        job->service_name = serviceName(id);
+      }
+      else
+      {
+        job->service_name = decodeServiceHeader(header);
+      }
+      if (uint32_t budget = decodeServiceBudget(header))
+      {
+        job->budget = std::chrono::milliseconds(budget);
+        job->deadline = std::chrono::steady_clock::now() + job->budget;
+      }
+      flags = decodeServiceFlags(header);
+    }
+    catch (const DecodeException &e)
+    {
+      zlc::warn("[ServiceManager] Invalid service header: {}", e.what());
+      if (service_name_msg.more())
+      {
+        do
+        {
+          res_socket_->recv(frame, zmq::recv_flags::none);
+        } while (frame.more());
+      }
+      sendResponse(job->route, Response(std::string(ResponseStatus::INVALID_REQUEST)),
+                   false);
+      continue;
+    }
 
     if (!service_name_msg.more())
     {
       zlc::warn("[ServiceManager] Missing payload frame");
-      return;
+      sendResponse(job->route, Response(std::string(ResponseStatus::INVALID_REQUEST)),
+                   job->compact);
+      continue;
+    }
+
+    res_socket_->recv(job->payload, zmq::recv_flags::none);
+
+    if (job->payload.more())
+    {
+      zlc::warn("[ServiceManager] Extra frames received");
+      zmq::message_t extra;
+      do
+      {
+        res_socket_->recv(extra, zmq::recv_flags::none);
+      } while (extra.more());
+    }
+
+    if (job->service_name == STREAM_CREDIT_SERVICE)
+    {
+      grantCredit(job->route, job->payload);
+      continue;
+    }
+    if (flags & SERVICE_FLAG_ONE_WAY)
+    {
+      std::shared_ptr<const Handler> handler = findHandler(job->service_name);
+      if (handler && handler->stream)
+      {
+        zlc::warn("[ServiceManager] Dropping one-way request to stream service '{}'",
+                  job->service_name);
+        continue;
+      }
+      // Nobody waits for the reply, so there is nowhere to send it
+      job->route.clear();
+      one_way_.fetch_add(1, std::memory_order_relaxed);
+      if (admit(job))
+      {
+        dispatch(std::move(job));
+      }
+      continue;
+    }
+    // Requests answered from the cache take no capacity
+    if (!coalesce(job) && admit(job))
+    {
+      dispatch(std::move(job));
+    }
+  }
+}
+
+bool ServiceManager::coalesce(const std::shared_ptr<Job> &job)
+{
+  std::optional<ResponseCacheOptions> options;
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    auto it = idempotent_.find(job->service_name);
+    if (it != idempotent_.end())
+    {
+      options = it->second;
+    }
+  }
+  if (!options)
+  {
+    if (!caches_.empty())
+    {
+      caches_.erase(job->service_name); // no longer idempotent
+    }
+    return false;
+  }
+  std::shared_ptr<const Handler> handler = findHandler(job->service_name);
+  if (handler && handler->stream)
+  {
+    return false;
+  }
+
+  ResponseCache &cache = caches_[job->service_name];
+  std::string_view request(static_cast<const char *>(job->payload.data()),
+                           job->payload.size());
+  const uint64_t key = std::hash<std::string_view>()(request);
+
+  auto hit = cache.entries.find(key);
+  if (hit != cache.entries.end() && hit->second.request == request)
+  {
+    if (std::chrono::steady_clock::now() < hit->second.expires)
+    {
+      cache_hits_.fetch_add(1, std::memory_order_relaxed);
+      zmq::message_t payload;
+      payload.copy(hit->second.payload);
+      sendResponse(job->route, Response(hit->second.code), job->compact,
+                   std::move(payload));
+      return true;
+    }
+    cache.erase(hit);
+  }
+
+  auto flight = cache.in_flight.find(key);
+  if (flight != cache.in_flight.end())
+  {
+    if (flight->second.request != request)
+    {
+      return false; // hash collision; runs on its own
+    }
+    coalesced_.fetch_add(1, std::memory_order_relaxed);
+    flight->second.followers.push_back(Follower{std::move(job->route), job->compact});
+    return true;
+  }
+
+  // First of its kind: runs, and identical requests wait for it
+  leaders_[routeKey(job->route)] = {job->service_name, key};
+  cache.in_flight.emplace(key, ResponseCache::Flight{std::string(request), {}});
+  return false;
+}
+
+void ServiceManager::ResponseCache::erase(
+    std::unordered_map<uint64_t, Entry>::iterator entry)
+{
+  bytes -= entry->second.request.size() + entry->second.payload.size();
+  order.erase(entry->second.order);
+  entries.erase(entry);
+}
+
+void ServiceManager::finishFlight(ServiceReply &reply)
+{
+  auto leader = leaders_.find(routeKey(reply.route));
+  if (leader == leaders_.end())
+  {
+    return;
+  }
+  auto [service_name, key] = std::move(leader->second);
+  leaders_.erase(leader);
+
+  auto cache_it = caches_.find(service_name);
+  if (cache_it == caches_.end())
+  {
+    return; // unmarked meanwhile
+  }
+  ResponseCache &cache = cache_it->second;
+  auto flight = cache.in_flight.find(key);
+  if (flight == cache.in_flight.end())
+  {
+    return;
+  }
+  ResponseCache::Flight finished = std::move(flight->second);
+  cache.in_flight.erase(flight);
+
+  // One message shared by every caller and the cache
+  if (reply.body.size() == 0)
+  {
+    reply.body = zmq::message_t(reply.response.payload.data(),
+                                reply.response.payload.size());
+  }
+  for (auto &follower : finished.followers)
+  {
+    zmq::message_t payload;
+    payload.copy(reply.body);
+    sendResponse(follower.route, Response(reply.response.code), follower.compact,
+                 std::move(payload));
+  }
+
+  std::optional<ResponseCacheOptions> options;
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    auto it = idempotent_.find(service_name);
+    if (it != idempotent_.end())
+    {
+      options = it->second;
+    }
+  }
+  const size_t size = finished.request.size() + reply.body.size();
+  if (!options || options->ttl.count() <= 0 || size > options->max_bytes ||
+      reply.response.code != ResponseStatus::SUCCESS)
+  {
+    return;
+  }
+
+  // Entries share one TTL, so the expired ones are the oldest
+  const auto now = std::chrono::steady_clock::now();
+  while (!cache.order.empty())
+  {
+    auto oldest = cache.entries.find(cache.order.front());
+    if (oldest->second.expires > now && cache.bytes + size <= options->max_bytes)
+    {
+      break;
     }
+    cache.erase(oldest);
+  }
+  auto [entry, inserted] = cache.entries.try_emplace(key);
+  if (!inserted)
+  {
+    return; // cached meanwhile, or a colliding request holds the slot
+  }
+  entry->second.request = std::move(finished.request);
+  entry->second.code = reply.response.code;
+  entry->second.payload.copy(reply.body);
+  entry->second.expires = now + options->ttl;
+  entry->second.order = cache.order.insert(cache.order.end(), key);
+  cache.bytes += size;
+}
 
-    zmq::message_t payload_msg;
-    if (!res_socket_->recv(payload_msg, zmq::recv_flags::none))
+bool ServiceManager::admit(const std::shared_ptr<Job> &job)
+{
+  AdmissionOptions options;
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    auto counters = counters_.find(job->service_name);
+    if (counters == counters_.end())
     {
+      return true; // unknown service; answered with NOSERVICE
+    }
+    job->counters = counters->second;
+    auto it = admission_.find(job->service_name);
+    if (it != admission_.end())
+    {
+      options = it->second;
+    }
+  }
+
+  ServiceCounters &counters = *job->counters;
+  if (options.max_queued > 0 && counters.queued.load(std::memory_order_relaxed) >=
+                                    static_cast<int64_t>(options.max_queued))
+  {
+    counters.shed.fetch_add(1, std::memory_order_relaxed);
+    reject(job, ResponseStatus::OVERLOADED);
+    return false;
+  }
+  job->max_queue_time = options.max_queue_time;
+  counters.queued.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void ServiceManager::reject(const std::shared_ptr<Job> &job, std::string_view code)
+{
+  ServiceReply reply{std::move(job->route), job->service_name,
+                     Response(std::string(code)), false, job->compact};
+  // Also answers the callers waiting for the same response
+  if (!leaders_.empty())
+  {
+    finishFlight(reply);
+  }
+  sendResponse(reply.route, reply.response, reply.compact);
+}
+
+std::chrono::steady_clock::time_point
+ServiceManager::shedWaiting(std::chrono::steady_clock::time_point now)
+{
+  auto wake_at = std::chrono::steady_clock::time_point::max();
+  for (auto &[name, slot] : slots_)
+  {
+    // Oldest first, so only the front can be due
+    while (!slot.waiting.empty() && slot.waiting.front()->max_queue_time.count() > 0)
+    {
+      std::shared_ptr<Job> job = slot.waiting.front();
+      auto due = job->received + job->max_queue_time;
+      if (due > now)
+      {
+        wake_at = std::min(wake_at, due);
+        break;
+      }
+      slot.waiting.pop_front();
+
+      ServiceCounters &counters = *job->counters;
+      counters.queued.fetch_sub(1, std::memory_order_relaxed);
+      counters.shed.fetch_add(1, std::memory_order_relaxed);
+      counters.queue_time.record(now - job->received);
+      reject(job, ResponseStatus::OVERLOADED);
+    }
+  }
+  return wake_at;
+}
+
+std::string_view ServiceManager::startJob(Job &job,
+                                          std::chrono::steady_clock::time_point now)
+{
+  bool shed = false;
+  if (job.counters)
+  {
+    ServiceCounters &counters = *job.counters;
+    const auto waited = now - job.received;
+    counters.queued.fetch_sub(1, std::memory_order_relaxed);
+    counters.in_flight.fetch_add(1, std::memory_order_relaxed);
+    counters.queue_time.record(waited);
+    shed = job.max_queue_time.count() > 0 && waited > job.max_queue_time;
+  }
+
+  if (now >= job.deadline)
+  {
+    expired_.fetch_add(1, std::memory_order_relaxed);
+    return ResponseStatus::SERVICE_TIMEOUT;
+  }
+  if (shed)
+  {
+    job.counters->shed.fetch_add(1, std::memory_order_relaxed);
+    return ResponseStatus::OVERLOADED;
+  }
+  if (job.counters)
+  {
+    job.counters->accepted.fetch_add(1, std::memory_order_relaxed);
+  }
+  return {};
+}
+
+void ServiceManager::dispatch(std::shared_ptr<Job> job)
+{
+  size_t limit = 0;
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    auto it = admission_.find(job->service_name);
+    if (it != admission_.end())
+    {
+      limit = it->second.max_in_flight;
+    }
+  }
+
+  Slot &slot = slots_[job->service_name];
+  if (!slot.counters)
+  {
+    slot.counters = job->counters;
+  }
+  if (limit > 0 && slot.running >= limit)
+  {
+    slot.waiting.push_back(std::move(job));
+    return;
+  }
+
+  ++slot.running;
+
+  // Resolved when the request starts, so waiting requests see new handlers
+  job->handler = findHandler(job->service_name);
+  if (job->handler && job->handler->deferred)
+  {
+    auto answer = std::make_shared<ServiceResponder::State>();
+    answer->queue = replies_;
+    answer->route = std::move(job->route);
+    answer->service_name = job->service_name;
+    answer->compact = job->compact;
+    // The caller stops waiting at its own deadline
+    auto timeout = std::chrono::steady_clock::now() + job->handler->timeout;
+    deadlines_.emplace(std::min(timeout, job->deadline), answer);
+    job->answer = std::move(answer);
+  }
+  else if (job->handler && job->handler->stream)
+  {
+    auto stream = std::make_shared<ServiceStreamWriter::State>();
+    stream->queue = replies_;
+    stream->route = std::move(job->route);
+    stream->service_name = job->service_name;
+    stream->compact = job->compact;
+    if (job->budget.count() > 0)
+    {
+      stream->idle_timeout = job->budget;
+    }
+    streams_[routeKey(stream->route)] = stream;
+    job->stream = std::move(stream);
+  }
+  else if (job->handler && job->handler->batch)
+  {
+    enqueueBatch(std::move(job));
+    return;
+  }
+
+  workers_->enqueue([this, job]() { runJob(job); });
+}
+
+void ServiceManager::runJob(const std::shared_ptr<Job> &job)
+{
+  ByteView payload{static_cast<const uint8_t *>(job->payload.data()),
+                   job->payload.size()};
+
+  // Skip work for callers that have already given up, e.g. after waiting
+  // behind a concurrency limit, and for requests that waited too long
+  std::string_view rejected = startJob(*job, std::chrono::steady_clock::now());
+  if (!rejected.empty())
+  {
+    if (rejected == ResponseStatus::SERVICE_TIMEOUT)
+    {
+      zlc::warn("[ServiceManager] Skipping request for '{}': caller deadline passed",
+                job->service_name);
+    }
+    if (job->answer)
+    {
+      ServiceResponder(job->answer).fail(rejected);
       return;
     }
+    if (job->stream)
+    {
+      job->route = std::move(job->stream->route);
+    }
+    ServiceReply reply{std::move(job->route), std::move(job->service_name),
+                       Response(std::string(rejected)), false, job->compact};
+    replies_->push(std::move(reply));
+    return;
+  }
+  DeadlineScope scope(job->deadline);
 
-    ByteView payload{static_cast<const uint8_t *>(payload_msg.data()),
-                     payload_msg.size()};
+  if (job->stream)
+  {
+    runStream(job, payload);
+    return;
+  }
 
-    if (payload_msg.more())
+  if (job->answer)
+  {
+    ServiceResponder responder(job->answer);
+    try
     {
-      zlc::warn("[ServiceManager] Extra frames received");
+      job->handler->deferred(payload, responder);
+    }
+    catch (const DecodeException &e)
+    {
+      zlc::error("[ServiceManager] Failed to decode request for service '{}': {}",
+                 job->service_name, e.what());
+      responder.fail(ResponseStatus::INVALID_REQUEST);
+    }
+    catch (const std::exception &e)
+    {
+      zlc::error("[ServiceManager] Exception while handling service '{}': {}",
+                 job->service_name, e.what());
+      responder.fail(ResponseStatus::SERVICE_FAIL);
+    }
+    return;
+  }
+
+  ServiceReply reply;
+  if (job->handler)
+  {
+    ByteBuffer out;
+    invoke(*job->handler, job->service_name, payload, reply.response, out);
+    if (reply.response.code == ResponseStatus::SUCCESS)
+    {
+      reply.body = toMessage(out);
+    }
+  }
+  else
+  {
+    zlc::info("[ServiceManager] Request for unknown service '{}'", job->service_name);
+    reply.response.code = ResponseStatus::NOSERVICE;
+  }
+  reply.route = std::move(job->route);
+  reply.service_name = std::move(job->service_name);
+  reply.compact = job->compact;
+  replies_->push(std::move(reply));
+}
+
+void ServiceManager::runStream(const std::shared_ptr<Job> &job, ByteView payload)
+{
+  ServiceStreamWriter::State &state = *job->stream;
+  std::string code(ResponseStatus::SUCCESS);
+  try
+  {
+    // The request starts with the reader's window
+    if (uint32_t window = decodeStreamCredit(payload))
+    {
+      state.grant(window);
+    }
+    ServiceStreamWriter writer(job->stream);
+    job->handler->stream(payload, writer);
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.timed_out)
+    {
+      code = ResponseStatus::SERVICE_TIMEOUT;
+    }
+  }
+  catch (const DecodeException &e)
+  {
+    zlc::error("[ServiceManager] Failed to decode request for service '{}': {}",
+               job->service_name, e.what());
+    code = ResponseStatus::INVALID_REQUEST;
+  }
+  catch (const std::exception &e)
+  {
+    zlc::error("[ServiceManager] Exception while streaming service '{}': {}",
+               job->service_name, e.what());
+    code = ResponseStatus::SERVICE_FAIL;
+  }
+
+  // Written only by this worker, so the route can be handed over now
+  ServiceReply reply{std::move(state.route), std::move(job->service_name),
+                     Response(code), false, job->compact};
+  replies_->push(std::move(reply));
+}
+
+void ServiceManager::enqueueBatch(std::shared_ptr<Job> job)
+{
+  BatchQueue &queue = batches_[job->service_name];
+  const BatchOptions &options = job->handler->batch_options;
+  if (queue.pending.empty())
+  {
+    queue.flush_at = std::chrono::steady_clock::now() + options.max_wait;
+  }
+  queue.pending.push_back(std::move(job));
+
+  // With no batch running there is nothing to wait for
+  if (queue.pending.size() >= options.max_batch_size ||
+      queue.running->load(std::memory_order_acquire) == 0)
+  {
+    flushBatch(queue);
+  }
+}
+
+void ServiceManager::flushBatch(BatchQueue &queue)
+{
+  std::vector<std::shared_ptr<Job>> jobs;
+  jobs.swap(queue.pending);
+  queue.running->fetch_add(1, std::memory_order_acq_rel);
+  workers_->enqueue([this, jobs = std::move(jobs), running = queue.running]() mutable
+                    { runBatch(std::move(jobs), running); });
+}
+
+std::chrono::steady_clock::time_point
+ServiceManager::flushBatches(std::chrono::steady_clock::time_point now)
+{
+  auto next = std::chrono::steady_clock::time_point::max();
+  for (auto it = batches_.begin(); it != batches_.end();)
+  {
+    BatchQueue &queue = it->second;
+    const bool idle = queue.running->load(std::memory_order_acquire) == 0;
+    if (!queue.pending.empty() && (idle || now >= queue.flush_at))
+    {
+      flushBatch(queue);
+    }
+    if (!queue.pending.empty())
+    {
+      next = std::min(next, queue.flush_at);
+    }
+    else if (idle)
+    {
+      it = batches_.erase(it);
+      continue;
+    }
+    ++it;
+  }
+  return next;
+}
+
+void ServiceManager::runBatch(std::vector<std::shared_ptr<Job>> jobs,
+                              const std::shared_ptr<std::atomic<size_t>> &running)
+{
+  const std::string &service_name = jobs.front()->service_name;
+  const auto now = std::chrono::steady_clock::now();
+
+  std::vector<std::shared_ptr<Job>> live;
+  std::vector<ByteView> payloads;
+  std::vector<ServiceReply> replies;
+  for (auto &job : jobs)
+  {
+    std::string_view rejected = startJob(*job, now);
+    if (!rejected.empty())
+    {
+      replies.push_back(ServiceReply{std::move(job->route), job->service_name,
+                                     Response(std::string(rejected)), false,
+                                     job->compact});
+      continue;
     }
+    payloads.push_back(ByteView{static_cast<const uint8_t *>(job->payload.data()),
+                                job->payload.size()});
+    live.push_back(job);
+  }
+  if (!replies.empty())
+  {
+    zlc::warn("[ServiceManager] Skipping {} batched requests for '{}': caller "
+              "deadline passed or queued too long",
+              replies.size(), service_name);
+  }
 
-    Response response;
-    handleRequest(service_name, payload, response);
+  std::vector<Response> responses(live.size());
+  if (!live.empty())
+  {
+    invokeBatch(*live.front()->handler, service_name, payloads, responses);
+  }
+  for (size_t i = 0; i < live.size(); ++i)
+  {
+    replies.push_back(ServiceReply{std::move(live[i]->route), live[i]->service_name,
+                                   std::move(responses[i]), false, live[i]->compact});
+  }
 
-    // Send response frames
+  // Before the replies wake up the poll thread, so it sees the batch done
+  running->fetch_sub(1, std::memory_order_acq_rel);
+  for (auto &reply : replies)
+  {
+    replies_->push(std::move(reply));
+  }
+}
+
+void ServiceManager::grantCredit(std::vector<zmq::message_t> &route,
+                                 const zmq::message_t &payload)
+{
+  auto it = streams_.find(routeKey(route));
+  if (it == streams_.end())
+  {
+    return; // the stream already ended
+  }
+  try
+  {
+    ByteView view{static_cast<const uint8_t *>(payload.data()), payload.size()};
+    it->second->grant(decodeStreamCredit(view));
+  }
+  catch (const DecodeException &e)
+  {
+    zlc::warn("[ServiceManager] Invalid stream credit: {}", e.what());
+  }
+}
+
+void ServiceManager::sendReplies()
+{
+  for (auto &reply : replies_->take())
+  {
+    sendReply(reply);
+  }
+}
+
+void ServiceManager::sendReply(ServiceReply &reply)
+{
+  if (reply.more)
+  {
+    sendResponse(reply.route, reply.response, reply.compact);
+    return;
+  }
+  if (!streams_.empty())
+  {
+    streams_.erase(routeKey(reply.route));
+  }
+  if (!leaders_.empty())
+  {
+    finishFlight(reply);
+  }
+  // Counted as finished before the caller can see the reply, so that it
+  // never reads its own request in the statistics
+  std::shared_ptr<Job> next = releaseSlot(reply.service_name);
+  sendResponse(reply.route, reply.response, reply.compact, std::move(reply.body));
+  if (next)
+  {
+    dispatch(std::move(next));
+  }
+}
+
+void ServiceManager::sendResponse(std::vector<zmq::message_t> &route,
+                                  const Response &response, bool compact,
+                                  zmq::message_t body)
+{
+  if (route.empty())
+  {
+    return; // one-way request
+  }
+  for (auto &frame : route)
+  {
+    res_socket_->send(frame, zmq::send_flags::sndmore);
+  }
+  uint8_t status;
+  if (compact && encodeStatus(response.code, status))
+  {
+    res_socket_->send(zmq::buffer(&status, 1), zmq::send_flags::sndmore);
+  }
+  else
+  {
     res_socket_->send(zmq::buffer(response.code), zmq::send_flags::sndmore);
+  }
+  if (body.size() != 0)
+  {
+    res_socket_->send(body, zmq::send_flags::none);
+  }
+  else
+  {
     res_socket_->send(zmq::buffer(response.payload), zmq::send_flags::none);
   }
-  catch (const zmq::error_t &e)
+}
+
+std::shared_ptr<ServiceManager::Job>
+ServiceManager::releaseSlot(const std::string &service_name)
+{
+  auto it = slots_.find(service_name);
+  if (it == slots_.end())
   {
-    if (e.num() == ETERM)
+    return nullptr;
+  }
+  Slot &slot = it->second;
+  --slot.running;
+  if (slot.counters)
+  {
+    slot.counters->in_flight.fetch_sub(1, std::memory_order_relaxed);
+  }
+  if (!slot.waiting.empty())
+  {
+    std::shared_ptr<Job> next = std::move(slot.waiting.front());
+    slot.waiting.pop_front();
+    return next;
+  }
+  if (slot.running == 0)
+  {
+    slots_.erase(it);
+  }
+  return nullptr;
+}
+
+void ServiceManager::expireDeferred(std::chrono::steady_clock::time_point now)
+{
+  while (!deadlines_.empty() && deadlines_.top().first <= now)
+  {
+    std::shared_ptr<ServiceResponder::State> answer = deadlines_.top().second;
+    deadlines_.pop();
+
+    if (answer->done.exchange(true))
     {
-      zlc::info("[ServiceManager] Context terminated during poll");
-      return;
+      continue; // answered in time
     }
-    zlc::error("[ServiceManager] ZMQ error: {}", e.what());
+
+    zlc::warn("[ServiceManager] Deferred request for service '{}' timed out",
+              answer->service_name);
+    ServiceReply reply{std::move(answer->route), answer->service_name,
+                       Response(std::string(ResponseStatus::SERVICE_TIMEOUT)), false,
+                       answer->compact};
+    sendReply(reply);
   }
 }
 
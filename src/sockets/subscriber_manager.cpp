@@ -3,8 +3,57 @@
 namespace zlc
 {
 
-SubscriberManager::SubscriberManager()
+namespace
 {
+
+// Upper bound on messages taken from one socket per poll cycle, so a single
+// busy topic cannot starve the others on its shard
+constexpr int MAX_DRAIN_BATCH = 256;
+
+// Set while a shard thread runs subscriber callbacks
+thread_local bool t_dispatching = false;
+
+struct DispatchScope
+{
+  DispatchScope()
+  {
+    t_dispatching = true;
+  }
+  ~DispatchScope()
+  {
+    t_dispatching = false;
+  }
+};
+
+} // namespace
+
+SubscriberManager::SubscriberManager(const NodeOptions &options)
+    : topic_affinity_(options.topic_affinity)
+{
+  const size_t shard_count =
+      options.subscriber_shards > 0 ? options.subscriber_shards : 1;
+  shards_.reserve(shard_count);
+  for (size_t i = 0; i < shard_count; ++i)
+  {
+    auto shard = std::make_unique<Shard>();
+    shard->index = i;
+    if (i < options.subscriber_shard_cpus.size())
+    {
+      shard->cpu = options.subscriber_shard_cpus[i];
+    }
+    shards_.push_back(std::move(shard));
+  }
+
+  for (const auto &[topic, shard] : topic_affinity_)
+  {
+    if (shard >= shard_count)
+    {
+      zlc::warn("[SubscriberManager] Topic '{}' pinned to shard {} but only {} shards "
+                "exist; using shard {}",
+                topic, shard, shard_count, shard % shard_count);
+    }
+  }
+
   // Subscribe to node/topic updates
   NodeInfoManager::instance().node_update_event.subscribe(std::bind(
       &SubscriberManager::updateTopicSubscriber, this, std::placeholders::_1));
@@ -21,144 +70,572 @@ SubscriberManager::~SubscriberManager()
 
 void SubscriberManager::start()
 {
-  poll_task_ =
-      std::make_unique<PeriodicTask>([this]() { this->pollOnce(); }, 100,
-                                     ThreadPool::instance()); // Poll every 100ms
+  for (auto &shard : shards_)
+  {
+    Shard *s = shard.get();
+    // zmq::poll blocks for up to 10ms when idle, so no extra delay is needed
+    s->poll_task = std::make_unique<PeriodicTask>([this, s]() { this->pollOnce(*s); },
+                                                  0, ThreadPool::instance());
+    s->poll_task->start();
+  }
 
-  poll_task_->start();
+  zlc::info("[SubscriberManager] Started {} subscriber shard(s)", shards_.size());
 }
 
 void SubscriberManager::stop()
 {
-  if (poll_task_)
+  for (auto &shard : shards_)
+  {
+    if (shard->poll_task)
+    {
+      shard->poll_task->stop();
+    }
+
+    // The polling thread is gone, so pending sockets can be closed here
+    releaseRetired(*shard);
+  }
+}
+
+size_t SubscriberManager::shardForTopic(const std::string &topicName)
+{
+  {
+    std::lock_guard<std::mutex> lock(affinity_mutex_);
+    auto it = topic_affinity_.find(topicName);
+    if (it != topic_affinity_.end())
+    {
+      return it->second % shards_.size();
+    }
+  }
+  return std::hash<std::string>{}(topicName) % shards_.size();
+}
+
+void SubscriberManager::setTopicAffinity(const std::string &topicName, size_t shard)
+{
+  std::lock_guard<std::mutex> lock(affinity_mutex_);
+  topic_affinity_[topicName] = shard;
+}
+
+SubscriptionId
+SubscriberManager::registerRawTopicSubscriber(const std::string &topicName,
+                                              const RawMessageCallback &callback,
+                                              const SubscribeOptions &options)
+{
+  if (TopicTrie::isPattern(topicName))
   {
-    poll_task_->stop();
+    return registerRawPatternSubscriber(
+        topicName,
+        [callback](const std::string &, const MessageHeader &header,
+                   const ByteView &view) { callback(header, view); },
+        options);
   }
+
+  auto publishers = NodeInfoManager::instance().getPublisherInfo(topicName);
+
+  std::lock_guard<std::mutex> index_lock(index_mutex_);
+  return addEntry(topicName, callback, options, 0, publishers);
 }
 
-void SubscriberManager::_registerTopicSubscriber(
-    const std::string &topicName, const std::function<void(const ByteView &)> &callback)
+SubscriptionId
+SubscriberManager::registerRawPatternSubscriber(const std::string &pattern,
+                                                const TopicMessageCallback &callback,
+                                                const SubscribeOptions &options)
 {
-  std::lock_guard<std::mutex> lock(mutex_);
+  SubscriptionId id = next_id_++;
+  auto publishers = NodeInfoManager::instance().getAllPublisherInfo();
+
+  std::lock_guard<std::mutex> index_lock(index_mutex_);
+  pattern_index_.insert(pattern, id);
 
-  Subscriber sub;
-  sub.topicName = topicName;
-  sub.callback = callback;
+  PatternEntry &entry = patterns_[id];
+  entry.pattern = pattern;
+  entry.callback = callback;
+  entry.options = options;
 
-  sub.socket = ZMQContext::createSocket(zmq::socket_type::sub);
-  sub.socket->set(zmq::sockopt::subscribe, "");
-  auto urls = findTopicURLs(topicName);
-  for (const auto &url : urls)
+  // Topics published before the pattern was registered
+  std::unordered_map<std::string, std::vector<SocketInfo>> matching;
+  std::vector<TopicTrie::Value> matches;
+  for (const auto &info : publishers)
+  {
+    matches.clear();
+    pattern_index_.match(info.name, matches);
+    if (std::find(matches.begin(), matches.end(), id) != matches.end())
+    {
+      matching[info.name].push_back(info);
+    }
+  }
+  for (const auto &[topicName, topicPublishers] : matching)
   {
-    sub.socket->connect(url);
-    zlc::info("[SubscriberManager] '{}' connected to {}", topicName, url);
-    sub.publisherURLs.push_back(url);
+    addPatternTopic(id, entry, topicName, topicPublishers);
   }
-  subscribers_.push_back(std::move(sub));
+
+  zlc::info("[SubscriberManager] Subscribed to pattern '{}' ({} topic(s) so far)",
+            pattern, entry.topics.size());
+  return id;
 }
 
-std::vector<std::string> SubscriberManager::findTopicURLs(const std::string &topicName)
+SubscriptionId SubscriberManager::addEntry(const std::string &topicName,
+                                           const RawMessageCallback &callback,
+                                           const SubscribeOptions &options,
+                                           SubscriptionId pattern,
+                                           const std::vector<SocketInfo> &publishers)
 {
-  std::vector<std::string> urls;
+  Shard &shard = *shards_[shardForTopic(topicName)];
+
+  auto sub = std::make_unique<TopicEntry>();
+  sub->id = next_id_++;
+  sub->pattern = pattern;
+  sub->topicName = topicName;
+  sub->callback = callback;
+  sub->options = options;
+  if (!options.consumer_group.empty() && options.flow_control_window == 0)
+  {
+    sub->options.flow_control_window = DEFAULT_CONSUMER_GROUP_WINDOW;
+  }
+  sub->last_message = std::chrono::steady_clock::now();
 
-  auto infos = NodeInfoManager::instance().getPublisherInfo(topicName);
+  std::lock_guard<std::mutex> lock(shard.mutex);
 
-  for (const auto &t : infos)
+  sub->socket = ZMQContext::createSocket(zmq::socket_type::sub);
+  if (options.keys.empty())
+  {
+    sub->socket->set(zmq::sockopt::subscribe, "");
+  }
+  for (const auto &key : options.keys)
+  {
+    // Matched by the publisher against the key frame of each message
+    sub->socket->set(zmq::sockopt::subscribe, MessageKey::encode(key));
+  }
+  for (const auto &info : publishers)
   {
-    urls.push_back(fmt::format("tcp://{}:{}", t.ip, t.port));
+    connectPublisher(*sub, info);
   }
 
-  return urls;
+  SubscriptionId id = sub->id;
+  topic_index_[topicName].push_back(IndexedEntry{&shard, sub.get()});
+  shard.subscribers.push_back(std::move(sub));
+  return id;
 }
 
-void SubscriberManager::updateTopicSubscriber(const NodeInfo &nodeInfo)
+void SubscriberManager::addPatternTopic(SubscriptionId id, PatternEntry &pattern,
+                                        const std::string &topicName,
+                                        const std::vector<SocketInfo> &publishers)
 {
-  std::lock_guard<std::mutex> lock(mutex_);
+  if (pattern.topics.count(topicName) > 0)
+  {
+    return; // already subscribed
+  }
 
-  for (const auto &topic : nodeInfo.topics)
+  TopicMessageCallback callback = pattern.callback;
+  pattern.topics[topicName] = addEntry(
+      topicName,
+      [callback, topicName](const MessageHeader &header, const ByteView &view)
+      { callback(topicName, header, view); },
+      pattern.options, id, publishers);
+
+  zlc::info("[SubscriberManager] Pattern '{}' matched topic '{}'", pattern.pattern,
+            topicName);
+}
+
+bool SubscriberManager::unregisterTopicSubscriber(SubscriptionId id)
+{
+  // The registration itself, or every registration owned by a pattern
+  std::vector<SubscriptionId> topics;
+  bool pattern_found = false;
+  {
+    std::lock_guard<std::mutex> index_lock(index_mutex_);
+    auto it = patterns_.find(id);
+    if (it == patterns_.end())
+    {
+      topics.push_back(id);
+    }
+    else
+    {
+      pattern_index_.erase(it->second.pattern, id);
+      for (const auto &[name, topic_id] : it->second.topics)
+      {
+        topics.push_back(topic_id);
+      }
+      zlc::info("[SubscriberManager] Unsubscribed from pattern '{}'",
+                it->second.pattern);
+      patterns_.erase(it);
+      pattern_found = true;
+    }
+  }
+
+  // Outside the index lock: retiring may wait for an in-flight dispatch
+  bool retired = false;
+  for (SubscriptionId topic_id : topics)
   {
-    for (auto &sub : subscribers_)
+    retired = retireEntry(topic_id) || retired;
+  }
+  return retired || pattern_found;
+}
+
+bool SubscriberManager::retireEntry(SubscriptionId id)
+{
+  for (auto &shard : shards_)
+  {
+    bool polling = false;
     {
-      if (sub.topicName != topic.name)
+      std::lock_guard<std::mutex> index_lock(index_mutex_);
+      std::lock_guard<std::mutex> lock(shard->mutex);
+
+      auto it = std::find_if(shard->subscribers.begin(), shard->subscribers.end(),
+                             [id](const std::unique_ptr<TopicEntry> &sub)
+                             { return sub->id == id; });
+      if (it == shard->subscribers.end())
+      {
         continue;
+      }
 
-      std::string url = fmt::format("tcp://{}:{}", topic.ip, topic.port);
+      (*it)->active = false;
+      zlc::info("[SubscriberManager] Unsubscribed from '{}'", (*it)->topicName);
 
-      if (std::find(sub.publisherURLs.begin(), sub.publisherURLs.end(), url) !=
-          sub.publisherURLs.end())
+      auto indexed = topic_index_.find((*it)->topicName);
+      if (indexed != topic_index_.end())
       {
-        continue; // already connected
+        auto &entries = indexed->second;
+        TopicEntry *entry = it->get();
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [entry](const IndexedEntry &e)
+                                     { return e.entry == entry; }),
+                      entries.end());
+        if (entries.empty())
+        {
+          topic_index_.erase(indexed);
+        }
       }
 
-      sub.socket->connect(url);
-      sub.publisherURLs.push_back(url);
+      shard->retired.push_back(std::move(*it));
+      shard->subscribers.erase(it);
+      polling = shard->poll_task && shard->poll_task->is_running();
+    }
 
-      zlc::info("[SubscriberManager] '{}' connected to {}", topic.name, url);
+    if (!polling)
+    {
+      releaseRetired(*shard);
+    }
+    else if (!t_dispatching)
+    {
+      // Wait for a dispatch that may still be using the callback. Skipped
+      // inside callbacks, where it could deadlock against another shard.
+      std::lock_guard<std::mutex> dispatch_lock(shard->dispatch_mutex);
     }
+    return true;
   }
+  return false;
 }
 
-void SubscriberManager::removeTopicSubscriber(const NodeInfo &nodeInfo)
+size_t SubscriberManager::subscriptionCount()
 {
-  std::lock_guard<std::mutex> lock(mutex_);
+  std::lock_guard<std::mutex> index_lock(index_mutex_);
+  size_t count = patterns_.size();
+  for (auto &shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    count += std::count_if(shard->subscribers.begin(), shard->subscribers.end(),
+                           [](const std::unique_ptr<TopicEntry> &sub)
+                           { return sub->pattern == 0; });
+  }
+  return count;
+}
 
-  for (const auto &topic : nodeInfo.topics)
+TopicStatistics SubscriberManager::topicStatistics(const std::string &topicName)
+{
+  TopicStatistics stats;
+  for (auto &shard : shards_)
   {
-    for (auto &sub : subscribers_)
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    for (const auto &sub : shard->subscribers)
     {
-      if (sub.topicName != topic.name)
+      if (sub->topicName != topicName)
         continue;
 
-      std::string url = fmt::format("tcp://{}:{}", topic.ip, topic.port);
+      stats.received += sub->received.load(std::memory_order_relaxed);
+      stats.expired += sub->expired.load(std::memory_order_relaxed);
+      stats.deadline_missed += sub->deadline_missed.load(std::memory_order_relaxed);
+    }
+  }
+  return stats;
+}
+
+void SubscriberManager::releaseRetired(Shard &shard)
+{
+  std::vector<std::unique_ptr<TopicEntry>> retired;
+  std::vector<std::unique_ptr<CreditLink>> retired_links;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    retired.swap(shard.retired);
+    retired_links.swap(shard.retired_links);
+  }
+
+  for (auto &sub : retired)
+  {
+    for (auto &link : sub->credit_links)
+    {
+      retired_links.push_back(std::move(link));
+    }
+    ZMQContext::releaseSocket(sub->socket);
+    sub->socket = nullptr;
+  }
+
+  for (auto &link : retired_links)
+  {
+    // Linger so that the BYE is not discarded together with the socket
+    sendCredit(*link, CreditMessage::Bye, 0);
+    ZMQContext::releaseSocket(link->socket, CREDIT_BYE_LINGER);
+  }
+}
+
+void SubscriberManager::connectPublisher(TopicEntry &entry, const SocketInfo &info)
+{
+  std::string url = fmt::format("tcp://{}:{}", info.ip, info.port);
+  if (std::find(entry.publisherURLs.begin(), entry.publisherURLs.end(), url) !=
+      entry.publisherURLs.end())
+  {
+    return; // already connected
+  }
+  entry.publisherURLs.push_back(url);
+
+  if (info.credit_port == 0 && !entry.options.consumer_group.empty())
+  {
+    // A plain PUB socket would hand every message to every group member
+    zlc::warn("[SubscriberManager] '{}' publisher at {} has no flow control and "
+              "cannot serve consumer group '{}'",
+              info.name, url, entry.options.consumer_group);
+    return;
+  }
+
+  if (entry.options.flow_control_window == 0 || info.credit_port == 0)
+  {
+    entry.socket->connect(url);
+    zlc::info("[SubscriberManager] '{}' connected to {}", info.name, url);
+    return;
+  }
+
+  // The shard thread only picks the link up on its next cycle, after taking
+  // the shard mutex, so the socket can be set up from this thread.
+  auto link = std::make_unique<CreditLink>();
+  link->url = url;
+  link->socket = ZMQContext::createSocket(zmq::socket_type::dealer);
+  link->socket->connect(fmt::format("tcp://{}:{}", info.ip, info.credit_port));
+  sendHello(entry, *link);
+  entry.credit_links.push_back(std::move(link));
+
+  zlc::info("[SubscriberManager] '{}' connected to {} with flow control (window {})",
+            info.name, url, entry.options.flow_control_window);
+}
+
+void SubscriberManager::disconnectPublisher(Shard &shard, TopicEntry &entry,
+                                            const SocketInfo &info)
+{
+  std::string url = fmt::format("tcp://{}:{}", info.ip, info.port);
+
+  auto it = std::find(entry.publisherURLs.begin(), entry.publisherURLs.end(), url);
+  if (it == entry.publisherURLs.end())
+  {
+    return; // not connected to this publisher
+  }
+  entry.publisherURLs.erase(it);
+
+  auto link = std::find_if(entry.credit_links.begin(), entry.credit_links.end(),
+                           [&url](const std::unique_ptr<CreditLink> &l)
+                           { return l->url == url; });
+  if (link != entry.credit_links.end())
+  {
+    // Still polled by the shard thread, which closes it on its next cycle
+    shard.retired_links.push_back(std::move(*link));
+    entry.credit_links.erase(link);
+  }
+  else if (entry.options.consumer_group.empty())
+  {
+    entry.socket->disconnect(url);
+  }
+
+  zlc::info("[SubscriberManager] '{}' disconnected from {}", info.name, url);
+}
 
-      auto it = std::find(sub.publisherURLs.begin(), sub.publisherURLs.end(), url);
-      if (it == sub.publisherURLs.end())
+void SubscriberManager::sendCredit(CreditLink &link, uint8_t type, uint32_t credits)
+{
+  CreditMessage msg;
+  msg.type = type;
+  msg.credits = credits;
+  sendControl(link, msg);
+}
+
+void SubscriberManager::sendHello(const TopicEntry &entry, CreditLink &link)
+{
+  CreditMessage hello;
+  hello.type = CreditMessage::Hello;
+  hello.credits = entry.options.flow_control_window;
+  hello.group = entry.options.consumer_group;
+  hello.keys = entry.options.keys;
+  sendControl(link, hello);
+  link.consumed = 0;
+  link.last_hello = link.last_sent;
+}
+
+void SubscriberManager::sendControl(CreditLink &link, const CreditMessage &msg)
+{
+  auto bytes = msg.encode();
+
+  try
+  {
+    link.socket->send(zmq::buffer(bytes), zmq::send_flags::dontwait);
+  }
+  catch (const zmq::error_t &e)
+  {
+    zlc::warn("[SubscriberManager] Failed to send credit to {}: {}", link.url,
+              e.what());
+  }
+  link.last_sent = std::chrono::steady_clock::now();
+}
+
+void SubscriberManager::updateTopicSubscriber(const NodeInfo &nodeInfo)
+{
+  std::lock_guard<std::mutex> index_lock(index_mutex_);
+
+  std::vector<TopicTrie::Value> matches;
+  for (const auto &topic : nodeInfo.topics)
+  {
+    // New topics matching a pattern get their own registration first, which
+    // connects to every known publisher of the topic
+    matches.clear();
+    pattern_index_.match(topic.name, matches);
+    for (TopicTrie::Value id : matches)
+    {
+      auto pattern = patterns_.find(id);
+      if (pattern != patterns_.end())
       {
-        continue; // not connected to this publisher
+        addPatternTopic(id, pattern->second, topic.name, {topic});
       }
+    }
+
+    auto indexed = topic_index_.find(topic.name);
+    if (indexed == topic_index_.end())
+      continue;
+
+    for (const IndexedEntry &e : indexed->second)
+    {
+      std::lock_guard<std::mutex> lock(e.shard->mutex);
+      connectPublisher(*e.entry, topic);
+    }
+  }
+}
+
+void SubscriberManager::removeTopicSubscriber(const NodeInfo &nodeInfo)
+{
+  // Entries a pattern created for topics that no longer have a publisher
+  std::vector<SubscriptionId> unused;
+  {
+    std::lock_guard<std::mutex> index_lock(index_mutex_);
 
-      sub.socket->disconnect(url);
-      sub.publisherURLs.erase(it);
+    for (const auto &topic : nodeInfo.topics)
+    {
+      auto indexed = topic_index_.find(topic.name);
+      if (indexed == topic_index_.end())
+        continue;
 
-      zlc::info("[SubscriberManager] '{}' disconnected from {}", topic.name, url);
+      for (const IndexedEntry &e : indexed->second)
+      {
+        std::lock_guard<std::mutex> lock(e.shard->mutex);
+        disconnectPublisher(*e.shard, *e.entry, topic);
+        if (e.entry->pattern == 0 || !e.entry->publisherURLs.empty())
+        {
+          continue;
+        }
+
+        // A publisher showing up later creates a new entry for the topic
+        auto pattern = patterns_.find(e.entry->pattern);
+        if (pattern != patterns_.end())
+        {
+          pattern->second.topics.erase(topic.name);
+        }
+        unused.push_back(e.entry->id);
+      }
     }
   }
+
+  // Outside the index lock: retiring may wait for an in-flight dispatch
+  for (SubscriptionId id : unused)
+  {
+    retireEntry(id);
+  }
 }
 
-void SubscriberManager::pollOnce()
+void SubscriberManager::pollOnce(Shard &shard)
 {
+  if (!shard.pinned)
+  {
+    shard.pinned = true;
+    if (shard.cpu >= 0 && pinCurrentThreadToCpu(shard.cpu))
+    {
+      zlc::info("[SubscriberManager] Shard {} pinned to CPU {}", shard.index,
+                shard.cpu);
+    }
+  }
+
+  // Entries unregistered during the previous cycle are no longer referenced
+  releaseRetired(shard);
+
   try
   {
+    struct PollTarget
+    {
+      TopicEntry *entry;
+      ZMQSocket *socket;
+      CreditLink *link;
+    };
+
     std::vector<zmq::pollitem_t> poll_items;
-    std::vector<Subscriber *> subs;
+    std::vector<PollTarget> targets;
+    std::vector<TopicEntry *> subs;
 
     {
-      std::lock_guard<std::mutex> lock(mutex_);
-      poll_items.reserve(subscribers_.size());
-      subs.reserve(subscribers_.size());
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      subs.reserve(shard.subscribers.size());
 
-      for (auto &sub : subscribers_)
+      for (auto &sub : shard.subscribers)
       {
-        poll_items.push_back({sub.socket->handle(), 0, ZMQ_POLLIN, 0});
-        subs.push_back(&sub);
+        poll_items.push_back({sub->socket->handle(), 0, ZMQ_POLLIN, 0});
+        targets.push_back({sub.get(), sub->socket, nullptr});
+        for (auto &link : sub->credit_links)
+        {
+          poll_items.push_back({link->socket->handle(), 0, ZMQ_POLLIN, 0});
+          targets.push_back({sub.get(), link->socket, link.get()});
+        }
+        subs.push_back(sub.get());
       }
     }
 
     zmq::poll(poll_items.data(), poll_items.size(), std::chrono::milliseconds(10));
 
+    std::lock_guard<std::mutex> dispatch_lock(shard.dispatch_mutex);
+    DispatchScope scope;
     for (size_t i = 0; i < poll_items.size(); ++i)
     {
-      if (poll_items[i].revents & ZMQ_POLLIN)
+      if ((poll_items[i].revents & ZMQ_POLLIN) && targets[i].entry->active)
       {
-        zmq::message_t msg;
-        if (!subs[i]->socket->recv(msg, zmq::recv_flags::none))
-        {
-          continue;
-        }
+        drain(*targets[i].entry, *targets[i].socket, targets[i].link);
+      }
+    }
 
-        ByteView view{static_cast<const uint8_t *>(msg.data()), msg.size()};
+    auto now = std::chrono::steady_clock::now();
+    for (auto *sub : subs)
+    {
+      if (sub->active)
+      {
+        checkDeadline(*sub, now);
+      }
+    }
 
-        subs[i]->callback(view);
+    // Discovery may add or retire credit links concurrently
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto *sub : subs)
+    {
+      if (sub->active)
+      {
+        sendKeepalives(*sub, now);
       }
     }
   }
@@ -166,7 +643,9 @@ void SubscriberManager::pollOnce()
   {
     if (e.num() == ETERM)
     {
+      // The loop has no interval, so rerunning it would spin until stop()
       zlc::info("[SubscriberManager] Context terminated during poll");
+      shard.poll_task->cancel();
       return;
     }
     zlc::error("[SubscriberManager] ZMQ error: {}", e.what());
@@ -177,4 +656,145 @@ void SubscriberManager::pollOnce()
   }
 }
 
+void SubscriberManager::drain(TopicEntry &entry, ZMQSocket &socket, CreditLink *link)
+{
+  // Sampled once per batch to keep clock reads off the per-message path
+  const auto received_at = std::chrono::steady_clock::now();
+  const int64_t now_ns = MessageHeader::now();
+
+  for (int n = 0; n < MAX_DRAIN_BATCH && entry.active; ++n)
+  {
+    zmq::message_t first;
+    if (!socket.recv(first, zmq::recv_flags::dontwait))
+    {
+      return;
+    }
+
+    // Credit channels send control messages as single frames
+    if (link != nullptr && !first.more())
+    {
+      handleControl(entry, *link, first);
+      continue;
+    }
+
+    // Single-frame messages come from publishers without an envelope
+    if (!first.more())
+    {
+      ByteView view{static_cast<const uint8_t *>(first.data()), first.size()};
+      entry.received.fetch_add(1, std::memory_order_relaxed);
+      entry.last_message = received_at;
+      entry.callback(MessageHeader::legacy(), view);
+      continue;
+    }
+
+    // Remaining frames of a multipart message are already queued. The key
+    // frame was only needed for filtering at the publisher.
+    if (MessageKey::isKeyFrame(static_cast<const uint8_t *>(first.data()),
+                               first.size()) &&
+        !socket.recv(first, zmq::recv_flags::none))
+    {
+      return;
+    }
+
+    zmq::message_t payload;
+    if (!socket.recv(payload, zmq::recv_flags::none))
+    {
+      return;
+    }
+
+    // Credit is returned once the message has been handled (or discarded)
+    if (link != nullptr)
+    {
+      ++link->consumed;
+    }
+
+    MessageHeader header = MessageHeader::decode(
+        static_cast<const uint8_t *>(first.data()), first.size());
+
+    // Drop stale messages before anyone pays for decoding them
+    if (entry.options.lifespan.count() > 0 &&
+        now_ns - header.stamp_ns > entry.options.lifespan.count())
+    {
+      entry.expired.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+      ByteView view{static_cast<const uint8_t *>(payload.data()), payload.size()};
+      entry.received.fetch_add(1, std::memory_order_relaxed);
+      entry.last_message = received_at;
+      entry.callback(header, view);
+    }
+
+    // Grant in batches of half a window to keep control traffic low
+    if (link != nullptr &&
+        link->consumed >= std::max<uint32_t>(1, entry.options.flow_control_window / 2))
+    {
+      sendCredit(*link, CreditMessage::Credit, link->consumed);
+      link->consumed = 0;
+    }
+  }
+}
+
+void SubscriberManager::handleControl(TopicEntry &entry, CreditLink &link,
+                                      const zmq::message_t &frame)
+{
+  CreditMessage msg;
+  try
+  {
+    msg = CreditMessage::decode(static_cast<const uint8_t *>(frame.data()),
+                                frame.size());
+  }
+  catch (const std::exception &e)
+  {
+    zlc::warn("[SubscriberManager] Invalid control message from {}: {}", link.url,
+              e.what());
+    return;
+  }
+
+  // Credit sent before our HELLO arrived may trigger several requests
+  if (msg.type != CreditMessage::Rejoin ||
+      std::chrono::steady_clock::now() - link.last_hello < CREDIT_KEEPALIVE_INTERVAL)
+  {
+    return;
+  }
+
+  zlc::info("[SubscriberManager] '{}' rejoining flow-controlled publisher {}",
+            entry.topicName, link.url);
+  sendHello(entry, link);
+}
+
+void SubscriberManager::checkDeadline(TopicEntry &entry,
+                                      std::chrono::steady_clock::time_point now)
+{
+  if (entry.options.deadline.count() <= 0 ||
+      now - entry.last_message < entry.options.deadline)
+  {
+    return;
+  }
+
+  // Restart the period so the callback fires once per missed deadline
+  entry.last_message = now;
+  entry.deadline_missed.fetch_add(1, std::memory_order_relaxed);
+  zlc::warn("[SubscriberManager] Deadline missed on '{}'", entry.topicName);
+
+  if (entry.options.on_deadline_missed)
+  {
+    entry.options.on_deadline_missed(entry.topicName);
+  }
+}
+
+void SubscriberManager::sendKeepalives(TopicEntry &entry,
+                                       std::chrono::steady_clock::time_point now)
+{
+  for (auto &link : entry.credit_links)
+  {
+    if (now - link->last_sent >= CREDIT_KEEPALIVE_INTERVAL)
+    {
+      // Also returns credit for a partially consumed batch
+      sendCredit(*link, CreditMessage::Credit, link->consumed);
+      link->consumed = 0;
+    }
+  }
+}
+
 } // namespace zlc
@@ -0,0 +1,127 @@
+#include "zerolancom/sockets/wait_set.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <zmq.hpp>
+
+namespace zlc
+{
+
+WaitSet::Handle WaitSet::attach(GuardCondition &guard)
+{
+  return addSource(&guard, nullptr);
+}
+
+WaitSet::Handle WaitSet::addTimer(std::chrono::nanoseconds period)
+{
+  if (period.count() <= 0)
+  {
+    throw std::invalid_argument("WaitSet timer period must be positive");
+  }
+
+  Entry entry;
+  entry.period = period;
+  entry.next_fire = std::chrono::steady_clock::now() + period;
+  entries_.push_back(std::move(entry));
+  return entries_.size() - 1;
+}
+
+WaitSet::Handle WaitSet::addSource(GuardCondition *guard,
+                                   std::function<bool()> has_data)
+{
+  Entry entry;
+  entry.guard = guard;
+  entry.has_data = std::move(has_data);
+  entries_.push_back(std::move(entry));
+  return entries_.size() - 1;
+}
+
+bool WaitSet::isReady(Handle handle) const
+{
+  return handle < entries_.size() && entries_[handle].ready;
+}
+
+bool WaitSet::collectReady(std::chrono::steady_clock::time_point now)
+{
+  bool any = false;
+  for (auto &entry : entries_)
+  {
+    if (entry.period.count() > 0)
+    {
+      entry.ready = now >= entry.next_fire;
+      while (entry.next_fire <= now)
+      {
+        entry.next_fire += entry.period;
+      }
+    }
+    else if (entry.has_data)
+    {
+      // Reset first: a message queued after this point re-triggers the guard
+      entry.guard->reset();
+      entry.ready = entry.has_data();
+    }
+    else
+    {
+      entry.ready = entry.guard->isTriggered();
+    }
+    any = any || entry.ready;
+  }
+  return any;
+}
+
+bool WaitSet::waitFor(std::chrono::nanoseconds timeout)
+{
+  using Clock = std::chrono::steady_clock;
+
+  const bool infinite = timeout.count() < 0;
+  const Clock::time_point deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         infinite ? std::chrono::nanoseconds(0) : timeout);
+
+  std::vector<zmq::pollitem_t> items;
+  items.reserve(entries_.size());
+  for (const auto &entry : entries_)
+  {
+    if (entry.guard != nullptr)
+    {
+      items.push_back({nullptr, entry.guard->fd(), ZMQ_POLLIN, 0});
+    }
+  }
+
+  while (true)
+  {
+    Clock::time_point now = Clock::now();
+    if (collectReady(now))
+    {
+      return true;
+    }
+
+    // Sleep until the deadline or the next timer, whichever comes first
+    Clock::time_point wake = infinite ? Clock::time_point::max() : deadline;
+    for (const auto &entry : entries_)
+    {
+      if (entry.period.count() > 0)
+      {
+        wake = std::min(wake, entry.next_fire);
+      }
+    }
+
+    if (!infinite && now >= deadline)
+    {
+      return false;
+    }
+
+    long timeout_ms = -1;
+    if (wake != Clock::time_point::max())
+    {
+      // Round up so that we never wake before the timer is due
+      auto remaining = std::chrono::ceil<std::chrono::milliseconds>(wake - now);
+      timeout_ms = std::max<long>(0, remaining.count());
+    }
+
+    zmq::poll(items.data(), items.size(), std::chrono::milliseconds(timeout_ms));
+  }
+}
+
+} // namespace zlc
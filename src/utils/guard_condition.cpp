@@ -0,0 +1,80 @@
+#include "zerolancom/utils/guard_condition.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace zlc
+{
+
+GuardCondition::GuardCondition()
+{
+#ifdef __linux__
+  read_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (read_fd_ < 0)
+  {
+    throw std::runtime_error(std::string("GuardCondition: eventfd failed: ") +
+                             std::strerror(errno));
+  }
+  write_fd_ = read_fd_;
+#else
+  int fds[2];
+  if (pipe(fds) != 0)
+  {
+    throw std::runtime_error(std::string("GuardCondition: pipe failed: ") +
+                             std::strerror(errno));
+  }
+  for (int fd : fds)
+  {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  read_fd_ = fds[0];
+  write_fd_ = fds[1];
+#endif
+}
+
+GuardCondition::~GuardCondition()
+{
+  close(read_fd_);
+  if (write_fd_ != read_fd_)
+  {
+    close(write_fd_);
+  }
+}
+
+void GuardCondition::trigger()
+{
+  if (triggered_.exchange(true, std::memory_order_acq_rel))
+  {
+    return; // already signalled
+  }
+
+  uint64_t one = 1;
+  ssize_t written = write(write_fd_, &one, sizeof(one));
+  (void)written; // a full pipe is still readable, which is all we need
+}
+
+void GuardCondition::reset()
+{
+  // Clear the flag before draining: a concurrent trigger() may then leave the
+  // flag set with an empty descriptor, which callers catch by checking
+  // isTriggered() before polling. The opposite order could lose the trigger.
+  triggered_.store(false, std::memory_order_release);
+
+  uint64_t buf[8];
+  while (read(read_fd_, buf, sizeof(buf)) > 0)
+  {
+  }
+}
+
+} // namespace zlc
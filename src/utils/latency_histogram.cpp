@@ -0,0 +1,79 @@
+#include "zerolancom/utils/latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace zlc
+{
+
+size_t LatencyHistogram::bucketOf(uint64_t micros)
+{
+  // Below 4us every value has its own bucket
+  if (micros < 4)
+  {
+    return static_cast<size_t>(micros);
+  }
+  // Otherwise the exponent picks a group of four, the next two bits the bucket
+  int exponent = 63 - __builtin_clzll(micros);
+  size_t mantissa = static_cast<size_t>(micros >> (exponent - 2)) & 3;
+  return std::min(BUCKETS - 1, static_cast<size_t>(4 * (exponent - 1)) + mantissa);
+}
+
+uint64_t LatencyHistogram::upperBound(size_t bucket)
+{
+  if (bucket < 4)
+  {
+    return bucket;
+  }
+  int exponent = static_cast<int>(bucket / 4) + 1;
+  uint64_t mantissa = bucket % 4;
+  return ((5 + mantissa) << (exponent - 2)) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+  auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  counts_[bucketOf(static_cast<uint64_t>(std::max<int64_t>(0, micros)))].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+  uint64_t total = 0;
+  for (const auto &count : counts_)
+  {
+    total += count.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+std::chrono::microseconds LatencyHistogram::percentile(double fraction) const
+{
+  std::array<uint64_t, BUCKETS> counts;
+  uint64_t total = 0;
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    counts[i] = counts_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0)
+  {
+    return std::chrono::microseconds(0);
+  }
+
+  // Rank of the sample, counting from 1
+  auto rank = static_cast<uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * total));
+  rank = std::max<uint64_t>(1, rank);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    seen += counts[i];
+    if (seen >= rank)
+    {
+      return std::chrono::microseconds(upperBound(i));
+    }
+  }
+  return std::chrono::microseconds(upperBound(BUCKETS - 1));
+}
+
+} // namespace zlc
@@ -0,0 +1,177 @@
+#include "zerolancom/utils/topic_trie.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace zlc
+{
+
+namespace
+{
+
+const std::string ANY_SEGMENT = "*";
+const std::string REST_SEGMENTS = "**";
+
+std::vector<std::string> splitTopic(const std::string &name)
+{
+  std::vector<std::string> segments;
+  size_t start = 0;
+  while (true)
+  {
+    size_t end = name.find('/', start);
+    if (end == std::string::npos)
+    {
+      segments.push_back(name.substr(start));
+      return segments;
+    }
+    segments.push_back(name.substr(start, end - start));
+    start = end + 1;
+  }
+}
+
+bool removeValue(std::vector<TopicTrie::Value> &values, TopicTrie::Value value)
+{
+  auto it = std::find(values.begin(), values.end(), value);
+  if (it == values.end())
+  {
+    return false;
+  }
+  values.erase(it);
+  return true;
+}
+
+} // namespace
+
+TopicTrie::TopicTrie() : root_(std::make_unique<Node>())
+{
+}
+
+TopicTrie::~TopicTrie() = default;
+
+bool TopicTrie::isPattern(const std::string &name)
+{
+  for (const auto &segment : splitTopic(name))
+  {
+    if (segment == ANY_SEGMENT || segment == REST_SEGMENTS)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TopicTrie::insert(const std::string &pattern, Value value)
+{
+  const auto segments = splitTopic(pattern);
+
+  Node *node = root_.get();
+  for (size_t i = 0; i < segments.size(); ++i)
+  {
+    const std::string &segment = segments[i];
+    if (segment == REST_SEGMENTS)
+    {
+      if (i + 1 != segments.size())
+      {
+        throw std::invalid_argument("'**' must be the last segment of '" + pattern +
+                                    "'");
+      }
+      node->rest.push_back(value);
+      ++size_;
+      return;
+    }
+
+    std::unique_ptr<Node> &child =
+        segment == ANY_SEGMENT ? node->any : node->children[segment];
+    if (!child)
+    {
+      child = std::make_unique<Node>();
+    }
+    node = child.get();
+  }
+
+  node->values.push_back(value);
+  ++size_;
+}
+
+bool TopicTrie::erase(const std::string &pattern, Value value)
+{
+  if (!eraseFrom(*root_, splitTopic(pattern), 0, value))
+  {
+    return false;
+  }
+  --size_;
+  return true;
+}
+
+bool TopicTrie::eraseFrom(Node &node, const std::vector<std::string> &segments,
+                          size_t depth, Value value)
+{
+  if (depth == segments.size())
+  {
+    return removeValue(node.values, value);
+  }
+
+  const std::string &segment = segments[depth];
+  if (segment == REST_SEGMENTS)
+  {
+    return removeValue(node.rest, value);
+  }
+
+  if (segment == ANY_SEGMENT)
+  {
+    if (!node.any || !eraseFrom(*node.any, segments, depth + 1, value))
+    {
+      return false;
+    }
+    if (node.any->unused())
+    {
+      node.any.reset();
+    }
+    return true;
+  }
+
+  auto it = node.children.find(segment);
+  if (it == node.children.end() || !eraseFrom(*it->second, segments, depth + 1, value))
+  {
+    return false;
+  }
+  if (it->second->unused())
+  {
+    node.children.erase(it);
+  }
+  return true;
+}
+
+void TopicTrie::match(const std::string &topic, std::vector<Value> &out) const
+{
+  if (empty())
+  {
+    return;
+  }
+  matchFrom(*root_, splitTopic(topic), 0, out);
+}
+
+void TopicTrie::matchFrom(const Node &node, const std::vector<std::string> &segments,
+                          size_t depth, std::vector<Value> &out) const
+{
+  if (depth == segments.size())
+  {
+    out.insert(out.end(), node.values.begin(), node.values.end());
+    return;
+  }
+
+  // "**" needs at least one more segment, which there is
+  out.insert(out.end(), node.rest.begin(), node.rest.end());
+
+  auto it = node.children.find(segments[depth]);
+  if (it != node.children.end())
+  {
+    matchFrom(*it->second, segments, depth + 1, out);
+  }
+  if (node.any)
+  {
+    matchFrom(*node.any, segments, depth + 1, out);
+  }
+}
+
+} // namespace zlc
@@ -17,6 +17,14 @@ void init(const std::string &node_name, const std::string &ip_address,
   ZeroLanComNode::initManaged(node_name, ip_address, group, groupPort, groupName);
 }
 
+void init(const std::string &node_name, const std::string &ip_address,
+          const NodeOptions &options)
+{
+  Logger::init(false);
+  Logger::setLevel(LogLevel::INFO);
+  ZeroLanComNode::initManaged(node_name, ip_address, options);
+}
+
 void shutdown()
 {
   ZeroLanComNode::destroy();
@@ -64,4 +72,9 @@ void waitForService(const std::string &service_name, int max_wait_ms,
   }
   zlc::warn("[Client] Timeout waiting for service '{}'", service_name);
 }
+
+bool unregisterSubscriberHandler(SubscriptionId id)
+{
+  return SubscriberManager::instance().unregisterTopicSubscriber(id);
+}
 } // namespace zlc
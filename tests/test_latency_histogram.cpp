@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "zerolancom/utils/latency_histogram.hpp"
+
+namespace zlc
+{
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+// =============================================
+// LatencyHistogram Tests
+// =============================================
+
+TEST(LatencyHistogramTest, EmptyHistogramReportsZero)
+{
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.count(), 0u);
+  EXPECT_EQ(histogram.percentile(0.99), microseconds(0));
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact)
+{
+  LatencyHistogram histogram;
+  histogram.record(microseconds(0));
+  histogram.record(microseconds(3));
+  EXPECT_EQ(histogram.percentile(0.5), microseconds(0));
+  EXPECT_EQ(histogram.percentile(1.0), microseconds(3));
+}
+
+TEST(LatencyHistogramTest, PercentilesAreWithinBucketError)
+{
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 1000; ++i)
+  {
+    histogram.record(microseconds(i * 100));
+  }
+  EXPECT_EQ(histogram.count(), 1000u);
+
+  auto within = [](microseconds reported, microseconds actual)
+  { return reported >= actual && reported <= actual + actual / 4; };
+  EXPECT_TRUE(within(histogram.percentile(0.5), microseconds(50000)));
+  EXPECT_TRUE(within(histogram.percentile(0.9), microseconds(90000)));
+  EXPECT_TRUE(within(histogram.percentile(0.99), microseconds(99000)));
+}
+
+TEST(LatencyHistogramTest, HugeValuesLandInLastBucket)
+{
+  LatencyHistogram histogram;
+  histogram.record(std::chrono::hours(24 * 365));
+  histogram.record(milliseconds(-5)); // clock jitter counts as zero
+  EXPECT_EQ(histogram.percentile(0.0), microseconds(0));
+  EXPECT_GT(histogram.percentile(1.0), std::chrono::hours(24));
+}
+
+} // namespace zlc
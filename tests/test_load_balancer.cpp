@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "zerolancom/sockets/load_balancer.hpp"
+
+namespace zlc
+{
+
+namespace
+{
+// Urls are unique per test, since EndpointLoad is shared process-wide
+std::vector<std::string> endpoints(const std::string &prefix, int count)
+{
+  std::vector<std::string> urls;
+  for (int i = 0; i < count; ++i)
+  {
+    urls.push_back("tcp://" + prefix + ":" + std::to_string(i));
+  }
+  return urls;
+}
+} // namespace
+
+// =============================================
+// LoadBalancer Tests
+// =============================================
+
+TEST(LoadBalancerTest, RoundRobinTakesProvidersInTurn)
+{
+  LoadBalancer balancer(LoadBalancing::RoundRobin);
+  balancer.setEndpoints(endpoints("round-robin", 3));
+
+  std::vector<size_t> picks;
+  for (int i = 0; i < 6; ++i)
+  {
+    picks.push_back(balancer.pick());
+  }
+  EXPECT_EQ(picks, (std::vector<size_t>{0, 1, 2, 0, 1, 2}));
+}
+
+TEST(LoadBalancerTest, LeastOutstandingPrefersIdleProvider)
+{
+  LoadBalancer balancer(LoadBalancing::LeastOutstanding);
+  balancer.setEndpoints(endpoints("least-outstanding", 3));
+  balancer.load(0).start();
+  balancer.load(2).start();
+  balancer.load(2).start();
+
+  for (int i = 0; i < 5; ++i)
+  {
+    EXPECT_EQ(balancer.pick(), 1u);
+  }
+
+  // Ties are taken in turn
+  balancer.load(1).start();
+  balancer.load(1).start();
+  balancer.load(0).start();
+  std::map<size_t, int> counts;
+  for (int i = 0; i < 6; ++i)
+  {
+    ++counts[balancer.pick()];
+  }
+  EXPECT_EQ(counts.size(), 3u);
+}
+
+TEST(LoadBalancerTest, PowerOfTwoChoicesAvoidsSlowProvider)
+{
+  LoadBalancer balancer(LoadBalancing::PowerOfTwoChoices);
+  balancer.setEndpoints(endpoints("p2c", 2));
+
+  // A provider without samples is tried first
+  balancer.load(0).start();
+  balancer.load(0).finish(std::chrono::milliseconds(1));
+  EXPECT_EQ(balancer.pick(), 1u);
+
+  balancer.load(1).start();
+  balancer.load(1).finish(std::chrono::milliseconds(50));
+  for (int i = 0; i < 20; ++i)
+  {
+    EXPECT_EQ(balancer.pick(), 0u);
+  }
+
+  // Queued calls make the fast provider the more expensive one
+  for (int i = 0; i < 100; ++i)
+  {
+    balancer.load(0).start();
+  }
+  EXPECT_EQ(balancer.pick(), 1u);
+}
+
+TEST(LoadBalancerTest, StickyKeysMoveOnlyWithTheirProvider)
+{
+  LoadBalancer balancer(LoadBalancing::StickyKey);
+  std::vector<std::string> urls = endpoints("sticky", 4);
+  balancer.setEndpoints(urls);
+
+  std::map<std::string, std::string> placement;
+  std::map<std::string, int> per_provider;
+  for (int i = 0; i < 200; ++i)
+  {
+    std::string key = "robot" + std::to_string(i);
+    std::string url = urls[balancer.pick(key)];
+    EXPECT_EQ(urls[balancer.pick(key)], url);
+    placement[key] = url;
+    ++per_provider[url];
+  }
+  EXPECT_EQ(per_provider.size(), 4u);
+
+  // Dropping one provider only moves the keys it had
+  const std::string removed = urls[1];
+  urls.erase(urls.begin() + 1);
+  balancer.setEndpoints(urls);
+  for (const auto &[key, url] : placement)
+  {
+    std::string now = urls[balancer.pick(key)];
+    if (url != removed)
+    {
+      EXPECT_EQ(now, url) << key;
+    }
+  }
+}
+
+TEST(LoadBalancerTest, EndpointLoadAveragesLatency)
+{
+  auto load = EndpointLoad::of("tcp://ewma:0");
+  EXPECT_EQ(load, EndpointLoad::of("tcp://ewma:0"));
+  EXPECT_EQ(load->latency().count(), 0);
+
+  load->start();
+  EXPECT_EQ(load->outstanding(), 1u);
+  load->finish(std::chrono::microseconds(100));
+  EXPECT_EQ(load->outstanding(), 0u);
+  EXPECT_EQ(load->latency(), std::chrono::microseconds(100));
+
+  load->start();
+  load->finish(std::chrono::microseconds(200));
+  EXPECT_EQ(load->latency(), std::chrono::microseconds(120));
+}
+
+} // namespace zlc
@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <mutex>
+#include <set>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "zerolancom/zerolancom.hpp"
 
@@ -19,11 +24,32 @@ using namespace zlc_test;
 namespace
 {
 AsyncResult<std::string> g_string_result;
+std::atomic<int> g_int_count{0};
 
 void stringCallback(const std::string &msg)
 {
   g_string_result.set(msg);
 }
+
+void countingCallback(const int &)
+{
+  g_int_count++;
+}
+
+// Wait until the polling thread has closed every unregistered socket
+bool waitForSocketCount(size_t expected)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (ZMQContext::socketCount() != expected)
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  return true;
+}
 } // namespace
 
 // =============================================
@@ -38,6 +64,7 @@ protected:
     node_name_ = unique_name("PubSubTestNode");
     zlc::init(node_name_, "127.0.0.1");
     g_string_result.reset();
+    g_int_count = 0;
   }
 
   void TearDown() override
@@ -125,3 +152,764 @@ TEST_F(PubSubTest, LocalNamespaceTopic)
     GTEST_SKIP() << "Local pub/sub timed out";
   }
 }
+
+// =============================================
+// Pull Subscriber Tests
+//
+// The publisher is created first so that the subscriber finds it through the
+// local node info and connects without waiting for multicast discovery.
+// =============================================
+
+TEST_F(PubSubTest, PullSubscriberTakeInOrder)
+{
+  std::string topic = unique_name("PullTopic");
+
+  Publisher<std::string> pub(topic);
+  Subscriber<std::string> sub(topic);
+  EXPECT_EQ(sub.topic(), topic);
+
+  std::string msg;
+  EXPECT_FALSE(sub.take(msg));
+
+  // Allow the SUB socket to finish connecting
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  pub.publish("first");
+  pub.publish("second");
+  pub.publish("third");
+
+  std::vector<std::string> received;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (received.size() < 3 && std::chrono::steady_clock::now() < deadline)
+  {
+    if (sub.waitFor(std::chrono::milliseconds(100)) && sub.take(msg))
+    {
+      received.push_back(msg);
+    }
+  }
+
+  ASSERT_EQ(received.size(), 3u);
+  EXPECT_EQ(received[0], "first");
+  EXPECT_EQ(received[1], "second");
+  EXPECT_EQ(received[2], "third");
+  EXPECT_EQ(sub.dropped(), 0u);
+}
+
+TEST_F(PubSubTest, PullSubscriberTakeLatestAndOverflow)
+{
+  std::string topic = unique_name("PullLatestTopic");
+
+  Publisher<int> pub(topic);
+  Subscriber<int> sub(topic, 2);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  for (int i = 1; i <= 4; ++i)
+  {
+    pub.publish(i);
+  }
+
+  // Wait until the polling thread has seen every message
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (sub.pending() + sub.dropped() < 4 &&
+         std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  int latest = 0;
+  ASSERT_TRUE(sub.takeLatest(latest));
+  EXPECT_EQ(latest, 2); // queue holds the first two, later ones are dropped
+  EXPECT_EQ(sub.dropped(), 2u);
+  EXPECT_FALSE(sub.take(latest));
+}
+
+TEST_F(PubSubTest, PullSubscriberWaitForTimesOut)
+{
+  Subscriber<std::string> sub(unique_name("SilentTopic"));
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(sub.waitFor(std::chrono::milliseconds(50)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+// =============================================
+// Synchronizer Tests
+// =============================================
+
+TEST_F(PubSubTest, SynchronizerExactTimeOnEnvelopeStamps)
+{
+  std::string topic_a = unique_name("SyncTopicA");
+  std::string topic_b = unique_name("SyncTopicB");
+
+  Publisher<int> pub_a(topic_a);
+  Publisher<std::string> pub_b(topic_b);
+
+  AsyncResult<std::string> result;
+  Synchronizer<int, std::string> sync(
+      {topic_a, topic_b}, [&result](const int &a, const std::string &b)
+      { result.set(std::to_string(a) + ":" + b); }, SyncPolicy::ExactTime);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  auto t0 = std::chrono::system_clock::now();
+  auto t1 = t0 + std::chrono::milliseconds(100);
+
+  pub_a.publish(1, t0);   // no partner, discarded once t1 arrives on both
+  pub_a.publish(2, t1);
+  pub_b.publish("b", t1);
+
+  ASSERT_TRUE(result.wait_for(std::chrono::milliseconds(2000)));
+  EXPECT_EQ(result.get(), "2:b");
+  EXPECT_EQ(sync.matched(), 1u);
+  EXPECT_EQ(sync.dropped(), 1u);
+}
+
+TEST_F(PubSubTest, SynchronizerApproximateTimeWithKeyExtractor)
+{
+  std::string topic_a = unique_name("SyncKeyA");
+  std::string topic_b = unique_name("SyncKeyB");
+
+  Publisher<int> pub_a(topic_a);
+  Publisher<int> pub_b(topic_b);
+
+  AsyncResult<int> result;
+  auto identity = [](const int &v) { return static_cast<int64_t>(v); };
+  Synchronizer<int, int> sync(
+      {topic_a, topic_b}, {identity, identity},
+      [&result](const int &a, const int &b) { result.set(a * 1000 + b); },
+      SyncPolicy::ApproximateTime, 10, std::chrono::nanoseconds(5));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  // Spaced out so that the two topics cannot be delivered out of order
+  pub_a.publish(100);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  pub_b.publish(120); // too far from 100, so 100 is discarded
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  pub_a.publish(118); // within 5 of 120
+
+  ASSERT_TRUE(result.wait_for(std::chrono::milliseconds(2000)));
+  EXPECT_EQ(result.get(), 118 * 1000 + 120);
+  EXPECT_EQ(sync.matched(), 1u);
+}
+
+// =============================================
+// Unsubscribe Tests
+// =============================================
+
+TEST_F(PubSubTest, UnregisterStopsDeliveryAndReleasesSocket)
+{
+  std::string topic = unique_name("UnsubTopic");
+  Publisher<int> pub(topic);
+  const size_t baseline_sockets = ZMQContext::socketCount();
+  const size_t baseline_subs = SubscriberManager::instance().subscriptionCount();
+
+  SubscriptionId id = registerSubscriberHandler(topic, countingCallback);
+  EXPECT_NE(id, 0u);
+  EXPECT_EQ(ZMQContext::socketCount(), baseline_sockets + 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  pub.publish(1);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (g_int_count == 0 && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  ASSERT_EQ(g_int_count.load(), 1);
+
+  EXPECT_TRUE(unregisterSubscriberHandler(id));
+  EXPECT_FALSE(unregisterSubscriberHandler(id));
+  EXPECT_EQ(SubscriberManager::instance().subscriptionCount(), baseline_subs);
+  EXPECT_TRUE(waitForSocketCount(baseline_sockets));
+
+  pub.publish(2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  EXPECT_EQ(g_int_count.load(), 1);
+}
+
+TEST_F(PubSubTest, SubscriptionHandlesKeepSocketCountFlat)
+{
+  std::string topic = unique_name("ChurnTopic");
+  Publisher<int> pub(topic);
+  const size_t baseline_sockets = ZMQContext::socketCount();
+
+  for (int i = 0; i < 50; ++i)
+  {
+    Subscriber<int> sub(topic, 4);
+    Subscription handle(registerSubscriberHandler(topic, countingCallback));
+    EXPECT_TRUE(handle.valid());
+  }
+
+  EXPECT_TRUE(waitForSocketCount(baseline_sockets));
+
+  Subscription moved;
+  {
+    Subscription handle(registerSubscriberHandler(topic, countingCallback));
+    moved = std::move(handle);
+    EXPECT_FALSE(handle.valid());
+  }
+  EXPECT_TRUE(moved.valid());
+  moved.reset();
+  EXPECT_FALSE(moved.valid());
+  EXPECT_TRUE(waitForSocketCount(baseline_sockets));
+}
+
+// =============================================
+// Sharded Subscriber Tests
+// =============================================
+
+class ShardedPubSubTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    NodeOptions options;
+    options.subscriber_shards = 3;
+    options.topic_affinity["sharded/a"] = 0;
+    options.topic_affinity["sharded/b"] = 2;
+    zlc::init(unique_name("ShardedNode"), "127.0.0.1", options);
+  }
+
+  void TearDown() override
+  {
+    zlc::shutdown();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+};
+
+TEST_F(ShardedPubSubTest, ThreadPoolSizedForShards)
+{
+  EXPECT_EQ(SubscriberManager::instance().shardCount(), 3u);
+  // Five long-running loops plus one per shard
+  EXPECT_EQ(ThreadPool::instance().size(), 8u);
+}
+
+TEST_F(ShardedPubSubTest, TopicsAssignedByAffinityAndHash)
+{
+  auto &manager = SubscriberManager::instance();
+  EXPECT_EQ(manager.shardForTopic("sharded/a"), 0u);
+  EXPECT_EQ(manager.shardForTopic("sharded/b"), 2u);
+
+  // Hash placement is stable
+  size_t shard = manager.shardForTopic("some/other/topic");
+  EXPECT_LT(shard, 3u);
+  EXPECT_EQ(manager.shardForTopic("some/other/topic"), shard);
+
+  manager.setTopicAffinity("some/other/topic", (shard + 1) % 3);
+  EXPECT_EQ(manager.shardForTopic("some/other/topic"), (shard + 1) % 3);
+}
+
+TEST_F(ShardedPubSubTest, ShardsDispatchOnSeparateThreads)
+{
+  Publisher<int> pub_a("sharded/a");
+  Publisher<int> pub_b("sharded/b");
+
+  AsyncResult<std::thread::id> thread_a;
+  AsyncResult<std::thread::id> thread_b;
+  auto &manager = SubscriberManager::instance();
+  Subscription sub_a(manager.registerRawTopicSubscriber(
+      "sharded/a", [&thread_a](const MessageHeader &, const ByteView &)
+      { thread_a.set(std::this_thread::get_id()); }));
+  Subscription sub_b(manager.registerRawTopicSubscriber(
+      "sharded/b", [&thread_b](const MessageHeader &, const ByteView &)
+      { thread_b.set(std::this_thread::get_id()); }));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  pub_a.publish(1);
+  pub_b.publish(2);
+
+  ASSERT_TRUE(thread_a.wait_for(std::chrono::milliseconds(2000)));
+  ASSERT_TRUE(thread_b.wait_for(std::chrono::milliseconds(2000)));
+  EXPECT_NE(thread_a.get(), thread_b.get());
+}
+
+// =============================================
+// Lifespan / Deadline Tests
+// =============================================
+
+TEST_F(PubSubTest, LifespanDropsStaleMessagesBeforeDecode)
+{
+  std::string topic = unique_name("LifespanTopic");
+  Publisher<int> pub(topic);
+
+  SubscribeOptions options;
+  options.lifespan = std::chrono::milliseconds(500);
+  Subscriber<int> sub(topic, 16, options);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  // Stamped two seconds in the past: expired on arrival
+  pub.publish(1, std::chrono::system_clock::now() - std::chrono::seconds(2));
+  pub.publish(2);
+
+  ASSERT_TRUE(sub.waitFor(std::chrono::milliseconds(2000)));
+  int value = 0;
+  ASSERT_TRUE(sub.take(value));
+  EXPECT_EQ(value, 2);
+  EXPECT_FALSE(sub.take(value));
+
+  TopicStatistics stats = topicStatistics(topic);
+  EXPECT_EQ(stats.received, 1u);
+  EXPECT_EQ(stats.expired, 1u);
+}
+
+TEST_F(PubSubTest, DeadlineMissedCallbackFires)
+{
+  std::string topic = unique_name("DeadlineTopic");
+  Publisher<int> pub(topic);
+
+  AsyncResult<std::string> missed;
+  SubscribeOptions options;
+  options.deadline = std::chrono::milliseconds(100);
+  options.on_deadline_missed = [&missed](const std::string &name) { missed.set(name); };
+  Subscription sub(registerSubscriberHandler(topic, countingCallback, options));
+
+  ASSERT_TRUE(missed.wait_for(std::chrono::milliseconds(1000)));
+  EXPECT_EQ(missed.get(), topic);
+  EXPECT_GE(topicStatistics(topic).deadline_missed, 1u);
+}
+
+// =============================================
+// Flow Control Tests
+// =============================================
+
+namespace
+{
+std::atomic<bool> g_gate_open{true};
+
+// Stalls the polling thread until the gate opens, like a slow consumer
+void gatedCallback(const int &)
+{
+  while (!g_gate_open)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  g_int_count++;
+}
+
+// Pump the credit channel until the subscribers' HELLO has been processed
+bool waitForFlowControlledSubscribers(Publisher<int> &pub, size_t expected)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (pub.flowControlledSubscribers() != expected)
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return false;
+    }
+    pub.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  return true;
+}
+} // namespace
+
+TEST_F(PubSubTest, FlowControlDeliversEveryMessage)
+{
+  std::string topic = unique_name("FlowTopic");
+  FlowControlOptions flow;
+  flow.enabled = true;
+  Publisher<int> pub(topic, false, flow);
+
+  SubscribeOptions options;
+  options.flow_control_window = 8;
+  Subscription sub(registerSubscriberHandler(topic, countingCallback, options));
+  ASSERT_TRUE(waitForFlowControlledSubscribers(pub, 1));
+
+  // Far more than the window and the ZMQ high-water marks would absorb
+  const int total = 2000;
+  for (int i = 0; i < total; ++i)
+  {
+    ASSERT_EQ(pub.publish(i), PublishStatus::Ok);
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (g_int_count < total && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_EQ(g_int_count.load(), total);
+}
+
+TEST_F(PubSubTest, FlowControlWouldBlockOnSlowSubscriber)
+{
+  std::string topic = unique_name("FlowSlowTopic");
+  FlowControlOptions flow;
+  flow.enabled = true;
+  flow.policy = OverflowPolicy::WouldBlock;
+  Publisher<int> pub(topic, false, flow);
+
+  g_gate_open = false;
+  SubscribeOptions options;
+  options.flow_control_window = 4;
+  Subscription sub(registerSubscriberHandler(topic, gatedCallback, options));
+  ASSERT_TRUE(waitForFlowControlledSubscribers(pub, 1));
+
+  int accepted = 0;
+  while (accepted < 100 && pub.publish(accepted) == PublishStatus::Ok)
+  {
+    ++accepted;
+  }
+  EXPECT_EQ(accepted, 4);
+
+  g_gate_open = true;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (g_int_count < accepted && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_EQ(g_int_count.load(), accepted);
+}
+
+TEST_F(PubSubTest, FlowControlBufferRespectsByteBudget)
+{
+  std::string topic = unique_name("FlowBufferTopic");
+  FlowControlOptions flow;
+  flow.enabled = true;
+  flow.policy = OverflowPolicy::Buffer;
+  flow.max_buffered_bytes = 64;
+  Publisher<int> pub(topic, false, flow);
+
+  g_gate_open = false;
+  SubscribeOptions options;
+  options.flow_control_window = 2;
+  Subscription sub(registerSubscriberHandler(topic, gatedCallback, options));
+  ASSERT_TRUE(waitForFlowControlledSubscribers(pub, 1));
+
+  int accepted = 0;
+  PublishStatus status = PublishStatus::Ok;
+  while (accepted < 1000 && status != PublishStatus::WouldBlock)
+  {
+    status = pub.publish(accepted);
+    accepted += status == PublishStatus::WouldBlock ? 0 : 1;
+    EXPECT_LE(pub.bufferedBytes(), flow.max_buffered_bytes);
+  }
+  EXPECT_EQ(status, PublishStatus::WouldBlock);
+  EXPECT_GT(pub.bufferedBytes(), 0u);
+
+  // Buffered messages drain as the subscriber grants credit again
+  g_gate_open = true;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+  while (g_int_count < accepted && std::chrono::steady_clock::now() < deadline)
+  {
+    pub.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_EQ(g_int_count.load(), accepted);
+  EXPECT_EQ(pub.bufferedBytes(), 0u);
+}
+
+// =============================================
+// Consumer Group Tests
+// =============================================
+
+namespace
+{
+constexpr int WORK_ITEMS = 300;
+std::array<std::atomic<int>, 3> g_worker_count{};
+std::array<std::atomic<int>, WORK_ITEMS> g_work_hits{};
+
+template <int N> void workerCallback(const int &item)
+{
+  g_worker_count[N]++;
+  g_work_hits[item]++;
+}
+} // namespace
+
+TEST_F(PubSubTest, ConsumerGroupDeliversEachMessageToOneMember)
+{
+  std::string topic = unique_name("WorkTopic");
+  FlowControlOptions flow;
+  flow.enabled = true;
+  Publisher<int> pub(topic, false, flow);
+
+  for (auto &count : g_worker_count)
+    count = 0;
+  for (auto &hits : g_work_hits)
+    hits = 0;
+
+  SubscribeOptions workers;
+  workers.consumer_group = "workers";
+  Subscription w0(registerSubscriberHandler(topic, workerCallback<0>, workers));
+  Subscription w1(registerSubscriberHandler(topic, workerCallback<1>, workers));
+  Subscription w2(registerSubscriberHandler(topic, workerCallback<2>, workers));
+
+  // A second group receives its own copy of every message
+  SubscribeOptions audit;
+  audit.consumer_group = "audit";
+  Subscription auditor(registerSubscriberHandler(topic, countingCallback, audit));
+
+  ASSERT_TRUE(waitForFlowControlledSubscribers(pub, 4));
+  EXPECT_EQ(pub.consumerGroups(), 2u);
+
+  for (int i = 0; i < WORK_ITEMS; ++i)
+  {
+    ASSERT_EQ(pub.publish(i), PublishStatus::Ok);
+  }
+
+  auto worked = []()
+  { return g_worker_count[0] + g_worker_count[1] + g_worker_count[2]; };
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while ((worked() < WORK_ITEMS || g_int_count < WORK_ITEMS) &&
+         std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  EXPECT_EQ(worked(), WORK_ITEMS);
+  EXPECT_EQ(g_int_count.load(), WORK_ITEMS);
+  for (int i = 0; i < WORK_ITEMS; ++i)
+  {
+    EXPECT_EQ(g_work_hits[i].load(), 1) << "item " << i;
+  }
+  for (const auto &count : g_worker_count)
+  {
+    EXPECT_GT(count.load(), 0);
+  }
+}
+
+TEST_F(PubSubTest, CreditFromUnknownSubscriberRequestsRejoin)
+{
+  FlowControlOptions flow;
+  flow.enabled = true;
+  CreditChannel channel("127.0.0.1", flow);
+
+  ZMQSocket dealer = ZMQContext::createTempSocket(zmq::socket_type::dealer);
+  dealer.set(zmq::sockopt::rcvtimeo, 50);
+  dealer.connect("tcp://127.0.0.1:" + std::to_string(channel.port()));
+
+  // Credit without HELLO, e.g. from a subscriber that timed out
+  CreditMessage credit;
+  credit.credits = 8;
+  Bytes bytes = credit.encode();
+  dealer.send(zmq::buffer(bytes), zmq::send_flags::none);
+
+  zmq::message_t reply;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  bool received = false;
+  while (!received && std::chrono::steady_clock::now() < deadline)
+  {
+    channel.flush();
+    received = dealer.recv(reply, zmq::recv_flags::none).has_value();
+  }
+  ASSERT_TRUE(received);
+  CreditMessage rejoin =
+      CreditMessage::decode(static_cast<const uint8_t *>(reply.data()), reply.size());
+  EXPECT_EQ(rejoin.type, CreditMessage::Rejoin);
+  EXPECT_EQ(channel.peerCount(), 0u);
+
+  // HELLO re-admits the subscriber with its group
+  CreditMessage hello;
+  hello.type = CreditMessage::Hello;
+  hello.credits = 8;
+  hello.group = "workers";
+  bytes = hello.encode();
+  dealer.send(zmq::buffer(bytes), zmq::send_flags::none);
+
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (channel.peerCount() == 0 && std::chrono::steady_clock::now() < deadline)
+  {
+    channel.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(channel.peerCount(), 1u);
+  EXPECT_EQ(channel.groupCount(), 1u);
+  dealer.close();
+}
+
+// =============================================
+// Pattern Subscription Tests
+// =============================================
+
+namespace
+{
+std::mutex g_pattern_mutex;
+std::set<std::string> g_pattern_topics;
+
+void patternCallback(const std::string &topic, const int &)
+{
+  std::lock_guard<std::mutex> lock(g_pattern_mutex);
+  g_pattern_topics.insert(topic);
+}
+
+std::set<std::string> patternTopics()
+{
+  std::lock_guard<std::mutex> lock(g_pattern_mutex);
+  return g_pattern_topics;
+}
+} // namespace
+
+TEST_F(PubSubTest, PatternSubscriptionConnectsPublishersAsTheyAppear)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_pattern_mutex);
+    g_pattern_topics.clear();
+  }
+
+  std::string robot = unique_name("robot");
+  auto &manager = SubscriberManager::instance();
+  const size_t baseline_subs = manager.subscriptionCount();
+
+  // Registered before any matching publisher exists
+  Subscription sub(
+      manager.registerPatternSubscriber(robot + "/sensors/*", patternCallback));
+  EXPECT_EQ(manager.subscriptionCount(), baseline_subs + 1);
+
+  Publisher<int> imu(robot + "/sensors/imu");
+  Publisher<int> gps(robot + "/sensors/gps");
+  Publisher<int> arm(robot + "/actuators/arm");
+
+  // Deliver the discovery event the node's own heartbeat would trigger
+  manager.updateTopicSubscriber(NodeInfoManager::instance().getLocalNodeInfo());
+
+  // A pattern registered afterwards finds the existing publishers itself
+  Subscription late(
+      manager.registerPatternSubscriber(robot + "/*/arm", patternCallback));
+
+  const std::set<std::string> expected{robot + "/actuators/arm", robot + "/sensors/gps",
+                                       robot + "/sensors/imu"};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (patternTopics() != expected && std::chrono::steady_clock::now() < deadline)
+  {
+    imu.publish(1);
+    gps.publish(2);
+    arm.publish(3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  EXPECT_EQ(patternTopics(), expected);
+
+  // One registration per pattern from the caller's point of view
+  EXPECT_EQ(manager.subscriptionCount(), baseline_subs + 2);
+
+  const size_t sockets = ZMQContext::socketCount();
+  sub.reset();
+  late.reset();
+  EXPECT_EQ(manager.subscriptionCount(), baseline_subs);
+  EXPECT_TRUE(waitForSocketCount(sockets - 3));
+}
+
+TEST_F(PubSubTest, PatternTopicRetiredWithItsLastPublisher)
+{
+  std::string robot = unique_name("robot");
+  auto &manager = SubscriberManager::instance();
+  Subscription sub(manager.registerPatternSubscriber(robot + "/*", patternCallback));
+
+  Publisher<int> imu(robot + "/imu");
+  const size_t sockets = ZMQContext::socketCount();
+  NodeInfo node = NodeInfoManager::instance().getLocalNodeInfo();
+  manager.updateTopicSubscriber(node);
+  EXPECT_EQ(ZMQContext::socketCount(), sockets + 1);
+
+  // The publishing node goes away: the pattern's entry for the topic is closed
+  node.topics.erase(std::remove_if(node.topics.begin(), node.topics.end(),
+                                   [&](const SocketInfo &info)
+                                   { return info.name != robot + "/imu"; }),
+                    node.topics.end());
+  manager.removeTopicSubscriber(node);
+  EXPECT_TRUE(waitForSocketCount(sockets));
+
+  // and created again when the topic is published once more
+  manager.updateTopicSubscriber(node);
+  EXPECT_EQ(ZMQContext::socketCount(), sockets + 1);
+}
+
+// =============================================
+// Key Filter Tests
+// =============================================
+
+namespace
+{
+std::string cameraKey(const int &value)
+{
+  return "cam" + std::to_string(value % 3);
+}
+
+std::vector<int> takeAll(Subscriber<int> &sub)
+{
+  std::vector<int> values;
+  int value = 0;
+  while (sub.take(value))
+  {
+    values.push_back(value);
+  }
+  return values;
+}
+} // namespace
+
+TEST_F(PubSubTest, KeyFilterOnlyDeliversMatchingMessages)
+{
+  std::string topic = unique_name("KeyedTopic");
+  Publisher<int> pub(topic);
+  pub.setKeyExtractor(cameraKey);
+
+  SubscribeOptions cam1;
+  cam1.keys = {"cam1"};
+  SubscribeOptions cam0_cam2;
+  cam0_cam2.keys = {"cam0", "cam2"};
+
+  Subscriber<int> only_cam1(topic, 64, cam1);
+  Subscriber<int> others(topic, 64, cam0_cam2);
+  Subscriber<int> everything(topic, 64);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  for (int i = 0; i < 30; ++i)
+  {
+    pub.publish(i);
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (everything.pending() < 30 && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  std::vector<int> cam1_values = takeAll(only_cam1);
+  std::vector<int> other_values = takeAll(others);
+  EXPECT_EQ(takeAll(everything).size(), 30u);
+  EXPECT_EQ(cam1_values.size(), 10u);
+  EXPECT_EQ(other_values.size(), 20u);
+  for (int value : cam1_values)
+  {
+    EXPECT_EQ(value % 3, 1);
+  }
+  for (int value : other_values)
+  {
+    EXPECT_NE(value % 3, 1);
+  }
+}
+
+TEST_F(PubSubTest, KeyFilterWithFlowControlCostsNoCredit)
+{
+  std::string topic = unique_name("KeyedFlowTopic");
+  FlowControlOptions flow;
+  flow.enabled = true;
+  flow.policy = OverflowPolicy::WouldBlock;
+  Publisher<int> pub(topic, false, flow);
+  pub.setKeyExtractor(cameraKey);
+
+  // Blocked subscriber: credit is only returned once the gate opens
+  g_gate_open = false;
+  SubscribeOptions options;
+  options.flow_control_window = 4;
+  options.keys = {"cam1"};
+  Subscription sub(registerSubscriberHandler(topic, gatedCallback, options));
+  ASSERT_TRUE(waitForFlowControlledSubscribers(pub, 1));
+
+  // Messages for other cameras do not consume the subscriber's window
+  int accepted = 0;
+  while (accepted < 100 && pub.publish(accepted) == PublishStatus::Ok)
+  {
+    ++accepted;
+  }
+  EXPECT_EQ(accepted, 3 * 4 + 1); // the 5th cam1 message is rejected
+
+  g_gate_open = true;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (g_int_count < 4 && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(g_int_count.load(), 4);
+}
@@ -1,11 +1,17 @@
 #include <gtest/gtest.h>
 
 #include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "zerolancom/serialization/msppack_codec.hpp"
+#include "zerolancom/sockets/flow_control.hpp"
+#include "zerolancom/sockets/message_header.hpp"
 #include "zerolancom/utils/message.hpp"
+#include "zerolancom/utils/request_result.hpp"
 
 using namespace zlc;
 
@@ -334,3 +340,163 @@ TEST(SerializationTest, LargeVectorRoundTrip)
 
   EXPECT_EQ(decoded, original);
 }
+
+// =============================================
+// Wire Format Tests
+// =============================================
+
+TEST(SerializationTest, MessageKeyFrameRoundTrip)
+{
+  std::string frame = MessageKey::encode("cam1");
+  const auto *data = reinterpret_cast<const uint8_t *>(frame.data());
+
+  ASSERT_TRUE(MessageKey::isKeyFrame(data, frame.size()));
+  EXPECT_EQ(MessageKey::decode(data, frame.size()), "cam1");
+
+  // A key is never a prefix of a longer key's frame
+  EXPECT_NE(MessageKey::encode("cam10").rfind(frame, 0), 0u);
+
+  // Envelope frames are not mistaken for key frames
+  auto header = MessageHeader{}.encode();
+  EXPECT_FALSE(MessageKey::isKeyFrame(header.data(), header.size()));
+}
+
+TEST(SerializationTest, CreditHelloCarriesGroupAndKeys)
+{
+  CreditMessage hello;
+  hello.type = CreditMessage::Hello;
+  hello.credits = 16;
+  hello.group = "workers";
+  hello.keys = {"cam1", "cam2"};
+
+  Bytes bytes = hello.encode();
+  CreditMessage decoded = CreditMessage::decode(bytes.data(), bytes.size());
+  EXPECT_EQ(decoded.type, CreditMessage::Hello);
+  EXPECT_EQ(decoded.credits, 16u);
+  EXPECT_EQ(decoded.group, "workers");
+  EXPECT_EQ(decoded.keys, hello.keys);
+
+  // Plain credit messages keep the fixed size
+  CreditMessage credit;
+  credit.credits = 3;
+  EXPECT_EQ(credit.encode().size(), CreditMessage::SIZE);
+
+  bytes.pop_back();
+  EXPECT_THROW(CreditMessage::decode(bytes.data(), bytes.size()), std::runtime_error);
+}
+
+TEST(SerializationTest, StringViewReferencesInput)
+{
+  ByteBuffer out;
+  encode(std::string("payload"), out);
+
+  std::string_view view;
+  decodeInPlace(ByteView{out.data, out.size}, view);
+  EXPECT_EQ(view, "payload");
+  EXPECT_GE(reinterpret_cast<const uint8_t *>(view.data()), out.data);
+  EXPECT_LT(reinterpret_cast<const uint8_t *>(view.data()), out.data + out.size);
+}
+
+TEST(SerializationTest, ByteBufferReleasesMemory)
+{
+  ByteBuffer out;
+  encode(std::string("payload"), out);
+  size_t size = out.size;
+
+  uint8_t *data = out.release();
+  EXPECT_EQ(out.data, nullptr);
+  EXPECT_EQ(out.size, 0u);
+
+  std::string decoded;
+  decode(ByteView{data, size}, decoded);
+  EXPECT_EQ(decoded, "payload");
+  std::free(data);
+}
+
+TEST(SerializationTest, ServiceHeaderCarriesBudget)
+{
+  Bytes header = encodeServiceHeader("add", 1500);
+  ByteView view{header.data(), header.size()};
+  EXPECT_EQ(decodeServiceHeader(view), "add");
+  EXPECT_EQ(decodeServiceBudget(view), 1500u);
+
+  // Headers from older clients carry no budget
+  std::string plain = "add";
+  ByteView old{reinterpret_cast<const uint8_t *>(plain.data()), plain.size()};
+  EXPECT_EQ(decodeServiceHeader(old), "add");
+  EXPECT_EQ(decodeServiceBudget(old), 0u);
+  EXPECT_EQ(encodeServiceHeader("add", 0).size(), plain.size());
+}
+
+TEST(SerializationTest, CompactServiceHeaderCarriesId)
+{
+  Bytes header = encodeServiceHeader(7u, 1500);
+  ByteView view{header.data(), header.size()};
+  EXPECT_EQ(header.size(), 9u);
+  EXPECT_EQ(decodeServiceId(view), 7u);
+  EXPECT_EQ(decodeServiceBudget(view), 1500u);
+  EXPECT_EQ(decodeServiceHeader(view), "");
+
+  // Named headers have no id, whatever their length
+  Bytes named = encodeServiceHeader("add", 1500);
+  EXPECT_EQ(named.size(), 8u);
+  EXPECT_EQ(decodeServiceId(ByteView{named.data(), named.size()}), 0u);
+  Bytes nine = encodeServiceHeader("abcd", 1500);
+  EXPECT_EQ(decodeServiceId(ByteView{nine.data(), nine.size()}), 0u);
+  EXPECT_EQ(decodeServiceBudget(ByteView{nine.data(), nine.size()}), 1500u);
+}
+
+TEST(SerializationTest, ServiceHeaderCarriesFlags)
+{
+  Bytes compact = encodeServiceHeader(7u, 0, SERVICE_FLAG_ONE_WAY);
+  ByteView view{compact.data(), compact.size()};
+  EXPECT_EQ(compact.size(), 10u);
+  EXPECT_EQ(decodeServiceId(view), 7u);
+  EXPECT_EQ(decodeServiceBudget(view), 0u);
+  EXPECT_EQ(decodeServiceFlags(view), SERVICE_FLAG_ONE_WAY);
+
+  Bytes named = encodeServiceHeader("add", 0, SERVICE_FLAG_ONE_WAY);
+  view = ByteView{named.data(), named.size()};
+  EXPECT_EQ(decodeServiceHeader(view), "add");
+  EXPECT_EQ(decodeServiceId(view), 0u);
+  EXPECT_EQ(decodeServiceBudget(view), 0u);
+  EXPECT_EQ(decodeServiceFlags(view), SERVICE_FLAG_ONE_WAY);
+
+  // Headers without flags are unchanged
+  Bytes plain = encodeServiceHeader("add", 1500);
+  EXPECT_EQ(decodeServiceFlags(ByteView{plain.data(), plain.size()}), 0u);
+  EXPECT_EQ(encodeServiceHeader(7u, 1500).size(), 9u);
+}
+
+TEST(SerializationTest, StatusHasOneByteWireForm)
+{
+  uint8_t status = 0xFF;
+  ASSERT_TRUE(encodeStatus(ResponseStatus::SERVICE_TIMEOUT, status));
+  EXPECT_EQ(decodeStatus(ByteView{&status, 1}), ResponseStatus::SERVICE_TIMEOUT);
+  ASSERT_TRUE(encodeStatus(ResponseStatus::SUCCESS, status));
+  EXPECT_EQ(decodeStatus(ByteView{&status, 1}), ResponseStatus::SUCCESS);
+  ASSERT_TRUE(encodeStatus(ResponseStatus::OVERLOADED, status));
+  EXPECT_EQ(decodeStatus(ByteView{&status, 1}), ResponseStatus::OVERLOADED);
+
+  // Other codes travel as strings, as do all codes from older servers
+  EXPECT_FALSE(encodeStatus("QUOTA_EXCEEDED", status));
+  std::string text(ResponseStatus::SERVICE_FAIL);
+  ByteView view{reinterpret_cast<const uint8_t *>(text.data()), text.size()};
+  EXPECT_EQ(decodeStatus(view), ResponseStatus::SERVICE_FAIL);
+
+  uint8_t unknown = 200;
+  EXPECT_EQ(decodeStatus(ByteView{&unknown, 1}), ResponseStatus::UNKNOWN_ERROR);
+}
+
+TEST(SerializationTest, StreamCreditPrefixesRequest)
+{
+  Bytes request = {1, 2, 3};
+  Bytes bytes = encodeStreamCredit(16, ByteView{request.data(), request.size()});
+  ByteView view{bytes.data(), bytes.size()};
+  EXPECT_EQ(decodeStreamCredit(view), 16u);
+  EXPECT_EQ(Bytes(view.begin(), view.end()), request);
+
+  Bytes credit = encodeStreamCredit(0);
+  ByteView short_view{credit.data(), 3};
+  EXPECT_THROW(decodeStreamCredit(short_view), DecodeException);
+}
@@ -1,7 +1,14 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "zerolancom/nodes/zerolancom_node.hpp"
 #include "zerolancom/serialization/msppack_codec.hpp"
@@ -301,3 +308,1234 @@ TEST_F(ServiceTest, HighLevelRequest_StringToString)
 
   EXPECT_EQ(response, "high:level");
 }
+
+// =============================================
+// Concurrent Execution Tests
+// =============================================
+
+namespace
+{
+std::atomic<int> g_running{0};
+std::atomic<int> g_max_running{0};
+std::atomic<int> g_started{0};
+
+std::string slowHandler(const std::string &msg)
+{
+  ++g_started;
+  int running = ++g_running;
+  int seen = g_max_running.load();
+  while (running > seen && !g_max_running.compare_exchange_weak(seen, running))
+  {
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  --g_running;
+  return "slow:" + msg;
+}
+
+std::string fastHandler(const std::string &msg)
+{
+  return "fast:" + msg;
+}
+
+std::string callService(const std::string &service)
+{
+  std::string response;
+  Client::zlcRequest<const std::string &, std::string>(service, "x", response);
+  return response;
+}
+} // namespace
+
+class ConcurrentServiceTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    g_running = 0;
+    g_max_running = 0;
+    g_started = 0;
+
+    NodeOptions options;
+    options.service_workers = 4;
+    zlc::init(unique_name("ConcurrentServiceNode"), "127.0.0.1", options);
+  }
+
+  void TearDown() override
+  {
+    zlc::shutdown();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+};
+
+TEST_F(ConcurrentServiceTest, SlowServiceDoesNotBlockOthers)
+{
+  std::string slow = unique_name("SlowService");
+  std::string fast = unique_name("FastService");
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::registerServiceHandler(fast, fastHandler);
+  zlc::waitForService(slow, 1000);
+  zlc::waitForService(fast, 1000);
+
+  std::thread slow_call([&slow]() { EXPECT_EQ(callService(slow), "slow:x"); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(callService(fast), "fast:x");
+
+  NodeInfo info;
+  Client::zlcRequest<Empty, NodeInfo>(
+      "get_node_info",
+      "tcp://127.0.0.1:" + std::to_string(ServiceManager::instance().service_port),
+      empty, info);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(info.name, NodeInfoManager::instance().getLocalNodeInfo().name);
+  EXPECT_LT(elapsed, std::chrono::milliseconds(120));
+  slow_call.join();
+}
+
+TEST_F(ConcurrentServiceTest, NodeInfoIsServedWhileWorkersAreBusy)
+{
+  std::string slow = unique_name("BusyService");
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  // Twice as many calls as workers, so requests queue up
+  std::vector<std::thread> calls;
+  for (int i = 0; i < 8; ++i)
+  {
+    calls.emplace_back([&slow]() { EXPECT_EQ(callService(slow), "slow:x"); });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  auto start = std::chrono::steady_clock::now();
+  NodeInfo info;
+  Client::zlcRequest<Empty, NodeInfo>(
+      "get_node_info",
+      "tcp://127.0.0.1:" + std::to_string(NodeInfoManager::instance().controlPort()),
+      empty, info);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(info.name, NodeInfoManager::instance().getLocalNodeInfo().name);
+  EXPECT_LT(elapsed, std::chrono::milliseconds(100));
+  EXPECT_NE(NodeInfoManager::instance().controlPort(),
+            ServiceManager::instance().service_port);
+  for (auto &call : calls)
+  {
+    call.join();
+  }
+}
+
+TEST_F(ConcurrentServiceTest, RequestsRunInParallel)
+{
+  std::string slow = unique_name("ParallelService");
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> calls;
+  for (int i = 0; i < 4; ++i)
+  {
+    calls.emplace_back([&slow]() { EXPECT_EQ(callService(slow), "slow:x"); });
+  }
+  for (auto &call : calls)
+  {
+    call.join();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_GE(g_max_running.load(), 2);
+  EXPECT_LT(elapsed, std::chrono::milliseconds(600));
+}
+
+TEST_F(ConcurrentServiceTest, ConcurrencyLimitQueuesRequests)
+{
+  std::string slow = unique_name("LimitedService");
+  ServiceManager::instance().setConcurrencyLimit(slow, 1);
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  std::vector<std::thread> calls;
+  for (int i = 0; i < 3; ++i)
+  {
+    calls.emplace_back([&slow]() { EXPECT_EQ(callService(slow), "slow:x"); });
+  }
+  for (auto &call : calls)
+  {
+    call.join();
+  }
+
+  EXPECT_EQ(g_max_running.load(), 1);
+}
+
+// =============================================
+// Latency Tests
+// =============================================
+
+TEST_F(ServiceTest, IdleRoundTripHasNoPollingDelay)
+{
+  std::string service = unique_name("LatencyService");
+  zlc::registerServiceHandler(service, fastHandler);
+  zlc::waitForService(service, 1000);
+
+  // Reuse one connection so that only request handling is measured
+  ZMQSocket socket = ZMQContext::createTempSocket(zmq::socket_type::req);
+  socket.connect("tcp://127.0.0.1:" +
+                 std::to_string(ServiceManager::instance().service_port));
+
+  std::vector<std::chrono::nanoseconds> samples;
+  for (int i = 0; i < 50; ++i)
+  {
+    ByteBuffer out;
+    encode(std::string("x"), out);
+
+    auto start = std::chrono::steady_clock::now();
+    Client::sendRequest(service, ByteView{out.data, out.size}, socket);
+    zmq::message_t payload;
+    Client::receiveResponse(socket, payload, service);
+    samples.push_back(std::chrono::steady_clock::now() - start);
+
+    ASSERT_GT(payload.size(), 0u);
+  }
+  socket.close();
+
+  std::sort(samples.begin(), samples.end());
+  // The old loop slept 100 ms between polls; leave headroom for slow CI hosts
+  EXPECT_LT(samples[samples.size() / 2], std::chrono::milliseconds(2));
+}
+
+TEST_F(ServiceTest, MalformedRequestGetsInvalidRequest)
+{
+  std::string service = unique_name("MalformedService");
+  zlc::registerServiceHandler(service, fastHandler);
+  zlc::waitForService(service, 1000);
+
+  ZMQSocket socket = ZMQContext::createTempSocket(zmq::socket_type::req);
+  socket.set(zmq::sockopt::rcvtimeo, 1000);
+  socket.connect("tcp://127.0.0.1:" +
+                 std::to_string(ServiceManager::instance().service_port));
+
+  // Service name without a payload frame
+  socket.send(zmq::buffer(service), zmq::send_flags::none);
+  zmq::message_t code;
+  ASSERT_TRUE(socket.recv(code, zmq::recv_flags::none));
+  EXPECT_EQ(code.to_string(), ResponseStatus::INVALID_REQUEST);
+  zmq::message_t payload;
+  ASSERT_TRUE(code.more());
+  ASSERT_TRUE(socket.recv(payload, zmq::recv_flags::none));
+
+  // The frontend is still in sync for the next request on the same socket
+  ByteBuffer out;
+  encode(std::string("x"), out);
+  Client::sendRequest(service, ByteView{out.data, out.size}, socket);
+  Client::receiveResponse(socket, payload, service);
+  EXPECT_GT(payload.size(), 0u);
+  socket.close();
+}
+
+// =============================================
+// Asynchronous Client Tests
+// =============================================
+
+TEST_F(ConcurrentServiceTest, AsyncRequestsArePipelined)
+{
+  std::string service = unique_name("AsyncService");
+  zlc::registerServiceHandler(
+      service, +[](const int &value) { return value * 2; });
+  zlc::waitForService(service, 1000);
+
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 200; ++i)
+  {
+    futures.push_back(Client::requestAsync<int, int>(service, i));
+  }
+  for (int i = 0; i < 200; ++i)
+  {
+    ASSERT_EQ(futures[i].wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(futures[i].get(), i * 2);
+  }
+  EXPECT_EQ(ClientManager::instance().pendingRequests(), 0u);
+}
+
+TEST_F(ConcurrentServiceTest, AsyncRepliesCompleteOutOfOrder)
+{
+  std::string slow = unique_name("AsyncSlowService");
+  std::string fast = unique_name("AsyncFastService");
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::registerServiceHandler(fast, fastHandler);
+  zlc::waitForService(slow, 1000);
+  zlc::waitForService(fast, 1000);
+
+  AsyncResult<std::string> first;
+  AsyncResult<bool> both;
+  std::atomic<int> done{0};
+  auto callback = [&](const std::string &code, const std::string &response)
+  {
+    EXPECT_EQ(code, ResponseStatus::SUCCESS);
+    int n = ++done;
+    if (n == 1)
+    {
+      first.set(response);
+    }
+    else if (n == 2)
+    {
+      both.set(true);
+    }
+  };
+
+  // Both go over the same connection to this node
+  Client::requestAsync<std::string, std::string>(slow, "a", callback);
+  Client::requestAsync<std::string, std::string>(fast, "b", callback);
+
+  ASSERT_TRUE(first.wait_for(std::chrono::seconds(2)));
+  EXPECT_EQ(first.get(), "fast:b");
+  ASSERT_TRUE(both.wait_for(std::chrono::seconds(2)));
+}
+
+TEST_F(ConcurrentServiceTest, AsyncRequestToUnknownServiceFails)
+{
+  auto future = Client::requestAsync<std::string, std::string>(
+      unique_name("MissingService"), std::string("x"));
+
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  try
+  {
+    future.get();
+    FAIL() << "expected ServiceException";
+  }
+  catch (const ServiceException &e)
+  {
+    EXPECT_EQ(e.code(), ResponseStatus::NOSERVICE);
+  }
+}
+
+TEST_F(ConcurrentServiceTest, AsyncRequestTimesOut)
+{
+  std::string slow = unique_name("AsyncTimeoutService");
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  auto start = std::chrono::steady_clock::now();
+  auto future = Client::requestAsync<std::string, std::string>(
+      slow, std::string("x"), std::chrono::milliseconds(50));
+
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(180));
+  try
+  {
+    future.get();
+    FAIL() << "expected ServiceException";
+  }
+  catch (const ServiceException &e)
+  {
+    EXPECT_EQ(e.code(), ResponseStatus::SERVICE_TIMEOUT);
+  }
+  EXPECT_EQ(ClientManager::instance().pendingRequests(), 0u);
+}
+
+// =============================================
+// Deadline Tests
+// =============================================
+
+TEST_F(ConcurrentServiceTest, BlockingRequestTimesOut)
+{
+  std::string slow = unique_name("BlockingTimeoutService");
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  auto start = std::chrono::steady_clock::now();
+  try
+  {
+    std::string response;
+    Client::zlcRequest<std::string, std::string>(slow, "x", response,
+                                                 std::chrono::milliseconds(50));
+    FAIL() << "expected ServiceException";
+  }
+  catch (const ServiceException &e)
+  {
+    EXPECT_EQ(e.code(), ResponseStatus::SERVICE_TIMEOUT);
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(180));
+}
+
+TEST_F(ConcurrentServiceTest, ExpiredQueuedRequestIsSkipped)
+{
+  std::string slow = unique_name("ExpiringService");
+  ServiceManager::instance().setConcurrencyLimit(slow, 1);
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  std::thread first([&slow]() { EXPECT_EQ(callService(slow), "slow:x"); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+  // Queued behind the first call, this one expires before a slot frees up
+  std::string response;
+  EXPECT_THROW((Client::zlcRequest<std::string, std::string>(
+                   slow, "y", response, std::chrono::milliseconds(50))),
+               ServiceException);
+  first.join();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  EXPECT_EQ(g_started.load(), 1);
+  EXPECT_GE(ServiceManager::instance().expiredRequests(), 1u);
+}
+
+TEST_F(ConcurrentServiceTest, ServiceClientTimesOut)
+{
+  std::string slow = unique_name("ClientTimeoutService");
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  ServiceClient<std::string, std::string> client(slow, std::chrono::milliseconds(50));
+  std::string response;
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(client.call("x", response), ResponseStatus::SERVICE_TIMEOUT);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(180));
+
+  // The timed-out connection is not reused, so its late reply is never read
+  client.setTimeout(std::chrono::seconds(1));
+  EXPECT_EQ(client.call("y"), "slow:y");
+}
+
+TEST_F(ConcurrentServiceTest, ServiceClientRetriesTimedOutCall)
+{
+  static std::atomic<int> calls{0};
+  calls = 0;
+  std::string service = unique_name("FlakyService");
+  zlc::registerServiceHandler(
+      service,
+      +[](const std::string &msg)
+      {
+        if (calls++ == 0)
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        }
+        return "ok:" + msg;
+      });
+  zlc::waitForService(service, 1000);
+
+  RetryPolicy retry;
+  retry.max_attempts = 3;
+  retry.attempt_timeout = std::chrono::milliseconds(100);
+  ServiceClient<std::string, std::string> client(service, std::chrono::seconds(1),
+                                                 retry);
+  EXPECT_EQ(client.call("x"), "ok:x");
+  EXPECT_EQ(calls.load(), 2);
+}
+
+// =============================================
+// ServiceClient Tests
+// =============================================
+
+namespace
+{
+template <typename CallT> std::chrono::nanoseconds medianRoundTrip(CallT &&call)
+{
+  std::vector<std::chrono::nanoseconds> samples;
+  for (int i = 0; i < 50; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    call();
+    samples.push_back(std::chrono::steady_clock::now() - start);
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+} // namespace
+
+TEST_F(ServiceTest, ServiceClientReusesOneConnection)
+{
+  std::string service = unique_name("ClientHandleService");
+  zlc::registerServiceHandler(service, echoHandler);
+
+  ServiceClient<std::string, std::string> client(service);
+  EXPECT_EQ(client.call("a"), "echo:a");
+  EXPECT_FALSE(client.endpoint().empty());
+
+  const size_t sockets = ZMQContext::socketCount();
+  for (int i = 0; i < 20; ++i)
+  {
+    EXPECT_EQ(client.call(std::to_string(i)), "echo:" + std::to_string(i));
+  }
+  EXPECT_EQ(ZMQContext::socketCount(), sockets);
+}
+
+TEST_F(ServiceTest, ServiceClientConnectionsArePooled)
+{
+  std::string service = unique_name("PooledService");
+  zlc::registerServiceHandler(service, echoHandler);
+
+  {
+    ServiceClient<std::string, std::string> first(service);
+    EXPECT_EQ(first.call("x"), "echo:x");
+  }
+  EXPECT_EQ(ClientManager::instance().idleConnections(), 1u);
+
+  // A new handle borrows the idle connection instead of opening one
+  const size_t sockets = ZMQContext::socketCount();
+  ServiceClient<std::string, std::string> second(service);
+  EXPECT_EQ(second.call("y"), "echo:y");
+  EXPECT_EQ(ZMQContext::socketCount(), sockets);
+  EXPECT_EQ(ClientManager::instance().idleConnections(), 0u);
+}
+
+TEST_F(ServiceTest, ServiceClientResolvesAgainAfterDiscoveryChange)
+{
+  std::string service = unique_name("WithdrawnService");
+  zlc::registerServiceHandler(service, echoHandler);
+
+  ServiceClient<std::string, std::string> client(service);
+  EXPECT_EQ(client.call("x"), "echo:x");
+
+  NodeInfoManager::instance().unregisterLocalService(service);
+  std::string response;
+  EXPECT_EQ(client.call("x", response), ResponseStatus::NOSERVICE);
+  EXPECT_TRUE(client.endpoint().empty());
+
+  ServiceClient<std::string, std::string> unknown(unique_name("NoSuchService"));
+  EXPECT_THROW(unknown.call("x"), ServiceException);
+}
+
+TEST_F(ServiceTest, ServiceClientAvoidsConnectionSetup)
+{
+  std::string service = unique_name("RoundTripService");
+  zlc::registerServiceHandler(service, fastHandler);
+  zlc::waitForService(service, 1000);
+
+  ServiceClient<std::string, std::string> client(service);
+  client.call("warmup");
+  auto pooled = medianRoundTrip([&]() { client.call("x"); });
+  auto temporary = medianRoundTrip(
+      [&]()
+      {
+        std::string response;
+        Client::zlcRequest<std::string, std::string>(service, "x", response);
+      });
+
+  // The temporary socket pays for a TCP handshake on every call
+  EXPECT_LT(pooled, temporary);
+}
+
+// =============================================
+// Load Balancing Tests
+// =============================================
+
+namespace
+{
+// Second provider of a service: a bare ROUTER that answers every request
+// with the same response
+class FakeReplica
+{
+public:
+  explicit FakeReplica(const std::string &response)
+      : socket_(ZMQContext::createTempSocket(zmq::socket_type::router))
+  {
+    ByteBuffer out;
+    encode(response, out);
+    payload_.assign(out.data, out.data + out.size);
+
+    socket_.bind("tcp://127.0.0.1:*");
+    std::string endpoint = socket_.get(zmq::sockopt::last_endpoint);
+    port = static_cast<uint16_t>(
+        std::stoi(endpoint.substr(endpoint.rfind(':') + 1)));
+    thread_ = std::thread([this]() { serve(); });
+  }
+
+  ~FakeReplica()
+  {
+    running_ = false;
+    thread_.join();
+    socket_.close();
+  }
+
+  uint16_t port{0};
+  std::atomic<int> calls{0};
+
+private:
+  void serve()
+  {
+    zmq::pollitem_t item{socket_.handle(), 0, ZMQ_POLLIN, 0};
+    while (running_)
+    {
+      if (zmq::poll(&item, 1, std::chrono::milliseconds(20)) == 0)
+      {
+        continue;
+      }
+      // [identity][request id][empty][header][payload] -> keep the route
+      std::vector<zmq::message_t> frames;
+      do
+      {
+        frames.emplace_back();
+        (void)socket_.recv(frames.back(), zmq::recv_flags::none);
+      } while (frames.back().more());
+      ++calls;
+
+      for (size_t i = 0; i + 2 < frames.size(); ++i)
+      {
+        socket_.send(frames[i], zmq::send_flags::sndmore);
+      }
+      socket_.send(zmq::buffer(std::string(ResponseStatus::SUCCESS)),
+                   zmq::send_flags::sndmore);
+      socket_.send(zmq::buffer(payload_), zmq::send_flags::none);
+    }
+  }
+
+  ZMQSocket socket_;
+  Bytes payload_;
+  std::atomic<bool> running_{true};
+  std::thread thread_;
+};
+} // namespace
+
+TEST_F(ServiceTest, ServiceClientSpreadsCallsOverProviders)
+{
+  std::string service = unique_name("ReplicatedService");
+  zlc::registerServiceHandler(service, echoHandler);
+  FakeReplica replica("replica");
+  NodeInfoManager::instance().registerLocalService(service, replica.port);
+
+  ServiceClient<std::string, std::string> client(service);
+  client.setLoadBalancing(LoadBalancing::RoundRobin);
+  std::map<std::string, int> answers;
+  for (int i = 0; i < 10; ++i)
+  {
+    ++answers[client.call("x")];
+  }
+  EXPECT_EQ(answers["echo:x"], 5);
+  EXPECT_EQ(answers["replica"], 5);
+
+  // Calls by service name are spread as well
+  std::string first = callService(service);
+  std::string second = callService(service);
+  EXPECT_NE(first, second);
+}
+
+TEST_F(ServiceTest, ServiceClientRoutesKeysToOneProvider)
+{
+  std::string service = unique_name("StickyService");
+  zlc::registerServiceHandler(service, echoHandler);
+  FakeReplica replica("replica");
+  NodeInfoManager::instance().registerLocalService(service, replica.port);
+
+  ServiceClient<std::string, std::string> client(service);
+  client.setLoadBalancing(LoadBalancing::StickyKey);
+  client.setKeyExtractor([](const std::string &request) { return request; });
+
+  std::set<std::string> providers;
+  for (int key = 0; key < 20; ++key)
+  {
+    std::string request = "key" + std::to_string(key);
+    std::string answer = client.call(request);
+    providers.insert(client.endpoint());
+    for (int i = 0; i < 3; ++i)
+    {
+      EXPECT_EQ(client.call(request), answer);
+    }
+  }
+  EXPECT_EQ(providers.size(), 2u);
+}
+
+// =============================================
+// Hedging Tests
+// =============================================
+
+namespace
+{
+std::atomic<bool> g_stalled{false};
+
+std::string stallingHandler(const std::string &msg)
+{
+  if (g_stalled)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  }
+  return "echo:" + msg;
+}
+
+HedgePolicy hedging(double max_extra_load)
+{
+  HedgePolicy hedge;
+  hedge.enabled = true;
+  hedge.min_delay = std::chrono::milliseconds(5);
+  hedge.max_extra_load = max_extra_load;
+  return hedge;
+}
+} // namespace
+
+TEST_F(ServiceTest, HedgedCallAvoidsStalledProvider)
+{
+  g_stalled = false;
+  std::string service = unique_name("HedgedService");
+  zlc::registerServiceHandler(service, stallingHandler);
+  FakeReplica replica("replica");
+  NodeInfoManager::instance().registerLocalService(service, replica.port);
+
+  ServiceClient<std::string, std::string> client(service);
+  client.setLoadBalancing(LoadBalancing::RoundRobin);
+  client.setHedgePolicy(hedging(0.5));
+  for (int i = 0; i < 20; ++i)
+  {
+    client.call("warmup");
+  }
+
+  g_stalled = true;
+  for (int i = 0; i < 6; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(client.call("x"), "replica");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+  }
+  EXPECT_GE(client.hedgesSent(), 1u);
+  g_stalled = false;
+}
+
+TEST_F(ServiceTest, HedgingStaysWithinBudget)
+{
+  g_stalled = false;
+  std::string service = unique_name("UnhedgedService");
+  zlc::registerServiceHandler(service, stallingHandler);
+  FakeReplica replica("replica");
+  NodeInfoManager::instance().registerLocalService(service, replica.port);
+
+  ServiceClient<std::string, std::string> client(service);
+  client.setLoadBalancing(LoadBalancing::RoundRobin);
+  client.setHedgePolicy(hedging(0.0));
+  for (int i = 0; i < 20; ++i)
+  {
+    client.call("warmup");
+  }
+
+  g_stalled = true;
+  std::chrono::nanoseconds slowest{0};
+  for (int i = 0; i < 2; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    client.call("x");
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    slowest = std::max(slowest, elapsed);
+  }
+  EXPECT_GE(slowest, std::chrono::milliseconds(250));
+  EXPECT_EQ(client.hedgesSent(), 0u);
+  g_stalled = false;
+}
+
+// =============================================
+// Streaming Tests
+// =============================================
+
+namespace
+{
+std::atomic<int> g_written{0};
+std::atomic<bool> g_stream_cancelled{false};
+
+void countingStream(const int &count, StreamWriter<int> &writer)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    if (!writer.write(i))
+    {
+      g_stream_cancelled = true;
+      return;
+    }
+    ++g_written;
+  }
+}
+} // namespace
+
+TEST_F(ServiceTest, StreamDeliversMessagesInOrder)
+{
+  std::string service = unique_name("CountingStream");
+  zlc::registerStreamHandler(service, countingStream);
+  zlc::waitForService(service, 1000);
+
+  auto stream = Client::requestStream<int, int>(service, 100, 4);
+  std::vector<int> received;
+  for (int value : stream)
+  {
+    received.push_back(value);
+  }
+
+  ASSERT_EQ(received.size(), 100u);
+  for (int i = 0; i < 100; ++i)
+  {
+    EXPECT_EQ(received[i], i);
+  }
+  EXPECT_EQ(stream.status(), ResponseStatus::SUCCESS);
+}
+
+TEST_F(ServiceTest, StreamIsPacedByReader)
+{
+  g_written = 0;
+  g_stream_cancelled = false;
+  std::string service = unique_name("PacedStream");
+  zlc::registerStreamHandler(service, countingStream);
+  zlc::waitForService(service, 1000);
+
+  {
+    auto stream = Client::requestStream<int, int>(service, 1000, 4);
+    int value = -1;
+    ASSERT_TRUE(stream.next(value));
+    EXPECT_EQ(value, 0);
+
+    // The writer stops once the window is used up
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(g_written.load(), 4);
+  }
+
+  // Dropping the reader cancels the stream
+  for (int i = 0; i < 100 && !g_stream_cancelled; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(g_stream_cancelled.load());
+  EXPECT_EQ(g_written.load(), 4);
+}
+
+TEST_F(ServiceTest, StreamDeliversFirstMessageEarly)
+{
+  std::string service = unique_name("IncrementalStream");
+  zlc::registerStreamHandler(
+      service,
+      +[](const std::string &query, StreamWriter<std::string> &writer)
+      {
+        writer.write(query + ":first");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        writer.write(query + ":second");
+      });
+  zlc::waitForService(service, 1000);
+
+  auto start = std::chrono::steady_clock::now();
+  auto stream = Client::requestStream<std::string, std::string>(service, "q");
+  std::string first;
+  ASSERT_TRUE(stream.next(first));
+  EXPECT_EQ(first, "q:first");
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+
+  std::vector<std::string> rest;
+  EXPECT_EQ(stream.forEach([&rest](const std::string &m) { rest.push_back(m); }),
+            ResponseStatus::SUCCESS);
+  EXPECT_EQ(rest, (std::vector<std::string>{"q:second"}));
+}
+
+TEST_F(ServiceTest, StreamReportsHandlerFailure)
+{
+  std::string service = unique_name("FailingStream");
+  zlc::registerStreamHandler(
+      service,
+      +[](const int &, StreamWriter<int> &writer)
+      {
+        writer.write(1);
+        throw std::runtime_error("disk gone");
+      });
+  zlc::waitForService(service, 1000);
+
+  auto stream = Client::requestStream<int, int>(service, 0);
+  std::vector<int> received(stream.begin(), stream.end());
+  EXPECT_EQ(received, (std::vector<int>{1}));
+  EXPECT_EQ(stream.status(), ResponseStatus::SERVICE_FAIL);
+
+  auto missing = Client::requestStream<int, int>(unique_name("NoStream"), 0);
+  EXPECT_EQ(missing.begin(), missing.end());
+  EXPECT_EQ(missing.status(), ResponseStatus::NOSERVICE);
+}
+
+// =============================================
+// Batching Tests
+// =============================================
+
+namespace
+{
+std::mutex g_batch_mutex;
+std::vector<size_t> g_batch_sizes;
+
+std::vector<int> doublingBatch(const std::vector<int> &values)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_batch_mutex);
+    g_batch_sizes.push_back(values.size());
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::vector<int> doubled;
+  for (int value : values)
+  {
+    doubled.push_back(value * 2);
+  }
+  return doubled;
+}
+} // namespace
+
+TEST_F(ServiceTest, BatchHandlerAnswersEachCaller)
+{
+  g_batch_sizes.clear();
+  std::string service = unique_name("DoublingBatch");
+  zlc::registerBatchHandler(service, doublingBatch,
+                            BatchOptions{8, std::chrono::milliseconds(20)});
+  zlc::waitForService(service, 1000);
+
+  constexpr int CALLS = 32;
+  std::vector<std::promise<std::pair<std::string, int>>> results(CALLS);
+  for (int i = 0; i < CALLS; ++i)
+  {
+    Client::requestAsync<int, int>(service, i,
+                                   [&results, i](const std::string &code, int value)
+                                   { results[i].set_value({code, value}); });
+  }
+  for (int i = 0; i < CALLS; ++i)
+  {
+    auto [code, value] = results[i].get_future().get();
+    EXPECT_EQ(code, ResponseStatus::SUCCESS);
+    EXPECT_EQ(value, i * 2);
+  }
+
+  // The first request runs alone; the rest queue up behind it
+  std::lock_guard<std::mutex> lock(g_batch_mutex);
+  EXPECT_LT(g_batch_sizes.size(), static_cast<size_t>(CALLS));
+  EXPECT_LE(*std::max_element(g_batch_sizes.begin(), g_batch_sizes.end()), 8u);
+  EXPECT_GT(*std::max_element(g_batch_sizes.begin(), g_batch_sizes.end()), 1u);
+}
+
+TEST_F(ServiceTest, IdleBatchRequestIsNotDelayed)
+{
+  std::string service = unique_name("IdleBatch");
+  zlc::registerBatchHandler(
+      service,
+      +[](const std::vector<std::string> &names)
+      {
+        std::vector<std::string> out;
+        for (const auto &name : names)
+        {
+          out.push_back("hi " + name);
+        }
+        return out;
+      },
+      BatchOptions{64, std::chrono::seconds(2)});
+  zlc::waitForService(service, 1000);
+
+  auto start = std::chrono::steady_clock::now();
+  std::string response;
+  Client::zlcRequest<std::string, std::string>(service, "bob", response);
+  EXPECT_EQ(response, "hi bob");
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+}
+
+TEST_F(ServiceTest, BatchWithMissingResponsesFails)
+{
+  std::string service = unique_name("ShortBatch");
+  zlc::registerBatchHandler(
+      service, +[](const std::vector<int> &) { return std::vector<int>{}; });
+  zlc::waitForService(service, 1000);
+
+  std::promise<std::string> code;
+  Client::requestAsync<int, int>(service, 1, [&code](const std::string &c, int)
+                                 { code.set_value(c); });
+  EXPECT_EQ(code.get_future().get(), ResponseStatus::SERVICE_FAIL);
+}
+
+// =============================================
+// Wire Format Tests
+// =============================================
+
+TEST_F(ServiceTest, CompactRequestsGetOneByteStatus)
+{
+  std::string service = unique_name("CompactEcho");
+  zlc::registerServiceHandler(service, +[](const std::string &s) { return s; });
+  zlc::waitForService(service, 1000);
+
+  uint32_t id = ServiceManager::instance().serviceId(service);
+  ASSERT_NE(id, 0u);
+  auto providers = NodeInfoManager::instance().getServiceProviders(service);
+  ASSERT_EQ(providers.size(), 1u);
+  EXPECT_EQ(providers[0].service_id, id);
+
+  ZMQSocket socket = ZMQContext::createTempSocket(zmq::socket_type::req);
+  socket.set(zmq::sockopt::rcvtimeo, 1000);
+  socket.set(zmq::sockopt::linger, 0);
+  socket.connect("tcp://127.0.0.1:" +
+                 std::to_string(ServiceManager::instance().service_port));
+  ByteBuffer out;
+  encode(std::string("hi"), out);
+  auto exchange = [&](const Bytes &header)
+  {
+    Client::sendRequest(header, ByteView{out.data, out.size}, socket);
+    zmq::message_t status;
+    zmq::message_t payload;
+    EXPECT_TRUE(socket.recv(status).has_value());
+    EXPECT_TRUE(socket.recv(payload).has_value());
+    return status.to_string();
+  };
+
+  uint8_t success;
+  uint8_t noservice;
+  ASSERT_TRUE(encodeStatus(ResponseStatus::SUCCESS, success));
+  ASSERT_TRUE(encodeStatus(ResponseStatus::NOSERVICE, noservice));
+  EXPECT_EQ(exchange(encodeServiceHeader(id, 1000)),
+            std::string(1, static_cast<char>(success)));
+  EXPECT_EQ(exchange(encodeServiceHeader(id + 1000, 0)),
+            std::string(1, static_cast<char>(noservice)));
+
+  // Requests by name get the status as a string, as older clients expect
+  EXPECT_EQ(exchange(encodeServiceHeader(service, 1000)), ResponseStatus::SUCCESS);
+  socket.close();
+
+  // Clients pick the compact header up from discovery
+  ServiceClient<std::string, std::string> client(service);
+  EXPECT_EQ(client.call("x"), "x");
+  EXPECT_EQ(ClientManager::instance().serviceId(
+                service, "tcp://127.0.0.1:" +
+                             std::to_string(ServiceManager::instance().service_port)),
+            id);
+}
+
+TEST_F(ServiceTest, LargePayloadsRoundTrip)
+{
+  // The request is read in place; the reply is handed to ZMQ without a copy
+  std::string service = unique_name("ReverseService");
+  zlc::registerServiceHandler(
+      service, +[](const std::string_view &request)
+      { return std::string(request.rbegin(), request.rend()); });
+  zlc::waitForService(service, 1000);
+
+  std::string request(4 << 20, 'a');
+  for (size_t i = 0; i < request.size(); i += 4096)
+  {
+    request[i] = static_cast<char>('a' + (i / 4096) % 26);
+  }
+  std::string response;
+  Client::zlcRequest<std::string, std::string>(service, request, response);
+  EXPECT_EQ(response, std::string(request.rbegin(), request.rend()));
+
+  // Small replies take the copying path
+  std::string small;
+  Client::zlcRequest<std::string, std::string>(service, "abc", small);
+  EXPECT_EQ(small, "cba");
+}
+
+// =============================================
+// Response Cache Tests
+// =============================================
+
+namespace
+{
+std::atomic<int> g_lookups{0};
+
+std::string slowLookup(const std::string &key)
+{
+  g_lookups.fetch_add(1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  return "value of " + key;
+}
+} // namespace
+
+TEST_F(ServiceTest, IdenticalRequestsShareOneCall)
+{
+  g_lookups = 0;
+  std::string service = unique_name("SlowLookup");
+  auto &manager = ServiceManager::instance();
+  manager.setIdempotent(service, ResponseCacheOptions{std::chrono::milliseconds(0)});
+  zlc::registerServiceHandler(service, slowLookup);
+  zlc::waitForService(service, 1000);
+
+  const uint64_t coalesced = manager.coalescedRequests();
+  std::vector<std::future<std::string>> futures;
+  for (int i = 0; i < 8; ++i)
+  {
+    futures.push_back(Client::requestAsync<std::string, std::string>(service, "k"));
+  }
+  for (auto &future : futures)
+  {
+    EXPECT_EQ(future.get(), "value of k");
+  }
+  EXPECT_EQ(g_lookups.load(), 1);
+  EXPECT_EQ(manager.coalescedRequests() - coalesced, 7u);
+
+  // Without a TTL the next request runs again
+  std::string response;
+  Client::zlcRequest<std::string, std::string>(service, "k", response);
+  EXPECT_EQ(g_lookups.load(), 2);
+}
+
+TEST_F(ServiceTest, CachedResponsesExpire)
+{
+  g_lookups = 0;
+  std::string service = unique_name("CachedLookup");
+  auto &manager = ServiceManager::instance();
+  manager.setIdempotent(service, ResponseCacheOptions{std::chrono::milliseconds(300)});
+  zlc::registerServiceHandler(service, slowLookup);
+  zlc::waitForService(service, 1000);
+
+  const uint64_t hits = manager.cacheHits();
+  std::string response;
+  Client::zlcRequest<std::string, std::string>(service, "a", response);
+  Client::zlcRequest<std::string, std::string>(service, "a", response);
+  EXPECT_EQ(response, "value of a");
+  EXPECT_EQ(g_lookups.load(), 1);
+  EXPECT_EQ(manager.cacheHits() - hits, 1u);
+
+  // Other requests are not answered from the cache
+  Client::zlcRequest<std::string, std::string>(service, "b", response);
+  EXPECT_EQ(response, "value of b");
+  EXPECT_EQ(g_lookups.load(), 2);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+  Client::zlcRequest<std::string, std::string>(service, "a", response);
+  EXPECT_EQ(response, "value of a");
+  EXPECT_EQ(g_lookups.load(), 3);
+}
+
+// =============================================
+// One-Way Call Tests
+// =============================================
+
+namespace
+{
+std::atomic<int> g_commands{0};
+} // namespace
+
+TEST_F(ServiceTest, OneWayRequestsArePipelined)
+{
+  g_commands = 0;
+  std::string service = unique_name("Command");
+  zlc::registerServiceHandler(
+      service, +[](const int &value)
+      {
+        g_commands.fetch_add(value);
+        return Empty{};
+      });
+  zlc::waitForService(service, 1000);
+
+  const uint64_t received = ServiceManager::instance().oneWayRequests();
+  constexpr int COMMANDS = 10000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < COMMANDS; ++i)
+  {
+    ASSERT_TRUE(Client::sendOneWay(service, 1));
+  }
+  // Queued, not sent: returns long before the handlers ran
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (g_commands.load() < COMMANDS && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(g_commands.load(), COMMANDS);
+  EXPECT_EQ(ServiceManager::instance().oneWayRequests() - received,
+            static_cast<uint64_t>(COMMANDS));
+  EXPECT_EQ(ClientManager::instance().pendingRequests(), 0u);
+  EXPECT_EQ(ClientManager::instance().droppedOneWay(), 0u);
+
+  // Regular calls on the same connection are unaffected
+  auto future = Client::requestAsync<int, Empty>(service, 1);
+  EXPECT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+TEST_F(ServiceTest, OneWayRequestWithoutProviderFails)
+{
+  EXPECT_FALSE(Client::sendOneWay(unique_name("Missing"), 1));
+}
+
+// =============================================
+// Admission Control Tests
+// =============================================
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Outcome
+{
+  std::string code;
+  Clock::duration after;
+};
+
+// Send `count` requests at once and wait for every reply
+std::vector<Outcome> callConcurrently(const std::string &service, int count)
+{
+  std::vector<std::promise<Outcome>> outcomes(count);
+  auto start = Clock::now();
+  for (int i = 0; i < count; ++i)
+  {
+    Client::requestAsync<std::string, std::string>(
+        service, "x",
+        [&outcomes, i, start](const std::string &code, const std::string &)
+        { outcomes[i].set_value({code, Clock::now() - start}); });
+  }
+  std::vector<Outcome> results;
+  for (auto &outcome : outcomes)
+  {
+    results.push_back(outcome.get_future().get());
+  }
+  return results;
+}
+} // namespace
+
+TEST_F(ConcurrentServiceTest, FullQueueShedsRequests)
+{
+  std::string slow = unique_name("QueueLimited");
+  ServiceManager::instance().setAdmission(slow, AdmissionOptions{1, 2});
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  uint64_t succeeded = 0;
+  uint64_t shed = 0;
+  for (const Outcome &outcome : callConcurrently(slow, 8))
+  {
+    if (outcome.code == ResponseStatus::SUCCESS)
+    {
+      ++succeeded;
+      continue;
+    }
+    EXPECT_EQ(outcome.code, ResponseStatus::OVERLOADED);
+    // Rejected right away rather than after the handler
+    EXPECT_LT(outcome.after, std::chrono::milliseconds(150));
+    ++shed;
+  }
+  EXPECT_GE(succeeded, 2u);
+  EXPECT_GE(shed, 4u);
+  EXPECT_EQ(g_max_running.load(), 1);
+
+  ServiceStatistics stats = zlc::serviceStatistics(slow);
+  EXPECT_EQ(stats.accepted, succeeded);
+  EXPECT_EQ(stats.shed, shed);
+  EXPECT_EQ(stats.queued, 0u);
+  EXPECT_EQ(stats.in_flight, 0u);
+  // The last accepted request waited for the ones before it
+  EXPECT_GE(stats.queue_time_p99, std::chrono::milliseconds(150));
+}
+
+TEST_F(ConcurrentServiceTest, LongQueuedRequestsAreShed)
+{
+  std::string slow = unique_name("QueueTimeLimited");
+  ServiceManager::instance().setAdmission(
+      slow, AdmissionOptions{1, 0, std::chrono::milliseconds(50)});
+  zlc::registerServiceHandler(slow, slowHandler);
+  zlc::waitForService(slow, 1000);
+
+  std::vector<Outcome> outcomes = callConcurrently(slow, 3);
+  int succeeded = 0;
+  for (const Outcome &outcome : outcomes)
+  {
+    if (outcome.code == ResponseStatus::SUCCESS)
+    {
+      ++succeeded;
+      continue;
+    }
+    EXPECT_EQ(outcome.code, ResponseStatus::OVERLOADED);
+    // Shed once the limit passed, not when the running request finished
+    EXPECT_LT(outcome.after, std::chrono::milliseconds(180));
+  }
+  EXPECT_EQ(succeeded, 1);
+  EXPECT_EQ(g_started.load(), 1);
+
+  ServiceStatistics stats = zlc::serviceStatistics(slow);
+  EXPECT_EQ(stats.accepted, 1u);
+  EXPECT_EQ(stats.shed, 2u);
+  EXPECT_EQ(stats.queued, 0u);
+  EXPECT_GE(stats.queue_time_p90, std::chrono::milliseconds(50));
+}
+
+TEST_F(ConcurrentServiceTest, UnknownServiceHasNoStatistics)
+{
+  ServiceStatistics stats = zlc::serviceStatistics(unique_name("Unknown"));
+  EXPECT_EQ(stats.accepted, 0u);
+  EXPECT_EQ(stats.queue_time_p50, std::chrono::microseconds(0));
+}
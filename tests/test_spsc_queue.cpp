@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "zerolancom/utils/spsc_queue.hpp"
+
+namespace zlc
+{
+
+// =============================================
+// SPSCQueue Tests
+// =============================================
+
+TEST(SPSCQueueTest, StartsEmpty)
+{
+  SPSCQueue<int> queue(4);
+  int out = 0;
+
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.size(), 0);
+  EXPECT_EQ(queue.capacity(), 4);
+  EXPECT_FALSE(queue.tryPop(out));
+  EXPECT_FALSE(queue.tryPopLatest(out));
+}
+
+TEST(SPSCQueueTest, FifoOrder)
+{
+  SPSCQueue<int> queue(4);
+
+  for (int i = 1; i <= 3; ++i)
+  {
+    int value = i;
+    EXPECT_TRUE(queue.tryPush(std::move(value)));
+  }
+  EXPECT_EQ(queue.size(), 3);
+
+  int out = 0;
+  for (int i = 1; i <= 3; ++i)
+  {
+    ASSERT_TRUE(queue.tryPop(out));
+    EXPECT_EQ(out, i);
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(SPSCQueueTest, RejectsPushWhenFull)
+{
+  SPSCQueue<std::string> queue(2);
+
+  std::string a = "a", b = "b", c = "c";
+  EXPECT_TRUE(queue.tryPush(std::move(a)));
+  EXPECT_TRUE(queue.tryPush(std::move(b)));
+  EXPECT_FALSE(queue.tryPush(std::move(c)));
+
+  // Rejected value is left untouched
+  EXPECT_EQ(c, "c");
+  EXPECT_EQ(queue.size(), 2);
+}
+
+TEST(SPSCQueueTest, PopLatestDiscardsOlderElements)
+{
+  SPSCQueue<int> queue(8);
+
+  for (int i = 0; i < 5; ++i)
+  {
+    int value = i;
+    queue.tryPush(std::move(value));
+  }
+
+  int out = -1;
+  ASSERT_TRUE(queue.tryPopLatest(out));
+  EXPECT_EQ(out, 4);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(SPSCQueueTest, WrapsAround)
+{
+  SPSCQueue<int> queue(3);
+  int out = 0;
+
+  for (int round = 0; round < 10; ++round)
+  {
+    int first = round * 2;
+    int second = round * 2 + 1;
+    ASSERT_TRUE(queue.tryPush(std::move(first)));
+    ASSERT_TRUE(queue.tryPush(std::move(second)));
+    ASSERT_TRUE(queue.tryPopLatest(out));
+    EXPECT_EQ(out, round * 2 + 1);
+  }
+}
+
+TEST(SPSCQueueTest, ConcurrentProducerConsumer)
+{
+  constexpr int kCount = 100000;
+  SPSCQueue<int> queue(64);
+
+  std::thread producer(
+      [&queue]()
+      {
+        for (int i = 0; i < kCount; ++i)
+        {
+          int value = i;
+          while (!queue.tryPush(std::move(value)))
+          {
+            std::this_thread::yield();
+          }
+        }
+      });
+
+  int expected = 0;
+  int out = 0;
+  while (expected < kCount)
+  {
+    if (queue.tryPop(out))
+    {
+      ASSERT_EQ(out, expected);
+      ++expected;
+    }
+  }
+
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+} // namespace zlc
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "zerolancom/utils/topic_trie.hpp"
+
+namespace zlc
+{
+
+namespace
+{
+using Values = std::vector<TopicTrie::Value>;
+
+Values matchSorted(const TopicTrie &trie, const std::string &topic)
+{
+  Values out;
+  trie.match(topic, out);
+  std::sort(out.begin(), out.end());
+  return out;
+}
+} // namespace
+
+// =============================================
+// TopicTrie Tests
+// =============================================
+
+TEST(TopicTrieTest, DetectsPatterns)
+{
+  EXPECT_FALSE(TopicTrie::isPattern("robot1/sensors/imu"));
+  EXPECT_FALSE(TopicTrie::isPattern("robot1/sensors*"));
+  EXPECT_TRUE(TopicTrie::isPattern("robot1/sensors/*"));
+  EXPECT_TRUE(TopicTrie::isPattern("*/imu"));
+  EXPECT_TRUE(TopicTrie::isPattern("robot1/**"));
+}
+
+TEST(TopicTrieTest, MatchesSingleSegmentWildcard)
+{
+  TopicTrie trie;
+  trie.insert("robot1/sensors/*", 1);
+  trie.insert("*/sensors/imu", 2);
+  trie.insert("robot1/sensors/imu", 3);
+
+  EXPECT_EQ(matchSorted(trie, "robot1/sensors/imu"),
+            (Values{1, 2, 3}));
+  EXPECT_EQ(matchSorted(trie, "robot1/sensors/gps"), (Values{1}));
+  EXPECT_EQ(matchSorted(trie, "robot2/sensors/imu"), (Values{2}));
+
+  // "*" matches exactly one segment
+  EXPECT_TRUE(matchSorted(trie, "robot1/sensors").empty());
+  EXPECT_TRUE(matchSorted(trie, "robot1/sensors/imu/raw").empty());
+}
+
+TEST(TopicTrieTest, MatchesTrailingMultiSegmentWildcard)
+{
+  TopicTrie trie;
+  trie.insert("robot1/**", 1);
+
+  EXPECT_EQ(matchSorted(trie, "robot1/imu"), (Values{1}));
+  EXPECT_EQ(matchSorted(trie, "robot1/sensors/imu/raw"),
+            (Values{1}));
+  EXPECT_TRUE(matchSorted(trie, "robot1").empty());
+  EXPECT_TRUE(matchSorted(trie, "robot2/imu").empty());
+
+  EXPECT_THROW(trie.insert("robot1/**/imu", 2), std::invalid_argument);
+  EXPECT_EQ(trie.size(), 1u);
+}
+
+TEST(TopicTrieTest, EraseRemovesOnlyThatPattern)
+{
+  TopicTrie trie;
+  trie.insert("a/*", 1);
+  trie.insert("a/*", 2);
+  trie.insert("a/**", 3);
+  EXPECT_EQ(trie.size(), 3u);
+
+  EXPECT_TRUE(trie.erase("a/*", 1));
+  EXPECT_FALSE(trie.erase("a/*", 1));
+  EXPECT_FALSE(trie.erase("b/*", 2));
+  EXPECT_EQ(matchSorted(trie, "a/b"), (Values{2, 3}));
+
+  EXPECT_TRUE(trie.erase("a/*", 2));
+  EXPECT_TRUE(trie.erase("a/**", 3));
+  EXPECT_TRUE(trie.empty());
+  EXPECT_TRUE(matchSorted(trie, "a/b").empty());
+}
+
+} // namespace zlc
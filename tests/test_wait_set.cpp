@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "zerolancom/sockets/client.hpp"
+#include "zerolancom/zerolancom.hpp"
+
+#include "test_utils.hpp"
+
+using namespace zlc;
+using namespace zlc_test;
+
+// =============================================
+// GuardCondition / Timer Tests (no node required)
+// =============================================
+
+TEST(GuardConditionTest, TriggerAndReset)
+{
+  GuardCondition guard;
+  EXPECT_FALSE(guard.isTriggered());
+  EXPECT_GE(guard.fd(), 0);
+
+  guard.trigger();
+  guard.trigger();
+  EXPECT_TRUE(guard.isTriggered());
+
+  guard.reset();
+  EXPECT_FALSE(guard.isTriggered());
+}
+
+TEST(WaitSetTest, TimesOutWithNothingReady)
+{
+  GuardCondition guard;
+  WaitSet ws;
+  auto handle = ws.attach(guard);
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(ws.wait(std::chrono::milliseconds(50)));
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+  EXPECT_FALSE(ws.isReady(handle));
+}
+
+TEST(WaitSetTest, GuardConditionWakesWaiterFromAnotherThread)
+{
+  GuardCondition guard;
+  WaitSet ws;
+  auto handle = ws.attach(guard);
+
+  std::thread trigger(
+      [&guard]()
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        guard.trigger();
+      });
+
+  EXPECT_TRUE(ws.wait(std::chrono::seconds(2)));
+  EXPECT_TRUE(ws.isReady(handle));
+  trigger.join();
+
+  // User guards stay ready until reset
+  EXPECT_TRUE(ws.wait(std::chrono::milliseconds(0)));
+  guard.reset();
+  EXPECT_FALSE(ws.wait(std::chrono::milliseconds(0)));
+}
+
+TEST(WaitSetTest, TimerFiresPeriodically)
+{
+  WaitSet ws;
+  auto timer = ws.addTimer(std::chrono::milliseconds(20));
+
+  int fired = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (fired < 3)
+  {
+    ASSERT_TRUE(ws.wait(std::chrono::seconds(1)));
+    EXPECT_TRUE(ws.isReady(timer));
+    ++fired;
+  }
+
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(60));
+}
+
+// =============================================
+// WaitSet with subscriptions and services
+// =============================================
+
+class WaitSetNodeTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    zlc::init(unique_name("WaitSetTestNode"), "127.0.0.1");
+  }
+
+  void TearDown() override
+  {
+    zlc::shutdown();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+};
+
+TEST_F(WaitSetNodeTest, WakesOnPullSubscriber)
+{
+  std::string topic_a = unique_name("WaitTopicA");
+  std::string topic_b = unique_name("WaitTopicB");
+  Publisher<int> pub_a(topic_a);
+  Publisher<int> pub_b(topic_b);
+  Subscriber<int> sub_a(topic_a);
+  Subscriber<int> sub_b(topic_b);
+
+  WaitSet ws;
+  auto handle_a = ws.attach(sub_a);
+  auto handle_b = ws.attach(sub_b);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  EXPECT_FALSE(ws.wait(std::chrono::milliseconds(20)));
+
+  pub_b.publish(7);
+  ASSERT_TRUE(ws.wait(std::chrono::seconds(2)));
+  EXPECT_FALSE(ws.isReady(handle_a));
+  EXPECT_TRUE(ws.isReady(handle_b));
+
+  int value = 0;
+  ASSERT_TRUE(sub_b.take(value));
+  EXPECT_EQ(value, 7);
+
+  // Drained: nothing is ready any more
+  EXPECT_FALSE(ws.wait(std::chrono::milliseconds(20)));
+}
+
+TEST_F(WaitSetNodeTest, ServesQueuedServiceRequests)
+{
+  std::string service = unique_name("QueuedService");
+  ServiceQueue<std::string, std::string> queue(service);
+
+  WaitSet ws;
+  auto handle = ws.attach(queue);
+  zlc::waitForService(service, 1000);
+
+  std::string response;
+  std::thread caller(
+      [&]()
+      { Client::zlcRequest<std::string, std::string>(service, "ping", response); });
+
+  ASSERT_TRUE(ws.wait(std::chrono::seconds(2)));
+  EXPECT_TRUE(ws.isReady(handle));
+  EXPECT_TRUE(queue.serveOne([](const std::string &req) { return req + ":pong"; }));
+  caller.join();
+
+  EXPECT_EQ(response, "ping:pong");
+  EXPECT_EQ(queue.pending(), 0u);
+}
+
+TEST_F(WaitSetNodeTest, UnservedQueuedRequestTimesOut)
+{
+  std::string service = unique_name("UnservedQueue");
+  {
+    ServiceQueue<std::string, std::string> queue(service,
+                                                 std::chrono::milliseconds(100));
+    zlc::waitForService(service, 1000);
+
+    auto future =
+        Client::requestAsync<std::string, std::string>(service, std::string("ping"));
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    try
+    {
+      future.get();
+      FAIL() << "expected ServiceException";
+    }
+    catch (const ServiceException &e)
+    {
+      EXPECT_EQ(e.code(), ResponseStatus::SERVICE_TIMEOUT);
+    }
+
+    // The timed-out request is no longer served
+    EXPECT_EQ(queue.pending(), 0u);
+    EXPECT_FALSE(queue.serveOne([](const std::string &req) { return req; }));
+  }
+
+  // Destroying the queue withdraws the service from the local node
+  auto services = NodeInfoManager::instance().getLocalNodeInfo().services;
+  EXPECT_TRUE(std::none_of(services.begin(), services.end(),
+                           [&](const SocketInfo &info)
+                           { return info.name == service; }));
+}